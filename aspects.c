@@ -0,0 +1,239 @@
+#include "aspects.h"
+#include "cpu.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Aspect engine
+ *
+ * The longitudes and speeds of all body pairs are gathered into contiguous arrays first. A branch-free kernel then
+ * computes, for every pair, the angular separation folded to [0, 180] and its rate of change, and compares it with
+ * every aspect of the set. The kernel has an AVX2 version, selected at run time, and a scalar fallback. The only
+ * branches left are on hits, which are rare.
+ */
+
+// Major aspects plus the two most used minor ones
+const AspectDef default_aspects[] = {
+    {"Conjunction", 0.0, 8.0},   {"Semisextile", 30.0, 2.0}, {"Sextile", 60.0, 6.0},     {"Square", 90.0, 7.0},
+    {"Trine", 120.0, 8.0},       {"Quincunx", 150.0, 3.0},   {"Opposition", 180.0, 8.0},
+};
+const int num_default_aspects = sizeof(default_aspects) / sizeof(default_aspects[0]);
+
+/**
+ * @brief Scalar kernel: separations in [0, 180] and their rates of change for n pairs
+ */
+static void separations_scalar(const double *lon1, const double *lon2, const double *v1, const double *v2, int n,
+                               double *sep, double *rate) {
+    for (int p = 0; p < n; p++) {
+        double d = lon2[p] - lon1[p];
+
+        // Signed difference in [-180, 180]; the separation grows with the relative speed when d is positive
+        d -= 360.0 * floor(d / 360.0 + 0.5);
+        sep[p] = fabs(d);
+        rate[p] = copysign(1.0, d) * (v2[p] - v1[p]);
+    }
+}
+
+#ifdef HAVE_AVX2_KERNEL
+/**
+ * @brief AVX2 kernel, same contract as separations_scalar()
+ */
+__attribute__((target("avx2"))) static void separations_avx2(const double *lon1, const double *lon2,
+                                                             const double *v1, const double *v2, int n, double *sep,
+                                                             double *rate) {
+    const __m256d full = _mm256_set1_pd(360.0);
+    const __m256d inv_full = _mm256_set1_pd(1.0 / 360.0);
+    const __m256d sign_mask = _mm256_set1_pd(-0.0);
+    int p = 0;
+
+    for (; p + 4 <= n; p += 4) {
+        __m256d d = _mm256_sub_pd(_mm256_loadu_pd(&lon2[p]), _mm256_loadu_pd(&lon1[p]));
+        __m256d turns = _mm256_round_pd(_mm256_mul_pd(d, inv_full), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256d dv = _mm256_sub_pd(_mm256_loadu_pd(&v2[p]), _mm256_loadu_pd(&v1[p]));
+
+        d = _mm256_sub_pd(d, _mm256_mul_pd(turns, full));
+        _mm256_storeu_pd(&sep[p], _mm256_andnot_pd(sign_mask, d));
+        _mm256_storeu_pd(&rate[p], _mm256_xor_pd(dv, _mm256_and_pd(d, sign_mask)));
+    }
+
+    separations_scalar(&lon1[p], &lon2[p], &v1[p], &v2[p], n - p, &sep[p], &rate[p]);
+}
+#endif
+
+/**
+ * @brief Compute the separations with the best kernel the CPU supports
+ */
+static void separations(const double *lon1, const double *lon2, const double *v1, const double *v2, int n,
+                        double *sep, double *rate) {
+#ifdef HAVE_AVX2_KERNEL
+    if (cpu_has_avx2()) {
+        separations_avx2(lon1, lon2, v1, v2, n, sep, rate);
+        return;
+    }
+#endif
+    separations_scalar(lon1, lon2, v1, v2, n, sep, rate);
+}
+
+/**
+ * @brief Find all aspects between the bodies of one chart
+ *
+ * @param lon The ecliptic longitudes, degrees
+ * @param speed The longitude speeds, degrees per day (NULL if unknown; nothing is then reported as applying)
+ * @param n The number of bodies, at most ASPECT_MAX_BODIES
+ * @param aspects The aspect set
+ * @param naspects The number of aspects in the set
+ * @param out The aspects found, ordered by pair then by aspect
+ * @param max_out The capacity of out
+ * @return int The number of aspects found, or -1 if there are too many bodies
+ */
+int find_aspects(const double *lon, const double *speed, int n, const AspectDef *aspects, int naspects, Aspect *out,
+                 int max_out) {
+    double lon1[ASPECT_MAX_PAIRS], lon2[ASPECT_MAX_PAIRS], v1[ASPECT_MAX_PAIRS], v2[ASPECT_MAX_PAIRS];
+    double sep[ASPECT_MAX_PAIRS], rate[ASPECT_MAX_PAIRS];
+    unsigned char first[ASPECT_MAX_PAIRS], second[ASPECT_MAX_PAIRS];
+    int npairs = 0;
+    int nfound = 0;
+
+    if (n > ASPECT_MAX_BODIES) {
+        return -1;
+    }
+
+    // Gather the pairs into contiguous arrays
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            lon1[npairs] = lon[i];
+            lon2[npairs] = lon[j];
+            v1[npairs] = speed != NULL ? speed[i] : 0.0;
+            v2[npairs] = speed != NULL ? speed[j] : 0.0;
+            first[npairs] = (unsigned char)i;
+            second[npairs] = (unsigned char)j;
+            npairs++;
+        }
+    }
+
+    separations(lon1, lon2, v1, v2, npairs, sep, rate);
+
+    for (int p = 0; p < npairs; p++) {
+        for (int k = 0; k < naspects; k++) {
+            double delta = sep[p] - aspects[k].angle;
+
+            if (fabs(delta) <= aspects[k].orb && nfound < max_out) {
+                Aspect *a = &out[nfound++];
+
+                a->body1 = first[p];
+                a->body2 = second[p];
+                a->aspect = k;
+                a->orb = delta;
+                a->applying = delta * rate[p] < 0.0;
+            }
+        }
+    }
+
+    return nfound;
+}
+
+/**
+ * @brief Find all aspects between the bodies of a computed chart
+ *
+ * Bodies whose calculation failed are skipped, and so is the body at the centre of the frame: the Earth in a
+ * geocentric chart, whose position is meaningless, and the Sun in a heliocentric one.
+ *
+ * @param chart The planet data of the chart
+ * @param n The number of entries in chart, at most ASPECT_MAX_BODIES
+ * @param iflags The flags the chart was computed with
+ * @param aspects The aspect set
+ * @param naspects The number of aspects in the set
+ * @param out The aspects found; body1 and body2 index chart
+ * @param max_out The capacity of out
+ * @return int The number of aspects found, or -1 if there are too many bodies
+ */
+int find_chart_aspects(const PlanetData *chart, int n, int iflags, const AspectDef *aspects, int naspects,
+                       Aspect *out, int max_out) {
+    double lon[ASPECT_MAX_BODIES], speed[ASPECT_MAX_BODIES];
+    int index[ASPECT_MAX_BODIES];
+    int m = 0, nfound;
+
+    if (n > ASPECT_MAX_BODIES) {
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (chart[i].body == SE_EARTH && !(iflags & (SEFLG_HELCTR | SEFLG_BARYCTR))) {
+            continue;
+        }
+        if (chart[i].body == SE_SUN && (iflags & SEFLG_HELCTR)) {
+            continue;
+        }
+        if (chart[i].body >= 0) {
+            lon[m] = chart[i].pos;
+            speed[m] = chart[i].speed;
+            index[m] = i;
+            m++;
+        }
+    }
+
+    nfound = find_aspects(lon, speed, m, aspects, naspects, out, max_out);
+    for (int a = 0; a < nfound; a++) {
+        out[a].body1 = index[out[a].body1];
+        out[a].body2 = index[out[a].body2];
+    }
+
+    return nfound;
+}
+
+/**
+ * @brief Print the aspects of a chart in human-readable format
+ *
+ * @param chart The planet data of the chart
+ * @param found The aspects
+ * @param nfound The number of aspects
+ * @param aspects The aspect set the aspects refer to
+ */
+void print_aspects(const PlanetData *chart, const Aspect *found, int nfound, const AspectDef *aspects) {
+    char name1[AS_MAXCH], name2[AS_MAXCH];
+
+    printf("Aspects:\n");
+    for (int a = 0; a < nfound; a++) {
+        swe_get_planet_name(chart[found[a].body1].body, name1);
+        swe_get_planet_name(chart[found[a].body2].body, name2);
+        printf("%s %s %s, orb %+.4f, %s\n", name1, aspects[found[a].aspect].name, name2, found[a].orb,
+               found[a].applying ? "applying" : "separating");
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Entry point of the aspects mode: main aspects <jd_ut> [-f iflags]
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int aspects_main(int argc, char **argv) {
+    PlanetData chart[NUM_CHART_BODIES];
+    Aspect found[ASPECT_MAX_PAIRS * 2];
+    int iflags = SEFLG_SWIEPH;
+    double tjd_ut;
+    int nfound;
+
+    if (argc != 2 && !(argc == 4 && strcmp(argv[2], "-f") == 0)) {
+        fprintf(stderr, "Usage: main aspects <jd_ut> [-f iflags]\n");
+        return 1;
+    }
+    tjd_ut = atof(argv[1]);
+    if (argc == 4) {
+        iflags = atoi(argv[3]);
+    }
+
+    get_chart_data(tjd_ut, iflags, chart);
+    nfound = find_chart_aspects(chart, NUM_CHART_BODIES, iflags, default_aspects, num_default_aspects, found,
+                                sizeof(found) / sizeof(found[0]));
+
+    printf("Aspects for Julian Day %.15f\n\n", tjd_ut);
+    print_aspects(chart, found, nfound, default_aspects);
+    swe_close();
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef ASPECTS_H
+#define ASPECTS_H
+
+#include "planet.h"
+
+// Largest number of bodies find_aspects() accepts in one chart
+#define ASPECT_MAX_BODIES 32
+#define ASPECT_MAX_PAIRS (ASPECT_MAX_BODIES * (ASPECT_MAX_BODIES - 1) / 2)
+
+// An aspect type: its exact angle and the orb allowed around it, in degrees
+typedef struct {
+    const char *name;
+    double angle;
+    double orb;
+} AspectDef;
+
+// One aspect found between two bodies of a chart
+typedef struct {
+    int body1;     // index of the first body in the input arrays
+    int body2;     // index of the second body, body2 > body1
+    int aspect;    // index in the aspect set
+    double orb;    // separation minus the exact angle, degrees
+    int applying;  // non-zero if the separation is moving towards the exact angle
+} Aspect;
+
+extern const AspectDef default_aspects[];
+extern const int num_default_aspects;
+
+int find_aspects(const double *lon, const double *speed, int n, const AspectDef *aspects, int naspects, Aspect *out,
+                 int max_out);
+int find_chart_aspects(const PlanetData *chart, int n, int iflags, const AspectDef *aspects, int naspects,
+                       Aspect *out, int max_out);
+void print_aspects(const PlanetData *chart, const Aspect *found, int nfound, const AspectDef *aspects);
+
+int aspects_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,258 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "astrocarto.h"
+#include "output.h"
+#include "planet.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Astrocartography lines
+ *
+ * At a given instant a body with right ascension RA and declination dec culminates (MC) where the local sidereal
+ * time equals RA, that is at longitude RA - GST for every latitude, and anti-culminates (IC) 180 degrees away. It
+ * rises (ASC) or sets (DSC) where its hour angle is -H0 or +H0, with cos H0 = -tan(lat) tan(dec): a curve that
+ * exists only where |tan(lat) tan(dec)| <= 1, since closer to the poles the body is circumpolar or never rises.
+ *
+ * So the whole map needs one swe_calc_ut() per body and one swe_sidtime() per instant, instead of house cusps at
+ * every point of a raster. The lines are sampled on a latitude grid: tan(lat) is computed once for all bodies, and
+ * each body's lines are filled by branch-free loops over contiguous arrays (acos() of a value outside [-1, 1] is
+ * NAN, which marks the latitudes without a crossing). The ascendant is the body's own rising in mundo, on the
+ * geometric horizon, as astrocartography maps draw it.
+ */
+
+const char *const acg_angle_names[ACG_NUM_ANGLES] = {"MC", "IC", "ASC", "DSC"};
+
+/**
+ * @brief Normalize a longitude to [-180, 180)
+ */
+static double lon_norm(double lon) { return lon - 360.0 * floor((lon + 180.0) / 360.0); }
+
+/**
+ * @brief Compute the MC, IC, ASC and DSC lines of bodies for an instant
+ *
+ * @param tjd_ut The Julian Day (UT)
+ * @param iflags The flags for the Swiss Ephemeris; the positions are always equatorial
+ * @param bodies The planet IDs
+ * @param nbodies The number of planet IDs
+ * @param lat The latitudes to sample the lines at, degrees
+ * @param nlat The number of latitudes
+ * @param lon The longitudes of the lines, in [-180, 180): lon[(body * ACG_NUM_ANGLES + angle) * nlat + i] at lat[i],
+ *            NAN where the body never reaches the angle at that latitude
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR if a body failed or out of memory
+ */
+int acg_lines(double tjd_ut, int iflags, const int *bodies, int nbodies, const double *lat, int nlat, double *lon,
+              char *serr) {
+    double gst = swe_sidtime(tjd_ut) * 15.0;
+    double *tan_lat = (double *)malloc((nlat + 1) * sizeof(double));
+
+    if (tan_lat == NULL) {
+        strcpy(serr, "out of memory");
+        return ERR;
+    }
+    for (int i = 0; i < nlat; i++) {
+        tan_lat[i] = tan(lat[i] * DEGTORAD);
+    }
+
+    for (int b = 0; b < nbodies; b++) {
+        double *mc = &lon[(size_t)(b * ACG_NUM_ANGLES + ACG_MC) * nlat];
+        double *ic = &lon[(size_t)(b * ACG_NUM_ANGLES + ACG_IC) * nlat];
+        double *asc = &lon[(size_t)(b * ACG_NUM_ANGLES + ACG_ASC) * nlat];
+        double *dsc = &lon[(size_t)(b * ACG_NUM_ANGLES + ACG_DSC) * nlat];
+        double xx[6], mc_lon, ic_lon, tan_dec, ra;
+
+        if (swe_calc_ut(tjd_ut, bodies[b], (iflags & ~SEFLG_SIDEREAL) | SEFLG_EQUATORIAL, xx, serr) == ERR) {
+            free(tan_lat);
+            return ERR;
+        }
+        ra = xx[0];
+        tan_dec = tan(xx[1] * DEGTORAD);
+        mc_lon = lon_norm(ra - gst);
+        ic_lon = lon_norm(ra - gst + 180.0);
+
+        for (int i = 0; i < nlat; i++) {
+            mc[i] = mc_lon;
+            ic[i] = ic_lon;
+        }
+        for (int i = 0; i < nlat; i++) {
+            double h0 = acos(-tan_lat[i] * tan_dec) * RADTODEG;
+
+            asc[i] = lon_norm(ra - gst - h0);
+            dsc[i] = lon_norm(ra - gst + h0);
+        }
+    }
+
+    free(tan_lat);
+
+    return OK;
+}
+
+/**
+ * @brief Write one line of a body as polylines: a new segment starts after a gap or a wrap at longitude 180
+ *
+ * @return long The number of segments written
+ */
+static long write_line(Writer *w, OutputFormat fmt, const char *name, const char *angle, const double *lat,
+                       const double *lon, int nlat, long segment) {
+    int open = 0;
+    long nsegments = 0;
+
+    for (int i = 0; i <= nlat; i++) {
+        int breaks = i == nlat || isnan(lon[i]) || (i > 0 && fabs(lon[i] - lon[i - 1]) > 180.0);
+
+        if (open && breaks) {
+            if (fmt == OUTPUT_JSONL) {
+                writer_str(w, "]}\n");
+            } else if (fmt == OUTPUT_TEXT) {
+                writer_char(w, '\n');
+            }
+            open = 0;
+        }
+        if (i == nlat || isnan(lon[i])) {
+            continue;
+        }
+
+        if (!open) {
+            open = 1;
+            nsegments++;
+            if (fmt == OUTPUT_JSONL) {
+                writer_str(w, "{\"body\":\"");
+                writer_str(w, name);
+                writer_str(w, "\",\"angle\":\"");
+                writer_str(w, angle);
+                writer_str(w, "\",\"coordinates\":[");
+            }
+        } else if (fmt == OUTPUT_JSONL) {
+            writer_char(w, ',');
+        }
+
+        // Points are [lon, lat] in JSON, as in GeoJSON
+        if (fmt == OUTPUT_JSONL) {
+            writer_char(w, '[');
+            writer_trimmed(w, lon[i], 6);
+            writer_char(w, ',');
+            writer_trimmed(w, lat[i], 6);
+            writer_char(w, ']');
+        } else {
+            writer_str(w, name);
+            writer_char(w, fmt == OUTPUT_CSV ? ',' : ' ');
+            writer_str(w, angle);
+            writer_char(w, fmt == OUTPUT_CSV ? ',' : ' ');
+            if (fmt == OUTPUT_CSV) {
+                writer_long(w, segment + nsegments);
+                writer_char(w, ',');
+            }
+            writer_fixed(w, lat[i], 6);
+            writer_char(w, fmt == OUTPUT_CSV ? ',' : ' ');
+            writer_fixed(w, lon[i], 6);
+            writer_char(w, '\n');
+        }
+    }
+
+    return nsegments;
+}
+
+/**
+ * @brief Entry point of the astrocartography mode
+ *
+ * main astrocarto <jd> [-b bodies] [-s lat_step] [-m max_lat] [-o text|csv|jsonl] [-f iflags]
+ *
+ * Writes the MC, IC, ASC and DSC lines of every body as polylines sampled along latitude from -max_lat to max_lat.
+ * Text output has one "body angle lat lon" line per point and a blank line between segments; CSV adds a segment
+ * number; JSON Lines has one object per segment with its [lon, lat] coordinates.
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int astrocarto_main(int argc, char **argv) {
+    int bodies[SE_NPLANETS];
+    int nbodies = SE_PLUTO + 1;
+    int iflags = SEFLG_SWIEPH;
+    double step = ACG_DEFAULT_STEP, max_lat = ACG_DEFAULT_MAX_LAT;
+    OutputFormat fmt = OUTPUT_TEXT;
+    double *lat, *lon;
+    int nlat;
+    long segment = 0;
+    Writer w;
+    char serr[256];
+    int ret = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: main astrocarto <jd> [-b bodies] [-s lat_step] [-m max_lat] [-o text|csv|jsonl] "
+                        "[-f iflags]\n");
+        return 1;
+    }
+
+    for (int i = 0; i < nbodies; i++) {
+        bodies[i] = i;
+    }
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-b") == 0) {
+            nbodies = parse_body_list(argv[i + 1], bodies, SE_NPLANETS);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            step = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "-m") == 0) {
+            max_lat = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "-o") == 0) {
+            if (parse_output_format(argv[i + 1], &fmt) == ERR) {
+                fprintf(stderr, "Error: unknown output format %s\n", argv[i + 1]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-f") == 0) {
+            iflags = atoi(argv[i + 1]);
+        }
+    }
+    if (nbodies <= 0) {
+        fprintf(stderr, "Error: invalid body list\n");
+        return 1;
+    }
+    if (step <= 0.0 || max_lat <= 0.0 || max_lat >= 90.0) {
+        fprintf(stderr, "Error: the latitude step must be positive and the maximum latitude below 90\n");
+        return 1;
+    }
+
+    nlat = (int)floor(2.0 * max_lat / step + 1e-9) + 1;
+    lat = (double *)malloc(nlat * sizeof(double));
+    lon = (double *)malloc((size_t)nbodies * ACG_NUM_ANGLES * nlat * sizeof(double));
+    if (lat == NULL || lon == NULL || writer_open(&w, STDOUT_FILENO, 0) == ERR) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(lat);
+        free(lon);
+        return 1;
+    }
+    for (int i = 0; i < nlat; i++) {
+        lat[i] = -max_lat + i * step;
+    }
+
+    if (acg_lines(atof(argv[1]), iflags, bodies, nbodies, lat, nlat, lon, serr) == ERR) {
+        fprintf(stderr, "Error: %s\n", serr);
+        ret = 1;
+    } else {
+        if (fmt == OUTPUT_CSV) {
+            writer_str(&w, "body,angle,segment,lat,lon\n");
+        }
+        for (int b = 0; b < nbodies; b++) {
+            char name[AS_MAXCH];
+
+            swe_get_planet_name(bodies[b], name);
+            for (int a = 0; a < ACG_NUM_ANGLES; a++) {
+                segment += write_line(&w, fmt, name, acg_angle_names[a], lat,
+                                      &lon[(size_t)(b * ACG_NUM_ANGLES + a) * nlat], nlat, segment);
+            }
+        }
+    }
+    if (writer_close(&w) == ERR) {
+        ret = 1;
+    }
+
+    free(lat);
+    free(lon);
+    swe_close();
+
+    return ret;
+}
@@ -0,0 +1,19 @@
+#ifndef ASTROCARTO_H
+#define ASTROCARTO_H
+
+#include "swephexp.h"
+
+typedef enum { ACG_MC, ACG_IC, ACG_ASC, ACG_DSC, ACG_NUM_ANGLES } AcgAngle;
+
+// Default latitude sampling of the lines, degrees; the ascendant lines run off to the poles near the Arctic circles
+#define ACG_DEFAULT_STEP 1.0
+#define ACG_DEFAULT_MAX_LAT 80.0
+
+extern const char *const acg_angle_names[ACG_NUM_ANGLES];
+
+int acg_lines(double tjd_ut, int iflags, const int *bodies, int nbodies, const double *lat, int nlat, double *lon,
+              char *serr);
+
+int astrocarto_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,768 @@
+#include "aspects.h"
+#include "batch.h"
+#include "houses.h"
+#include "ingest.h"
+#include "instr.h"
+#include "output.h"
+#include "planet.h"
+#include "pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Number of charts read before they are computed and printed
+#define BATCH_BLOCK 1024
+
+// One parsed chart waiting in the current block
+typedef struct {
+    double tjd_ut;
+    int iflags;
+    double topo[3]; // geographic longitude, latitude and altitude
+    int status;     // OK, or ERR if a body could not be computed; set by compute_chart()
+} BatchChart;
+
+/**
+ * @brief Parse one birth record line
+ *
+ * See parse_birth_fields() for the format.
+ *
+ * @param line The input line
+ * @param default_iflags The flags used when the record does not carry its own
+ * @param rec The parsed record
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR on malformed input
+ */
+int parse_birth_record(const char *line, int default_iflags, BirthRecord *rec, char *serr) {
+    return parse_birth_fields(line, line + strlen(line), default_iflags, rec, serr);
+}
+
+/**
+ * @brief Convert the local civil time of a record to a Julian Day in Universal Time
+ *
+ * @param rec The birth record
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR on invalid dates
+ */
+int birth_record_to_jd(const BirthRecord *rec, double *tjd_ut, char *serr) {
+    int32 year, month, day, hour, min;
+    double sec;
+    double dret[2];
+    uint64_t t0 = instr_start();
+    int32 ret;
+
+    // Shift the local time to UTC, then convert UTC to JD (dret[0] is TT, dret[1] is UT1)
+    swe_utc_time_zone(rec->year, rec->month, rec->day, rec->hour, rec->min, rec->sec, rec->tz, &year, &month, &day,
+                      &hour, &min, &sec);
+    ret = swe_utc_to_jd(year, month, day, hour, min, sec, SE_GREG_CAL, dret, serr);
+    instr_stop(STAGE_TIME_CONV, t0);
+    if (ret == ERR) {
+        return ERR;
+    }
+
+    *tjd_ut = dret[1];
+
+    return OK;
+}
+
+/**
+ * @brief Compute one chart of a block into its slice of the block's planet array
+ *
+ * The bodies are placed in the houses of the record's location.
+ *
+ * @param chart The chart; its status is set
+ * @param hsys The house system letter
+ * @param planets The NUM_CHART_BODIES entries of the chart
+ */
+static void compute_chart(BatchChart *chart, int hsys, PlanetData *planets) {
+    HouseData houses;
+    char serr[256];
+    uint64_t t0;
+
+    if (chart->iflags & SEFLG_TOPOCTR) {
+        swe_set_topo(chart->topo[0], chart->topo[1], chart->topo[2]);
+    }
+
+    chart->status = get_chart_data(chart->tjd_ut, chart->iflags, planets);
+
+    if (!houses_can_place(chart->iflags)) {
+        mark_houses_unknown(planets, NUM_CHART_BODIES);
+        return;
+    }
+
+    // A polar latitude only degrades the house system to Porphyry, in the cusps and in houses.hsys alike; a zero
+    // house system means that the sidereal time or the obliquity could not be computed
+    t0 = instr_start();
+    if (compute_houses(chart->tjd_ut, chart->iflags, hsys, chart->topo[1], chart->topo[0], &houses, serr) == ERR &&
+        houses.hsys == 0) {
+        mark_houses_unknown(planets, NUM_CHART_BODIES);
+    } else {
+        place_in_houses(&houses, planets, NUM_CHART_BODIES);
+    }
+    instr_stop(STAGE_HOUSES, t0);
+}
+
+typedef struct {
+    BatchChart *charts;
+    int hsys;
+    PlanetData *planets;
+} ChartBlockCtx;
+
+static void chart_block_task(void *ctx, size_t begin, size_t end, int worker) {
+    ChartBlockCtx *c = (ChartBlockCtx *)ctx;
+
+    (void)worker;
+
+    for (size_t i = begin; i < end; i++) {
+        compute_chart(&c->charts[i], c->hsys, &c->planets[i * NUM_CHART_BODIES]);
+    }
+}
+
+/**
+ * @brief Compute and print a block of charts, in input order
+ *
+ * The charts are computed into the caller-owned planet array first, on the pool when there is one, and written
+ * afterwards. A chart with failed bodies is still written, with those bodies marked, and counted as an error.
+ *
+ * @param charts The charts of the block
+ * @param n The number of charts
+ * @param first_num The number of the first chart
+ * @param pool The pool, or NULL to compute on the calling thread
+ * @param planets Storage for n * NUM_CHART_BODIES planet data structures
+ * @param opts The options of the run
+ * @param out The output writer
+ * @return long The number of charts with failed bodies
+ */
+static long flush_charts(BatchChart *charts, int n, long first_num, ThreadPool *pool, PlanetData *planets,
+                         const BatchOptions *opts, Writer *out) {
+    long errors = 0;
+
+    if (pool == NULL) {
+        for (int c = 0; c < n; c++) {
+            compute_chart(&charts[c], opts->hsys, &planets[c * NUM_CHART_BODIES]);
+        }
+    } else {
+        ChartBlockCtx ctx = {charts, opts->hsys, planets};
+
+        pool_run(pool, (size_t)n, 0, chart_block_task, &ctx);
+    }
+
+    for (int c = 0; c < n; c++) {
+        const PlanetData *chart = &planets[c * NUM_CHART_BODIES];
+        Aspect found[ASPECT_MAX_PAIRS];
+        int nfound = 0;
+        uint64_t t0;
+
+        if (charts[c].status == ERR) {
+            fprintf(stderr, "Error: chart %ld: some bodies could not be computed\n", first_num + c);
+            errors++;
+        }
+
+        if (opts->columnar != NULL) {
+            t0 = instr_start();
+            columnar_add_chart(opts->columnar, first_num + c, charts[c].tjd_ut, chart, NUM_CHART_BODIES);
+            instr_stop(STAGE_OUTPUT, t0);
+            continue;
+        }
+
+        if (opts->aspects) {
+            nfound = find_chart_aspects(chart, NUM_CHART_BODIES, charts[c].iflags, default_aspects,
+                                        num_default_aspects, found, ASPECT_MAX_PAIRS);
+        }
+
+        t0 = instr_start();
+        write_chart(out, opts->format, first_num + c, charts[c].tjd_ut, chart, NUM_CHART_BODIES,
+                    opts->aspects ? found : NULL, nfound, default_aspects);
+        instr_stop(STAGE_OUTPUT, t0);
+    }
+
+    return errors;
+}
+
+// State of a run shared by the stream and the mapped readers
+typedef struct {
+    const BatchOptions *opts;
+    ThreadPool *pool;
+    BatchChart *charts; // the current block
+    PlanetData *planets;
+    int n;              // charts in the current block
+    long chart_num;     // charts flushed so far
+    long errors;        // charts with failed bodies so far
+    Writer out;
+} BatchRun;
+
+/**
+ * @brief Allocate the block storage of a run and write the output header
+ *
+ * @return int OK on success, ERR when out of memory
+ */
+static int batch_begin(BatchRun *run, const BatchOptions *opts, ThreadPool *pool) {
+    memset(run, 0, sizeof(*run));
+    run->opts = opts;
+    run->pool = pool;
+
+    // Block storage is allocated once per run and reused for every block
+    run->charts = (BatchChart *)malloc(BATCH_BLOCK * sizeof(BatchChart));
+    run->planets = (PlanetData *)malloc(BATCH_BLOCK * NUM_CHART_BODIES * sizeof(PlanetData));
+
+    // Charts bypass stdio: whatever stdio holds must go out first
+    fflush(stdout);
+    if (run->charts == NULL || run->planets == NULL || writer_open(&run->out, STDOUT_FILENO, 0) == ERR) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(run->charts);
+        free(run->planets);
+        return ERR;
+    }
+    if (opts->columnar == NULL) {
+        write_output_header(&run->out, opts->format);
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Append a parsed record to the current block, computing and writing the block when it is full
+ */
+static void batch_add(BatchRun *run, double tjd_ut, const BirthRecord *rec) {
+    BatchChart *chart = &run->charts[run->n];
+
+    chart->tjd_ut = tjd_ut;
+    chart->iflags = rec->iflags;
+    chart->topo[0] = rec->lon;
+    chart->topo[1] = rec->lat;
+    chart->topo[2] = 0;
+
+    if (++run->n == BATCH_BLOCK) {
+        run->errors +=
+            flush_charts(run->charts, run->n, run->chart_num + 1, run->pool, run->planets, run->opts, &run->out);
+        run->chart_num += run->n;
+        run->n = 0;
+        instr_poll(stderr);
+    }
+}
+
+/**
+ * @brief Write the last block and release the run
+ *
+ * @return long The number of charts with failed bodies, plus 1 if the output could not be written
+ */
+static long batch_end(BatchRun *run) {
+    long errors = run->errors;
+
+    errors += flush_charts(run->charts, run->n, run->chart_num + 1, run->pool, run->planets, run->opts, &run->out);
+
+    if (writer_close(&run->out) == ERR) {
+        fprintf(stderr, "Error: cannot write the output\n");
+        errors++;
+    }
+    free(run->charts);
+    free(run->planets);
+
+    return errors;
+}
+
+/**
+ * @brief Tell whether a line holds a record: blank lines, comments and a header on the first line do not
+ *
+ * @param p The first non-blank character of the line
+ * @param line_num The line number
+ */
+static int is_record_line(const char *p, long line_num) {
+    if (*p == '\n' || *p == '\r' || *p == '#') {
+        return 0;
+    }
+
+    // A CSV or TSV export starts with its column names
+    return line_num > 1 || (*p >= '0' && *p <= '9') || *p == '-' || *p == '+';
+}
+
+/**
+ * @brief Read every birth record of a file, with its Julian Day
+ *
+ * Blank lines and comments are skipped; malformed records are reported on stderr and skipped too.
+ *
+ * @param path The file path, "-" for stdin
+ * @param default_iflags The flags used when a record does not carry its own
+ * @param recs The records, to be released with free()
+ * @param tjd_ut The Julian Days (UT) of the records, to be released with free()
+ * @param nskipped The number of malformed records skipped, or NULL
+ * @return long The number of records, or -1 if the file cannot be read or out of memory (nothing to release then)
+ */
+long read_birth_file(const char *path, int default_iflags, BirthRecord **recs, double **tjd_ut, long *nskipped) {
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    char line[1024], serr[256];
+    long n = 0, cap = 0, line_num = 0;
+
+    *recs = NULL;
+    *tjd_ut = NULL;
+    if (nskipped != NULL) {
+        *nskipped = 0;
+    }
+    if (in == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        BirthRecord rec;
+        double jd;
+        const char *p = line;
+
+        line_num++;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '\0' || !is_record_line(p, line_num)) {
+            continue;
+        }
+        if (parse_birth_record(p, default_iflags, &rec, serr) == ERR || birth_record_to_jd(&rec, &jd, serr) == ERR) {
+            fprintf(stderr, "Error: line %ld: %s\n", line_num, serr);
+            if (nskipped != NULL) {
+                (*nskipped)++;
+            }
+            continue;
+        }
+        if (n == cap) {
+            BirthRecord *r;
+            double *t;
+
+            cap = cap ? 2 * cap : 1024;
+            r = (BirthRecord *)realloc(*recs, cap * sizeof(BirthRecord));
+            if (r != NULL) {
+                *recs = r;
+            }
+            t = (double *)realloc(*tjd_ut, cap * sizeof(double));
+            if (t != NULL) {
+                *tjd_ut = t;
+            }
+            if (r == NULL || t == NULL) {
+                n = -1;
+                break;
+            }
+        }
+        (*recs)[n] = rec;
+        (*tjd_ut)[n] = jd;
+        n++;
+    }
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (n < 0) {
+        free(*recs);
+        free(*tjd_ut);
+        *recs = NULL;
+        *tjd_ut = NULL;
+    }
+
+    return n;
+}
+
+/**
+ * @brief Compute and print one chart per record read from the input stream
+ *
+ * Records are processed in blocks of BATCH_BLOCK charts. The ephemeris stays open for the whole run; the caller
+ * is responsible for swe_close().
+ *
+ * @param in The input stream
+ * @param opts The options of the run
+ * @param pool The pool used to compute the charts, or NULL to compute them on the calling thread
+ * @return long The number of records that could not be processed or gave charts with failed bodies
+ */
+long run_batch(FILE *in, const BatchOptions *opts, ThreadPool *pool) {
+    char line[1024];
+    char serr[256];
+    long line_num = 0;
+    long errors = 0;
+    BatchRun run;
+
+    if (batch_begin(&run, opts, pool) == ERR) {
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        BirthRecord rec;
+        double tjd_ut;
+        const char *p = line;
+
+        line_num++;
+
+        // Skip blank lines and comments
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '\0' || !is_record_line(p, line_num)) {
+            continue;
+        }
+
+        if (parse_birth_record(p, opts->iflags, &rec, serr) == ERR ||
+            birth_record_to_jd(&rec, &tjd_ut, serr) == ERR) {
+            fprintf(stderr, "Error: line %ld: %s\n", line_num, serr);
+            errors++;
+            continue;
+        }
+        batch_add(&run, tjd_ut, &rec);
+    }
+
+    return errors + batch_end(&run);
+}
+
+typedef struct {
+    long line; // line number within the piece, from 1
+    char serr[256];
+} PieceError;
+
+// Records parsed from one piece of the mapping; the arrays are reused from window to window
+typedef struct {
+    BirthRecord *recs;
+    double *tjd_ut;
+    size_t n;
+    size_t cap;
+    PieceError *errors;
+    size_t nerrors;
+    size_t errors_cap;
+    long nlines;
+    int out_of_memory;
+} ParsedPiece;
+
+typedef struct {
+    const char *data;
+    const size_t *bounds;
+    ParsedPiece *pieces;
+    long first_line; // number of the first line of the window
+    int iflags;
+} ParseCtx;
+
+static int grow(void **p, size_t *cap, size_t size) {
+    size_t ncap = *cap ? *cap * 2 : 1024;
+    void *np = realloc(*p, ncap * size);
+
+    if (np == NULL) {
+        return ERR;
+    }
+    *p = np;
+    *cap = ncap;
+
+    return OK;
+}
+
+/**
+ * @brief Parse the records of one piece of the mapping and convert their times
+ */
+static void parse_piece(const char *p, const char *end, long first_line, int iflags, ParsedPiece *piece) {
+    piece->n = 0;
+    piece->nerrors = 0;
+    piece->nlines = 0;
+
+    while (p < end && !piece->out_of_memory) {
+        const char *eol = (const char *)memchr(p, '\n', (size_t)(end - p));
+        const char *next = eol != NULL ? eol + 1 : end;
+        char serr[256];
+
+        piece->nlines++;
+        if (eol == NULL) {
+            eol = end;
+        }
+        while (p < eol && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+        if (p == eol || !is_record_line(p, first_line + piece->nlines - 1)) {
+            p = next;
+            continue;
+        }
+
+        if (piece->n == piece->cap) {
+            size_t cap = piece->cap;
+
+            if (grow((void **)&piece->recs, &cap, sizeof(BirthRecord)) == ERR ||
+                grow((void **)&piece->tjd_ut, &piece->cap, sizeof(double)) == ERR) {
+                piece->out_of_memory = 1;
+                break;
+            }
+        }
+
+        if (parse_birth_fields(p, eol, iflags, &piece->recs[piece->n], serr) == ERR ||
+            birth_record_to_jd(&piece->recs[piece->n], &piece->tjd_ut[piece->n], serr) == ERR) {
+            if (piece->nerrors == piece->errors_cap &&
+                grow((void **)&piece->errors, &piece->errors_cap, sizeof(PieceError)) == ERR) {
+                piece->out_of_memory = 1;
+                break;
+            }
+            piece->errors[piece->nerrors].line = piece->nlines;
+            strcpy(piece->errors[piece->nerrors].serr, serr);
+            piece->nerrors++;
+        } else {
+            piece->n++;
+        }
+        p = next;
+    }
+}
+
+static void parse_piece_task(void *ctx, size_t begin, size_t end, int worker) {
+    ParseCtx *c = (ParseCtx *)ctx;
+
+    (void)worker;
+
+    for (size_t i = begin; i < end; i++) {
+        // Only the first piece of a window knows its line numbers, and only it can hold the header line
+        parse_piece(c->data + c->bounds[i], c->data + c->bounds[i + 1], i == 0 ? c->first_line : 2, c->iflags,
+                    &c->pieces[i]);
+    }
+}
+
+/**
+ * @brief Compute and print one chart per record of a memory-mapped input file
+ *
+ * The mapping is processed in windows of INGEST_WINDOW bytes. Each window is cut at line boundaries into pieces
+ * that are parsed in parallel on the pool, in place; the records then go through the same blocks as run_batch(),
+ * in file order, and errors are reported with their line numbers once the window is parsed.
+ *
+ * @param in The mapped input
+ * @param opts The options of the run
+ * @param pool The pool used to parse the input and compute the charts, or NULL for the calling thread
+ * @return long The number of records that could not be processed or gave charts with failed bodies
+ */
+static long run_batch_mapped(const MappedInput *in, const BatchOptions *opts, ThreadPool *pool) {
+    ParsedPiece pieces[INGEST_MAX_CHUNKS];
+    size_t bounds[INGEST_MAX_CHUNKS + 1];
+    size_t npieces = pool != NULL ? (size_t)pool_size(pool) * 4 : 1;
+    size_t pos = 0;
+    long line_num = 1;
+    long errors = 0;
+    int out_of_memory = 0;
+    BatchRun run;
+
+    if (npieces > INGEST_MAX_CHUNKS) {
+        npieces = INGEST_MAX_CHUNKS;
+    }
+    if (batch_begin(&run, opts, pool) == ERR) {
+        return 1;
+    }
+    memset(pieces, 0, sizeof(pieces));
+
+    while (pos < in->size && !out_of_memory) {
+        size_t end = in->size - pos > INGEST_WINDOW ? pos + INGEST_WINDOW : in->size;
+        const char *nl = (const char *)memchr(in->data + end - 1, '\n', in->size - end + 1);
+        ParseCtx ctx;
+        size_t n;
+
+        // The window ends after a newline, like the pieces inside it
+        end = nl != NULL ? (size_t)(nl - in->data) + 1 : in->size;
+        n = ingest_split(in->data + pos, end - pos, npieces, bounds);
+
+        ctx.data = in->data + pos;
+        ctx.bounds = bounds;
+        ctx.pieces = pieces;
+        ctx.first_line = line_num;
+        ctx.iflags = opts->iflags;
+        if (pool != NULL && n > 1) {
+            pool_run(pool, n, 1, parse_piece_task, &ctx);
+        } else {
+            parse_piece_task(&ctx, 0, n, 0);
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            ParsedPiece *piece = &pieces[i];
+
+            if (piece->out_of_memory) {
+                fprintf(stderr, "Error: out of memory\n");
+                errors++;
+                out_of_memory = 1;
+                break;
+            }
+            for (size_t e = 0; e < piece->nerrors; e++) {
+                fprintf(stderr, "Error: line %ld: %s\n", line_num + piece->errors[e].line - 1, piece->errors[e].serr);
+            }
+            errors += (long)piece->nerrors;
+            for (size_t r = 0; r < piece->n; r++) {
+                batch_add(&run, piece->tjd_ut[r], &piece->recs[r]);
+            }
+            line_num += piece->nlines;
+        }
+
+        ingest_release(in, pos, end);
+        pos = end;
+    }
+
+    for (size_t i = 0; i < INGEST_MAX_CHUNKS; i++) {
+        free(pieces[i].recs);
+        free(pieces[i].tjd_ut);
+        free(pieces[i].errors);
+    }
+
+    return errors + batch_end(&run);
+}
+
+/**
+ * @brief Print the usage of the batch mode
+ */
+static void batch_usage(void) {
+    fprintf(stderr, "Usage: main batch [options] [file]\n"
+                    "  -a             print the aspects of each chart\n"
+                    "  -e ephe_path   ephemeris directory\n"
+                    "  -c cheb_file   answer positions from a Chebyshev cache where it covers them\n"
+                    "  -C entries     keep up to this many computed positions in an LRU cache\n"
+                    "  -t table       answer positions from a memory-mapped ephemeris table (before -c)\n"
+                    "  -f iflags      flags for records that do not carry their own\n"
+                    "  -H hsys        house system letter, Placidus (P) by default; houses are left empty\n"
+                    "                 unless the flags give geocentric ecliptic positions\n"
+                    "  -I             time every stage; dumped at exit and on SIGUSR1\n"
+                    "  -j threads     compute on a pool of worker threads, 0 for one per processor\n"
+                    "  -o format      text (default), csv or jsonl\n"
+                    "  -O file        write the charts to a columnar file instead (see main columnar); not with\n"
+                    "                 -o or -a\n");
+}
+
+/**
+ * @brief Entry point of the batch mode
+ *
+ * Reads birth records from the given file, or from stdin when the file is missing or "-", and writes one chart per
+ * record. A regular file is memory-mapped and parsed in place, other inputs are read line by line. With -j the
+ * records are parsed and the charts computed on a pool of worker threads; the output order is unchanged. See
+ * batch_usage() for the options.
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int batch_main(int argc, char **argv) {
+    BatchOptions opts = {SEFLG_SWIEPH, DEFAULT_HOUSE_SYSTEM, 0, OUTPUT_TEXT, NULL};
+    const char *columnar_path = NULL;
+    int format_given = 0;
+    int nthreads = 1;
+    const char *path = NULL;
+    FILE *in = stdin;
+    MappedInput mapped = {NULL, 0};
+    int use_map = 0;
+    WorkerConfig cfg;
+    ThreadPool *pool = NULL;
+    ChebFile *cheb = NULL;
+    EphTable *tab = NULL;
+    CalcCache *cache = NULL;
+    char serr[256];
+    long errors;
+
+    worker_config_init(&cfg);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-a") == 0) {
+            opts.aspects = 1;
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            cfg.ephe_path = argv[++i];
+            swe_set_ephe_path(cfg.ephe_path);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            cheb_close(cheb);
+            cheb = cheb_open(argv[++i], serr);
+            if (cheb == NULL) {
+                fprintf(stderr, "Error: %s\n", serr);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+            long entries = atol(argv[++i]);
+
+            calc_cache_destroy(cache);
+            cache = entries < 0 ? NULL : calc_cache_create((size_t)entries, 0);
+            if (cache == NULL) {
+                fprintf(stderr, "Error: cannot create a cache of %s entries\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            ephtab_close(tab);
+            tab = ephtab_open(argv[++i], serr);
+            if (tab == NULL) {
+                fprintf(stderr, "Error: %s\n", serr);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            opts.iflags = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-I") == 0) {
+            instr_enable();
+        } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            opts.hsys = argv[++i][0];
+            if (opts.hsys == 'G') {
+                fprintf(stderr, "Error: Gauquelin sectors are not houses\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            if (parse_output_format(argv[++i], &opts.format) == ERR) {
+                batch_usage();
+                return 1;
+            }
+            format_given = 1;
+        } else if (strcmp(argv[i], "-O") == 0 && i + 1 < argc) {
+            columnar_path = argv[++i];
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            batch_usage();
+            return 1;
+        }
+    }
+    // The columnar file holds the positions only, and nothing else is written
+    if (columnar_path != NULL && (format_given || opts.aspects)) {
+        fprintf(stderr, "Error: -O cannot be combined with -o or -a\n");
+        batch_usage();
+        return 1;
+    }
+
+    if (path != NULL && strcmp(path, "-") != 0) {
+        // Pipes and other non-regular files cannot be mapped
+        use_map = ingest_map(path, &mapped, serr) == OK;
+        in = use_map ? NULL : fopen(path, "r");
+        if (!use_map && in == NULL) {
+            perror(path);
+            return 1;
+        }
+    }
+
+    if (columnar_path != NULL) {
+        opts.columnar = columnar_create(columnar_path, 0, serr);
+        if (opts.columnar == NULL) {
+            fprintf(stderr, "Error: %s\n", serr);
+            return 1;
+        }
+    }
+
+    if (nthreads != 1) {
+        pool = pool_create(nthreads, &cfg);
+        if (pool == NULL) {
+            fprintf(stderr, "Error: cannot start worker threads\n");
+            return 1;
+        }
+    }
+
+    set_cheb_cache(cheb);
+    set_ephtab(tab);
+    set_calc_cache(cache);
+    errors = use_map ? run_batch_mapped(&mapped, &opts, pool) : run_batch(in, &opts, pool);
+    if (columnar_close(opts.columnar, serr) == ERR) {
+        fprintf(stderr, "Error: %s\n", serr);
+        errors++;
+    }
+    set_calc_cache(NULL);
+    set_ephtab(NULL);
+    set_cheb_cache(NULL);
+
+    pool_destroy(pool);
+    ephtab_close(tab);
+    cheb_close(cheb);
+    if (cache != NULL) {
+        calc_cache_print_stats(cache, stderr);
+        calc_cache_destroy(cache);
+    }
+    if (instr_enabled) {
+        instr_dump(stderr);
+    }
+
+    if (in != NULL && in != stdin) {
+        fclose(in);
+    }
+    ingest_unmap(&mapped);
+    fflush(stdout);
+    swe_close();
+
+    return errors > 0 ? 1 : 0;
+}
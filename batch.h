@@ -0,0 +1,38 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "columnar.h"
+#include "output.h"
+#include "pool.h"
+#include <stdio.h>
+
+// One birth record of the batch input stream
+typedef struct {
+    int year;
+    int month;
+    int day;
+    int hour;
+    int min;
+    double sec;
+    double tz;  // UTC offset in hours, east positive
+    double lat; // geographic latitude, north positive
+    double lon; // geographic longitude, east positive
+    int iflags;
+} BirthRecord;
+
+// Options of a batch run
+typedef struct {
+    int iflags;  // flags for records that do not carry their own
+    int hsys;    // house system letter
+    int aspects; // non-zero to print the aspects of each chart
+    OutputFormat format;
+    ColumnarWriter *columnar; // if set, charts go to this columnar file instead of the output stream
+} BatchOptions;
+
+int parse_birth_record(const char *line, int default_iflags, BirthRecord *rec, char *serr);
+int birth_record_to_jd(const BirthRecord *rec, double *tjd_ut, char *serr);
+long read_birth_file(const char *path, int default_iflags, BirthRecord **recs, double **tjd_ut, long *nskipped);
+long run_batch(FILE *in, const BatchOptions *opts, ThreadPool *pool);
+int batch_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,197 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "swephexp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Swiss Ephemeris benchmark
+ *
+ * Measures the latency distribution and throughput of swe_calc_ut() and swe_calc() for every body, flag set and
+ * cache state. A warm run first computes one position and then calls the library at consecutive hours, which keeps
+ * the ephemeris files open and their segments buffered. A cold run closes the library before every call, so that
+ * each one reopens the files and reads its segments again.
+ *
+ * Usage: bench [-n calls] [-b bodies] [-e ephe_path]
+ * Output: one line per body, flag set, function and cache state with min/p50/p99 latency in microseconds and the
+ * number of calls per second, over the wall-clock time of the whole run (for a cold run, reopening included).
+ */
+
+#define BENCH_DEFAULT_CALLS 2000
+#define BENCH_MAX_BODY SE_INTP_PERG
+#define BENCH_JD_START 2451545.0
+
+typedef struct {
+    const char *name;
+    int iflags;
+} FlagSet;
+
+static const FlagSet flag_sets[] = {
+    {"swieph", SEFLG_SWIEPH},
+    {"moseph", SEFLG_MOSEPH},
+    {"speed", SEFLG_SWIEPH | SEFLG_SPEED},
+    {"helctr", SEFLG_SWIEPH | SEFLG_SPEED | SEFLG_HELCTR},
+    {"topoctr", SEFLG_SWIEPH | SEFLG_SPEED | SEFLG_TOPOCTR},
+    {"sidereal", SEFLG_SWIEPH | SEFLG_SPEED | SEFLG_SIDEREAL},
+    {"equatorial", SEFLG_SWIEPH | SEFLG_SPEED | SEFLG_EQUATORIAL},
+    {"xyz", SEFLG_SWIEPH | SEFLG_SPEED | SEFLG_XYZ},
+};
+
+#define NUM_FLAG_SETS (int)(sizeof(flag_sets) / sizeof(flag_sets[0]))
+
+typedef struct {
+    double min;
+    double p50;
+    double p99;
+    double calls_per_sec;
+    int errors;
+} BenchResult;
+
+static const char *ephe_path = NULL;
+
+static double now_sec(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Restore the library settings the flag sets rely on, e.g. after swe_close()
+ */
+static void setup_library(void) {
+    if (ephe_path != NULL) {
+        swe_set_ephe_path(ephe_path);
+    }
+    swe_set_topo(9.19, 45.46, 120.0);
+    swe_set_sid_mode(SE_SIDM_LAHIRI, 0, 0);
+}
+
+/**
+ * @brief Time n calls of one body with one flag set
+ *
+ * @param body The planet ID
+ * @param iflags The flags
+ * @param use_ut Non-zero for swe_calc_ut(), zero for swe_calc()
+ * @param cold Non-zero to close the library before every call
+ * @param n The number of calls
+ * @param lat Storage for n latencies
+ * @param res The result
+ */
+static void bench_one(int body, int iflags, int use_ut, int cold, int n, double *lat, BenchResult *res) {
+    double xx[6];
+    char serr[256];
+    double start, elapsed;
+
+    res->errors = 0;
+    setup_library();
+
+    // Warm-up call, so that a warm run starts with the files open
+    if (!cold) {
+        swe_calc_ut(BENCH_JD_START, body, iflags, xx, serr);
+    }
+
+    start = now_sec();
+    for (int i = 0; i < n; i++) {
+        double jd = BENCH_JD_START + i / 24.0;
+        double t0, t1;
+        int32 ret;
+
+        if (cold) {
+            swe_close();
+            setup_library();
+        }
+
+        t0 = now_sec();
+        ret = use_ut ? swe_calc_ut(jd, body, iflags, xx, serr) : swe_calc(jd, body, iflags, xx, serr);
+        t1 = now_sec();
+
+        lat[i] = (t1 - t0) * 1e6;
+        if (ret == ERR) {
+            res->errors++;
+        }
+    }
+    elapsed = now_sec() - start;
+
+    qsort(lat, n, sizeof(double), compare_doubles);
+    res->min = lat[0];
+    res->p50 = lat[n / 2];
+    res->p99 = lat[(int)(n * 0.99)];
+    res->calls_per_sec = elapsed > 0 ? n / elapsed : 0;
+}
+
+int main(int argc, char **argv) {
+    int bodies[BENCH_MAX_BODY + 1];
+    int nbodies = 0;
+    int ncalls = BENCH_DEFAULT_CALLS;
+    double *lat;
+
+    for (int b = 0; b <= BENCH_MAX_BODY; b++) {
+        bodies[nbodies++] = b;
+    }
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-n") == 0) {
+            ncalls = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-e") == 0) {
+            ephe_path = argv[i + 1];
+        } else if (strcmp(argv[i], "-b") == 0) {
+            char *p = argv[i + 1];
+
+            nbodies = 0;
+            while (*p != '\0' && nbodies <= BENCH_MAX_BODY) {
+                bodies[nbodies++] = (int)strtol(p, &p, 10);
+                if (*p == ',') {
+                    p++;
+                }
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [-n calls] [-b bodies] [-e ephe_path]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (ncalls < 1) {
+        fprintf(stderr, "Error: invalid number of calls\n");
+        return 1;
+    }
+
+    lat = (double *)malloc(ncalls * sizeof(double));
+    if (lat == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+
+    printf("%-4s %-10s %-8s %-5s %10s %10s %10s %12s %6s\n", "body", "flags", "call", "cache", "min_us", "p50_us",
+           "p99_us", "calls_per_s", "errors");
+    for (int b = 0; b < nbodies; b++) {
+        for (int f = 0; f < NUM_FLAG_SETS; f++) {
+            for (int use_ut = 1; use_ut >= 0; use_ut--) {
+                for (int cold = 0; cold <= 1; cold++) {
+                    // A cold call costs file opens: fewer of them give the same picture
+                    int n = cold ? (ncalls + 9) / 10 : ncalls;
+                    BenchResult res;
+
+                    bench_one(bodies[b], flag_sets[f].iflags, use_ut, cold, n, lat, &res);
+                    printf("%-4d %-10s %-8s %-5s %10.3f %10.3f %10.3f %12.0f %6d\n", bodies[b], flag_sets[f].name,
+                           use_ut ? "calc_ut" : "calc", cold ? "cold" : "warm", res.min, res.p50, res.p99,
+                           res.calls_per_sec, res.errors);
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+
+    free(lat);
+    swe_close();
+
+    return 0;
+}
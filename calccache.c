@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "calccache.h"
+#include "swephexp.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Position cache
+ *
+ * Results of the position calculation are kept under the key (Julian Day bucket, body, flags). The cache is split
+ * into shards, each with its own lock, hash table and LRU list, so that the threads of a pool rarely wait for each
+ * other. All memory is allocated when the cache is created; a full shard evicts its least recently used entry.
+ * Lists and hash chains link entries by index, -1 ending them.
+ */
+
+#define CALC_CACHE_SHARDS 16
+
+// Largest entry count of a shard; keeps the indices and the bucket count within 32 bits
+#define CALC_CACHE_MAX_PER_SHARD (1 << 30)
+
+typedef struct {
+    int64_t jdq;    // Julian Day bucket
+    int32_t body;
+    int32_t iflags;
+    int32_t prev;   // LRU list, most recent first
+    int32_t next;
+    int32_t chain;  // next entry of the same hash bucket
+    double xx[6];
+} CacheEntry;
+
+typedef struct {
+    pthread_mutex_t lock;
+    CacheEntry *entries;
+    int32_t *buckets;
+    uint32_t bucket_mask;
+    int32_t capacity;
+    int32_t used;
+    int32_t head;   // most recently used
+    int32_t tail;   // least recently used, evicted first
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+} CacheShard;
+
+struct CalcCache {
+    double quantum;
+    int nshards;    // shards initialized so far, the ones calc_cache_destroy() releases
+    CacheShard shards[CALC_CACHE_SHARDS];
+};
+
+static uint64_t hash_key(int64_t jdq, int body, int iflags) {
+    uint64_t h = (uint64_t)jdq ^ ((uint64_t)(uint32_t)body << 32);
+
+    h ^= (uint64_t)(uint32_t)iflags * 0x9e3779b97f4a7c15ULL;
+
+    // splitmix64 finalizer
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+
+    return h;
+}
+
+/**
+ * @brief Create a cache
+ *
+ * @param capacity The maximum number of positions kept (0 for CALC_CACHE_DEFAULT_ENTRIES)
+ * @param quantum The width of a Julian Day bucket, days (0 for CALC_CACHE_DEFAULT_QUANTUM); every request within a
+ *                bucket is answered with the position of the first one
+ * @return CalcCache* The cache, or NULL if out of memory or the capacity is too large
+ */
+CalcCache *calc_cache_create(size_t capacity, double quantum) {
+    CalcCache *cache = (CalcCache *)calloc(1, sizeof(CalcCache));
+    size_t per_shard;
+
+    if (cache == NULL) {
+        return NULL;
+    }
+    if (capacity == 0) {
+        capacity = CALC_CACHE_DEFAULT_ENTRIES;
+    }
+    per_shard = capacity / CALC_CACHE_SHARDS + (capacity % CALC_CACHE_SHARDS != 0);
+    if (per_shard > CALC_CACHE_MAX_PER_SHARD) {
+        free(cache);
+        return NULL;
+    }
+    cache->quantum = quantum > 0 ? quantum : CALC_CACHE_DEFAULT_QUANTUM;
+
+    for (int s = 0; s < CALC_CACHE_SHARDS; s++) {
+        CacheShard *shard = &cache->shards[s];
+        uint32_t nbuckets = 16;
+
+        // At most one entry per two buckets keeps the chains short
+        while (nbuckets < 2 * per_shard) {
+            nbuckets *= 2;
+        }
+
+        if (pthread_mutex_init(&shard->lock, NULL) != 0) {
+            calc_cache_destroy(cache);
+            return NULL;
+        }
+        cache->nshards = s + 1;
+        shard->entries = (CacheEntry *)malloc(per_shard * sizeof(CacheEntry));
+        shard->buckets = (int32_t *)malloc(nbuckets * sizeof(int32_t));
+        shard->bucket_mask = nbuckets - 1;
+        shard->capacity = (int32_t)per_shard;
+        shard->head = shard->tail = -1;
+        if (shard->entries == NULL || shard->buckets == NULL) {
+            calc_cache_destroy(cache);
+            return NULL;
+        }
+        memset(shard->buckets, 0xff, nbuckets * sizeof(int32_t));
+    }
+
+    return cache;
+}
+
+/**
+ * @brief Destroy a cache
+ *
+ * @param cache The cache, or NULL
+ */
+void calc_cache_destroy(CalcCache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    for (int s = 0; s < cache->nshards; s++) {
+        pthread_mutex_destroy(&cache->shards[s].lock);
+        free(cache->shards[s].entries);
+        free(cache->shards[s].buckets);
+    }
+    free(cache);
+}
+
+static void lru_unlink(CacheShard *shard, int32_t i) {
+    CacheEntry *e = &shard->entries[i];
+
+    if (e->prev >= 0) {
+        shard->entries[e->prev].next = e->next;
+    } else {
+        shard->head = e->next;
+    }
+    if (e->next >= 0) {
+        shard->entries[e->next].prev = e->prev;
+    } else {
+        shard->tail = e->prev;
+    }
+}
+
+static void lru_push_front(CacheShard *shard, int32_t i) {
+    CacheEntry *e = &shard->entries[i];
+
+    e->prev = -1;
+    e->next = shard->head;
+    if (shard->head >= 0) {
+        shard->entries[shard->head].prev = i;
+    }
+    shard->head = i;
+    if (shard->tail < 0) {
+        shard->tail = i;
+    }
+}
+
+static int32_t find_entry(const CacheShard *shard, uint64_t h, int64_t jdq, int body, int iflags) {
+    for (int32_t i = shard->buckets[h & shard->bucket_mask]; i >= 0; i = shard->entries[i].chain) {
+        const CacheEntry *e = &shard->entries[i];
+
+        if (e->jdq == jdq && e->body == body && e->iflags == iflags) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void unchain_entry(CacheShard *shard, int32_t i) {
+    const CacheEntry *e = &shard->entries[i];
+    int32_t *link = &shard->buckets[hash_key(e->jdq, e->body, e->iflags) & shard->bucket_mask];
+
+    while (*link != i) {
+        link = &shard->entries[*link].chain;
+    }
+    *link = e->chain;
+}
+
+/**
+ * @brief Look up a position
+ *
+ * @param cache The cache
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param body The planet ID
+ * @param iflags The flags the position was computed with
+ * @param xx The cached coordinates on a hit
+ * @return int OK on a hit, ERR on a miss
+ */
+int calc_cache_get(CalcCache *cache, double tjd_ut, int body, int iflags, double *xx) {
+    int64_t jdq = (int64_t)floor(tjd_ut / cache->quantum);
+    uint64_t h = hash_key(jdq, body, iflags);
+    CacheShard *shard = &cache->shards[h >> 60];
+    int32_t i;
+
+    pthread_mutex_lock(&shard->lock);
+    i = find_entry(shard, h, jdq, body, iflags);
+    if (i >= 0) {
+        memcpy(xx, shard->entries[i].xx, sizeof(shard->entries[i].xx));
+        lru_unlink(shard, i);
+        lru_push_front(shard, i);
+        shard->hits++;
+    } else {
+        shard->misses++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    return i >= 0 ? OK : ERR;
+}
+
+/**
+ * @brief Store a position, evicting the least recently used one of its shard if the shard is full
+ *
+ * @param cache The cache
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param body The planet ID
+ * @param iflags The flags the position was computed with
+ * @param xx The coordinates
+ */
+void calc_cache_put(CalcCache *cache, double tjd_ut, int body, int iflags, const double *xx) {
+    int64_t jdq = (int64_t)floor(tjd_ut / cache->quantum);
+    uint64_t h = hash_key(jdq, body, iflags);
+    CacheShard *shard = &cache->shards[h >> 60];
+    int32_t i;
+
+    pthread_mutex_lock(&shard->lock);
+
+    // Another thread may have computed the same position meanwhile
+    i = find_entry(shard, h, jdq, body, iflags);
+    if (i >= 0) {
+        lru_unlink(shard, i);
+    } else {
+        if (shard->used < shard->capacity) {
+            i = shard->used++;
+        } else {
+            i = shard->tail;
+            lru_unlink(shard, i);
+            unchain_entry(shard, i);
+            shard->evictions++;
+        }
+        shard->entries[i].jdq = jdq;
+        shard->entries[i].body = body;
+        shard->entries[i].iflags = iflags;
+        shard->entries[i].chain = shard->buckets[h & shard->bucket_mask];
+        shard->buckets[h & shard->bucket_mask] = i;
+    }
+    memcpy(shard->entries[i].xx, xx, sizeof(shard->entries[i].xx));
+    lru_push_front(shard, i);
+
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/**
+ * @brief Get the counters of a cache, summed over its shards
+ *
+ * @param cache The cache
+ * @param stats The counters
+ */
+void calc_cache_stats(CalcCache *cache, CalcCacheStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int s = 0; s < CALC_CACHE_SHARDS; s++) {
+        CacheShard *shard = &cache->shards[s];
+
+        pthread_mutex_lock(&shard->lock);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->evictions += shard->evictions;
+        stats->entries += (size_t)shard->used;
+        stats->capacity += (size_t)shard->capacity;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+/**
+ * @brief Print the counters of a cache on one line
+ *
+ * @param cache The cache
+ * @param f The output stream
+ */
+void calc_cache_print_stats(CalcCache *cache, FILE *f) {
+    CalcCacheStats st;
+    unsigned long lookups;
+
+    calc_cache_stats(cache, &st);
+    lookups = st.hits + st.misses;
+    fprintf(f, "Cache: %lu hits, %lu misses, %lu evictions, %zu/%zu entries, %.1f%% hit rate\n", st.hits, st.misses,
+            st.evictions, st.entries, st.capacity, lookups ? 100.0 * st.hits / lookups : 0.0);
+}
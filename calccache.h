@@ -0,0 +1,29 @@
+#ifndef CALCCACHE_H
+#define CALCCACHE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define CALC_CACHE_DEFAULT_ENTRIES 65536
+
+// Default width of a Julian Day bucket: 1e-6 day (86 ms), where the Moon moves less than 0.05 arcseconds
+#define CALC_CACHE_DEFAULT_QUANTUM 1e-6
+
+typedef struct CalcCache CalcCache;
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    size_t entries;
+    size_t capacity;
+} CalcCacheStats;
+
+CalcCache *calc_cache_create(size_t capacity, double quantum);
+void calc_cache_destroy(CalcCache *cache);
+int calc_cache_get(CalcCache *cache, double tjd_ut, int body, int iflags, double *xx);
+void calc_cache_put(CalcCache *cache, double tjd_ut, int body, int iflags, const double *xx);
+void calc_cache_stats(CalcCache *cache, CalcCacheStats *stats);
+void calc_cache_print_stats(CalcCache *cache, FILE *f);
+
+#endif
@@ -0,0 +1,557 @@
+#include "cheb.h"
+#include "planet.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Chebyshev ephemeris cache
+ *
+ * The generator samples swe_calc_ut over [jd_start, jd_end] and fits, for every body, consecutive segments of
+ * equal length with Chebyshev polynomials of degree CHEB_DEGREE in longitude, latitude and distance. After fitting a
+ * segment it compares the polynomials with swe_calc_ut at 2 * (CHEB_DEGREE + 1) points placed between the fit nodes;
+ * if any position differs by more than the tolerance the segment length of that body is halved and the body is
+ * fitted again. The largest position and speed differences found are stored per body and are the documented error
+ * bound of the file against swe_calc_ut (see cheb_print_info()). Speeds are the exact derivatives of the fitted
+ * polynomials.
+ *
+ * File layout (native byte order): a ChebHeader, nbodies ChebBodyInfo records, then for every body its segments,
+ * each made of 3 * (degree + 1) doubles (longitude, latitude and distance coefficients).
+ */
+
+#define CHEB_MAGIC "CKRCHEB1"
+#define CHEB_VERSION 1
+
+// Segment length a body starts from, and how often it may be halved
+#define CHEB_INITIAL_SEG_DAYS 32.0
+#define CHEB_MAX_HALVINGS 10
+
+typedef struct {
+    char magic[8];
+    int32 version;
+    int32 iflags;
+    double jd_start;
+    double jd_end;
+    int32 nbodies;
+    int32 reserved;
+} ChebHeader;
+
+typedef struct {
+    int32 body;
+    int32 degree;
+    int32 nsegs;
+    int32 reserved;
+    double seg_days;
+    double max_pos_err; // arcseconds
+    double max_speed_err; // arcseconds per day
+    int64 offset;         // file offset of the first segment
+} ChebBodyInfo;
+
+struct ChebFile {
+    ChebHeader header;
+    ChebBodyInfo *infos;
+    double *coeffs;                // all segments, in file order
+    const double *body_coeffs[SE_NPLANETS];
+    int body_index[SE_NPLANETS];   // index into infos, -1 if the body is not covered
+};
+
+/**
+ * @brief Evaluate a Chebyshev series and its derivative with respect to x
+ *
+ * @param c The coefficients
+ * @param n The number of coefficients
+ * @param x The argument, in [-1, 1]
+ * @param deriv The derivative df/dx
+ * @return double The value
+ */
+static double cheb_eval(const double *c, int n, double x, double *deriv) {
+    // T_k and U_{k-1} are advanced together, T'_k = k * U_{k-1}
+    double t0 = 1.0, t1 = x;
+    double u0 = 1.0, u1 = 2.0 * x;
+    double f = c[0] + c[1] * x;
+    double df = c[1];
+
+    for (int k = 2; k < n; k++) {
+        double t2 = 2.0 * x * t1 - t0;
+
+        df += c[k] * k * u1;
+        f += c[k] * t2;
+        t0 = t1;
+        t1 = t2;
+
+        double u2 = 2.0 * x * u1 - u0;
+        u0 = u1;
+        u1 = u2;
+    }
+
+    *deriv = df;
+
+    return f;
+}
+
+/**
+ * @brief Fit the Chebyshev coefficients of one segment from samples at the Chebyshev nodes
+ *
+ * @param f The samples, f[k] taken at x_k = cos(pi * (k + 0.5) / n)
+ * @param n The number of samples and coefficients
+ * @param c The coefficients
+ */
+static void cheb_fit(const double *f, int n, double *c) {
+    for (int j = 0; j < n; j++) {
+        double sum = 0.0;
+
+        for (int k = 0; k < n; k++) {
+            sum += f[k] * cos(M_PI * j * (k + 0.5) / n);
+        }
+        c[j] = 2.0 * sum / n;
+    }
+    c[0] *= 0.5;
+}
+
+/**
+ * @brief Difference of two angles in degrees, normalized to [-180, 180)
+ */
+static double angle_diff(double a, double b) {
+    double d = fmod(a - b, 360.0);
+
+    if (d < -180.0) {
+        d += 360.0;
+    } else if (d >= 180.0) {
+        d -= 360.0;
+    }
+
+    return d;
+}
+
+/**
+ * @brief Fit all segments of one body with the given segment length
+ *
+ * @param info The body info; body, degree, nsegs and seg_days must be set, the error bounds are filled in
+ * @param jd_start The start of the covered range
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param tol_arcsec The position tolerance
+ * @param coeffs The coefficients, nsegs * 3 * (degree + 1) doubles
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK if every segment is within the tolerance, 1 if the segments are too long, ERR on failure
+ */
+static int fit_body(ChebBodyInfo *info, double jd_start, int iflags, double tol_arcsec, double *coeffs,
+                    char *serr) {
+    int n = info->degree + 1;
+    double samples[3][CHEB_DEGREE + 1];
+    double xx[6];
+
+    info->max_pos_err = 0.0;
+    info->max_speed_err = 0.0;
+
+    for (int s = 0; s < info->nsegs; s++) {
+        double t0 = jd_start + s * info->seg_days;
+        double *c = &coeffs[(size_t)s * 3 * n];
+
+        // Sample at the nodes; longitudes are unwrapped relative to the first node
+        for (int k = 0; k < n; k++) {
+            double x = cos(M_PI * (k + 0.5) / n);
+
+            if (swe_calc_ut(t0 + (x + 1.0) * 0.5 * info->seg_days, info->body, iflags, xx, serr) == ERR) {
+                return ERR;
+            }
+            samples[0][k] = k == 0 ? xx[0] : samples[0][0] + angle_diff(xx[0], samples[0][0]);
+            samples[1][k] = xx[1];
+            samples[2][k] = xx[2];
+        }
+        for (int q = 0; q < 3; q++) {
+            cheb_fit(samples[q], n, &c[q * n]);
+        }
+
+        // Check between the nodes
+        for (int k = 0; k < 2 * n; k++) {
+            double x = -1.0 + (k + 0.5) / n;
+            double scale = 2.0 / info->seg_days;
+            double dlon, dlat, ddist;
+            double lon = cheb_eval(&c[0], n, x, &dlon);
+            double lat = cheb_eval(&c[n], n, x, &dlat);
+            double dist = cheb_eval(&c[2 * n], n, x, &ddist);
+            double err, serr_speed;
+
+            if (swe_calc_ut(t0 + (x + 1.0) * 0.5 * info->seg_days, info->body, iflags | SEFLG_SPEED, xx, serr) == ERR) {
+                return ERR;
+            }
+
+            // Distance errors are expressed as the angle they subtend, relative to the distance
+            err = fmax(fabs(angle_diff(lon, xx[0])), fabs(lat - xx[1])) * 3600.0;
+            if (xx[2] != 0.0) {
+                err = fmax(err, fabs(dist - xx[2]) / fabs(xx[2]) * (180.0 / M_PI) * 3600.0);
+            }
+            serr_speed = fmax(fabs(dlon * scale - xx[3]), fabs(dlat * scale - xx[4])) * 3600.0;
+
+            if (err > tol_arcsec) {
+                return 1;
+            }
+            info->max_pos_err = fmax(info->max_pos_err, err);
+            info->max_speed_err = fmax(info->max_speed_err, serr_speed);
+        }
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Generate a Chebyshev cache file
+ *
+ * Bodies for which swe_calc_ut fails are left out of the file; lookups for them fall back to the library.
+ *
+ * @param path The output file
+ * @param jd_start The start of the range (UT)
+ * @param jd_end The end of the range (UT)
+ * @param bodies The planet IDs to cover
+ * @param nbodies The number of planet IDs
+ * @param iflags The flags for the Swiss Ephemeris; lookups must use the same flags
+ * @param tol_arcsec The position tolerance in arcseconds
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR on failure
+ */
+int cheb_build(const char *path, double jd_start, double jd_end, const int *bodies, int nbodies, int iflags,
+               double tol_arcsec, char *serr) {
+    ChebHeader header;
+    ChebBodyInfo *infos;
+    double **coeffs;
+    FILE *fp;
+    int64 offset;
+    int ret = OK;
+
+    if (jd_end <= jd_start || nbodies <= 0) {
+        strcpy(serr, "empty range or body list");
+        return ERR;
+    }
+    if (iflags & (SEFLG_XYZ | SEFLG_RADIANS)) {
+        strcpy(serr, "only polar coordinates in degrees can be cached");
+        return ERR;
+    }
+    // Topocentric positions depend on the observer set at lookup time, which the cache cannot follow
+    if (iflags & SEFLG_TOPOCTR) {
+        strcpy(serr, "topocentric positions cannot be cached");
+        return ERR;
+    }
+    // Likewise sidereal positions depend on the sidereal mode set at lookup time
+    if (iflags & SEFLG_SIDEREAL) {
+        strcpy(serr, "sidereal positions cannot be cached");
+        return ERR;
+    }
+
+    infos = (ChebBodyInfo *)calloc(nbodies, sizeof(ChebBodyInfo));
+    coeffs = (double **)calloc(nbodies, sizeof(double *));
+    if (infos == NULL || coeffs == NULL) {
+        free(infos);
+        free(coeffs);
+        strcpy(serr, "out of memory");
+        return ERR;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHEB_MAGIC, sizeof(header.magic));
+    header.version = CHEB_VERSION;
+    header.iflags = iflags & ~SEFLG_SPEED;
+    header.jd_start = jd_start;
+    header.jd_end = jd_end;
+
+    for (int b = 0; b < nbodies; b++) {
+        ChebBodyInfo *info = &infos[header.nbodies];
+        double seg_days = CHEB_INITIAL_SEG_DAYS;
+        int fit = 1;
+
+        if (bodies[b] < 0 || bodies[b] >= SE_NPLANETS) {
+            continue;
+        }
+
+        for (int h = 0; fit == 1 && h <= CHEB_MAX_HALVINGS; h++, seg_days *= 0.5) {
+            info->body = bodies[b];
+            info->degree = CHEB_DEGREE;
+            info->seg_days = seg_days;
+            info->nsegs = (int32)ceil((jd_end - jd_start) / seg_days);
+
+            free(coeffs[header.nbodies]);
+            coeffs[header.nbodies] = (double *)malloc((size_t)info->nsegs * 3 * (CHEB_DEGREE + 1) * sizeof(double));
+            if (coeffs[header.nbodies] == NULL) {
+                strcpy(serr, "out of memory");
+                ret = ERR;
+                goto done;
+            }
+
+            // The last attempt is kept even if it misses the tolerance; its error bound says so
+            fit = fit_body(info, jd_start, header.iflags, h == CHEB_MAX_HALVINGS ? INFINITY : tol_arcsec,
+                           coeffs[header.nbodies], serr);
+        }
+
+        if (fit == ERR) {
+            fprintf(stderr, "Warning: body %d not cached: %s\n", bodies[b], serr);
+            free(coeffs[header.nbodies]);
+            coeffs[header.nbodies] = NULL;
+            continue;
+        }
+        header.nbodies++;
+    }
+
+    fp = fopen(path, "wb");
+    if (fp == NULL) {
+        sprintf(serr, "cannot open %.200s for writing", path);
+        ret = ERR;
+        goto done;
+    }
+
+    offset = sizeof(ChebHeader) + (int64)header.nbodies * sizeof(ChebBodyInfo);
+    for (int b = 0; b < header.nbodies; b++) {
+        infos[b].offset = offset;
+        offset += (int64)infos[b].nsegs * 3 * (infos[b].degree + 1) * sizeof(double);
+    }
+
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(infos, sizeof(ChebBodyInfo), header.nbodies, fp);
+    for (int b = 0; b < header.nbodies; b++) {
+        fwrite(coeffs[b], sizeof(double), (size_t)infos[b].nsegs * 3 * (infos[b].degree + 1), fp);
+    }
+    if (fclose(fp) != 0) {
+        sprintf(serr, "cannot write %.200s", path);
+        ret = ERR;
+    }
+
+done:
+    for (int b = 0; b < nbodies; b++) {
+        free(coeffs[b]);
+    }
+    free(coeffs);
+    free(infos);
+
+    return ret;
+}
+
+/**
+ * @brief Load a Chebyshev cache file into memory
+ *
+ * @param path The file
+ * @param serr Error buffer (at least 256 bytes)
+ * @return ChebFile* The cache, or NULL on error
+ */
+ChebFile *cheb_open(const char *path, char *serr) {
+    ChebFile *cf = (ChebFile *)calloc(1, sizeof(ChebFile));
+    FILE *fp = fopen(path, "rb");
+    long size;
+    size_t ncoeffs;
+    int64 data_start;
+
+    if (cf == NULL || fp == NULL) {
+        sprintf(serr, "cannot open %.200s", path);
+        goto fail;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (fread(&cf->header, sizeof(ChebHeader), 1, fp) != 1 ||
+        memcmp(cf->header.magic, CHEB_MAGIC, sizeof(cf->header.magic)) != 0 || cf->header.version != CHEB_VERSION ||
+        cf->header.nbodies < 0 || cf->header.nbodies > SE_NPLANETS || (cf->header.iflags & (SEFLG_TOPOCTR | SEFLG_SIDEREAL))) {
+        sprintf(serr, "%.200s is not a Chebyshev cache file", path);
+        goto fail;
+    }
+
+    cf->infos = (ChebBodyInfo *)calloc(cf->header.nbodies + 1, sizeof(ChebBodyInfo));
+    if (cf->infos == NULL ||
+        fread(cf->infos, sizeof(ChebBodyInfo), cf->header.nbodies, fp) != (size_t)cf->header.nbodies) {
+        sprintf(serr, "%.200s is truncated", path);
+        goto fail;
+    }
+
+    ncoeffs = (size - ftell(fp)) / sizeof(double);
+    cf->coeffs = (double *)malloc(ncoeffs * sizeof(double) + 1);
+    if (cf->coeffs == NULL || fread(cf->coeffs, sizeof(double), ncoeffs, fp) != ncoeffs) {
+        sprintf(serr, "cannot read %.200s", path);
+        goto fail;
+    }
+    fclose(fp);
+    fp = NULL;
+
+    for (int i = 0; i < SE_NPLANETS; i++) {
+        cf->body_index[i] = -1;
+    }
+    data_start = (int64)sizeof(ChebHeader) + (int64)cf->header.nbodies * (int64)sizeof(ChebBodyInfo);
+    for (int b = 0; b < cf->header.nbodies; b++) {
+        const ChebBodyInfo *info = &cf->infos[b];
+        int64 first = (info->offset - data_start) / (int64)sizeof(double);
+
+        if (info->body < 0 || info->body >= SE_NPLANETS || info->degree < 1 || info->degree > CHEB_DEGREE ||
+            info->nsegs <= 0 || info->seg_days <= 0 || first < 0 ||
+            first + (int64)info->nsegs * 3 * (info->degree + 1) > (int64)ncoeffs) {
+            sprintf(serr, "%.200s has an invalid body table", path);
+            goto fail;
+        }
+        cf->body_index[info->body] = b;
+        cf->body_coeffs[info->body] = &cf->coeffs[first];
+    }
+
+    return cf;
+
+fail:
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    cheb_close(cf);
+    return NULL;
+}
+
+/**
+ * @brief Release a Chebyshev cache
+ *
+ * @param cf The cache
+ */
+void cheb_close(ChebFile *cf) {
+    if (cf == NULL) {
+        return;
+    }
+    free(cf->coeffs);
+    free(cf->infos);
+    free(cf);
+}
+
+/**
+ * @brief Print the range, flags and per-body error bounds of a cache
+ *
+ * @param cf The cache
+ */
+void cheb_print_info(const ChebFile *cf) {
+    char name[AS_MAXCH];
+
+    printf("Range: %.6f to %.6f\n", cf->header.jd_start, cf->header.jd_end);
+    printf("Flags: %d\n", cf->header.iflags);
+    printf("Bodies: %d\n\n", cf->header.nbodies);
+    for (int b = 0; b < cf->header.nbodies; b++) {
+        const ChebBodyInfo *info = &cf->infos[b];
+
+        swe_get_planet_name(info->body, name);
+        printf("%-14s segment %9.5f days, %6d segments, max error %.4f\" (speed %.4f\"/day)\n", name,
+               info->seg_days, info->nsegs, info->max_pos_err, info->max_speed_err);
+    }
+}
+
+/**
+ * @brief Look up a position in the cache
+ *
+ * @param cf The cache
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param body The planet ID
+ * @param iflags The flags for the Swiss Ephemeris; apart from SEFLG_SPEED they must match the cache
+ * @param xx The longitude, latitude, distance and their speeds
+ * @return int OK on success, ERR if the request is not covered by the cache
+ */
+int cheb_calc(const ChebFile *cf, double tjd_ut, int body, int iflags, double *xx) {
+    const ChebBodyInfo *info;
+    const double *c;
+    double x, scale;
+    int n, seg;
+
+    if (cf == NULL || body < 0 || body >= SE_NPLANETS || cf->body_index[body] < 0 ||
+        (iflags & ~SEFLG_SPEED) != cf->header.iflags) {
+        return ERR;
+    }
+    if (!(tjd_ut >= cf->header.jd_start && tjd_ut <= cf->header.jd_end)) {
+        return ERR;
+    }
+
+    info = &cf->infos[cf->body_index[body]];
+    n = info->degree + 1;
+    seg = (int)((tjd_ut - cf->header.jd_start) / info->seg_days);
+    if (seg >= info->nsegs) {
+        seg = info->nsegs - 1;
+    }
+
+    c = cf->body_coeffs[body] + (size_t)seg * 3 * n;
+    x = 2.0 * (tjd_ut - cf->header.jd_start - seg * info->seg_days) / info->seg_days - 1.0;
+    scale = 2.0 / info->seg_days;
+
+    xx[0] = swe_degnorm(cheb_eval(&c[0], n, x, &xx[3]));
+    xx[1] = cheb_eval(&c[n], n, x, &xx[4]);
+    xx[2] = cheb_eval(&c[2 * n], n, x, &xx[5]);
+
+    if (iflags & SEFLG_SPEED) {
+        xx[3] *= scale;
+        xx[4] *= scale;
+        xx[5] *= scale;
+    } else {
+        xx[3] = xx[4] = xx[5] = 0.0;
+    }
+
+    return OK;
+}
+
+/**
+ * @brief swe_calc_ut replacement answering from the cache when possible
+ *
+ * @param cf The cache, or NULL
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param body The planet ID
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param xx The coordinates
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int32 The flags actually used, or ERR
+ */
+int32 cheb_calc_ut(const ChebFile *cf, double tjd_ut, int body, int iflags, double *xx, char *serr) {
+    if (cheb_calc(cf, tjd_ut, body, iflags, xx) == OK) {
+        return iflags;
+    }
+
+    return swe_calc_ut(tjd_ut, body, iflags, xx, serr);
+}
+
+/**
+ * @brief Entry point of the cache tool
+ *
+ * main cheb build <file> <jd_start> <jd_end> [-f iflags] [-t tol_arcsec]
+ * main cheb info <file>
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int cheb_main(int argc, char **argv) {
+    char serr[256];
+
+    if (argc >= 5 && strcmp(argv[1], "build") == 0) {
+        int bodies[NUM_CHART_BODIES];
+        int iflags = SEFLG_SWIEPH | SEFLG_HELCTR;
+        double tol = CHEB_DEFAULT_TOL;
+
+        for (int i = 5; i + 1 < argc; i += 2) {
+            if (strcmp(argv[i], "-f") == 0) {
+                iflags = atoi(argv[i + 1]);
+            } else if (strcmp(argv[i], "-t") == 0) {
+                tol = atof(argv[i + 1]);
+            }
+        }
+        for (int i = 0; i < NUM_CHART_BODIES; i++) {
+            bodies[i] = i;
+        }
+
+        if (cheb_build(argv[2], atof(argv[3]), atof(argv[4]), bodies, NUM_CHART_BODIES, iflags, tol, serr) == ERR) {
+            fprintf(stderr, "Error: %s\n", serr);
+            return 1;
+        }
+        swe_close();
+        return 0;
+    }
+
+    if (argc == 3 && strcmp(argv[1], "info") == 0) {
+        ChebFile *cf = cheb_open(argv[2], serr);
+
+        if (cf == NULL) {
+            fprintf(stderr, "Error: %s\n", serr);
+            return 1;
+        }
+        cheb_print_info(cf);
+        cheb_close(cf);
+        return 0;
+    }
+
+    fprintf(stderr, "Usage: main cheb build <file> <jd_start> <jd_end> [-f iflags] [-t tol_arcsec]\n"
+                    "       main cheb info <file>\n");
+
+    return 1;
+}
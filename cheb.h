@@ -0,0 +1,25 @@
+#ifndef CHEB_H
+#define CHEB_H
+
+#include "swephexp.h"
+
+// Default fit tolerance of cheb_build(), in arcseconds
+#define CHEB_DEFAULT_TOL 0.1
+
+// Degree of the Chebyshev polynomials fitted to every segment
+#define CHEB_DEGREE 12
+
+typedef struct ChebFile ChebFile;
+
+int cheb_build(const char *path, double jd_start, double jd_end, const int *bodies, int nbodies, int iflags,
+               double tol_arcsec, char *serr);
+ChebFile *cheb_open(const char *path, char *serr);
+void cheb_close(ChebFile *cf);
+void cheb_print_info(const ChebFile *cf);
+
+int cheb_calc(const ChebFile *cf, double tjd_ut, int body, int iflags, double *xx);
+int32 cheb_calc_ut(const ChebFile *cf, double tjd_ut, int body, int iflags, double *xx, char *serr);
+
+int cheb_main(int argc, char **argv);
+
+#endif
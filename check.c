@@ -0,0 +1,151 @@
+#include "ingest.h"
+#include "output.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Exactness checks, run with make check
+ *
+ * The fast paths of the output and input code promise the same results as the C library: writer_fixed() the same
+ * text as printf("%.*f"), parse_birth_fields() the same doubles as strtod(). ingest_split() must cut a range into
+ * pieces that end at line boundaries and together cover the whole range. Each check compares against the reference
+ * on random or exhaustive inputs and prints the first few mismatches.
+ */
+
+#define CHECK_CASES 1000000
+#define CHECK_MAX_REPORTS 5
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+
+    return rng_state;
+}
+
+static double rng_double(void) {
+    static const double scales[] = {1e-8, 1e-3, 1.0, 180.0, 1e6, 1e12, 1e17};
+    double x = (double)(rng_next() >> 11) / (double)(1ULL << 53);
+
+    x *= scales[rng_next() % (sizeof(scales) / sizeof(scales[0]))];
+
+    return rng_next() & 1 ? -x : x;
+}
+
+static long report(long failures, const char *what, const char *input, const char *got, const char *want) {
+    if (failures < CHECK_MAX_REPORTS) {
+        fprintf(stderr, "FAIL %s: %s: got %s, want %s\n", what, input, got, want);
+    }
+
+    return failures + 1;
+}
+
+/**
+ * @brief writer_fixed() against snprintf("%.*f"), on random values and ties
+ */
+static long check_format_fixed(void) {
+    Writer w;
+    long failures = 0;
+
+    if (writer_open(&w, -1, 0) == ERR) {
+        return 1;
+    }
+    for (long i = 0; i < CHECK_CASES; i++) {
+        int decimals = (int)(rng_next() % 18);
+        // Every fourth value is a binary fraction, an exact tie at some number of decimals
+        double x = i % 4 == 0 ? ldexp((double)(int64_t)(rng_next() % 2000001) - 1000000, -(int)(rng_next() % 12))
+                              : rng_double();
+        char want[512], input[64];
+
+        w.len = 0;
+        writer_fixed(&w, x, decimals);
+        snprintf(want, sizeof(want), "%.*f", decimals, x);
+        if (w.len != strlen(want) || memcmp(w.buf, want, w.len) != 0) {
+            w.buf[w.len] = '\0';
+            snprintf(input, sizeof(input), "%.17g (%d decimals)", x, decimals);
+            failures = report(failures, "writer_fixed", input, w.buf, want);
+        }
+    }
+    w.len = 0;
+    writer_close(&w);
+
+    return failures;
+}
+
+/**
+ * @brief Latitudes and longitudes of parse_birth_fields() against strtod(), in fixed and exponent notation
+ */
+static long check_parse_number(void) {
+    long failures = 0;
+
+    for (long i = 0; i < CHECK_CASES; i++) {
+        char lat[64], lon[64], line[192], serr[256];
+        BirthRecord rec;
+        double want_lat, want_lon;
+
+        snprintf(lat, sizeof(lat), "%.*f", (int)(rng_next() % 20), rng_double());
+        snprintf(lon, sizeof(lon), i % 8 == 0 ? "%.*e" : "%.*f", (int)(rng_next() % 20), rng_double());
+        snprintf(line, sizeof(line), "2000-01-01 12:00 +05:30 %s %s\n", lat, lon);
+        want_lat = strtod(lat, NULL);
+        want_lon = strtod(lon, NULL);
+
+        if (parse_birth_fields(line, line + strlen(line), 0, &rec, serr) == ERR) {
+            failures = report(failures, "parse_birth_fields", line, serr, "OK");
+        } else if (rec.lat != want_lat || rec.lon != want_lon || rec.tz != 5.5) {
+            char got[128], want[128];
+
+            snprintf(got, sizeof(got), "%.17g %.17g", rec.lat, rec.lon);
+            snprintf(want, sizeof(want), "%.17g %.17g", want_lat, want_lon);
+            failures = report(failures, "parse_birth_fields", line, got, want);
+        }
+    }
+
+    return failures;
+}
+
+/**
+ * @brief ingest_split() on every small size and number of pieces: the pieces tile [0, size) at line boundaries
+ */
+static long check_ingest_split(void) {
+    size_t bounds[INGEST_MAX_CHUNKS + 1];
+    char data[600];
+    long failures = 0;
+
+    for (size_t size = 0; size <= sizeof(data); size++) {
+        for (size_t i = 0; i < size; i++) {
+            data[i] = rng_next() % 5 == 0 ? '\n' : 'x';
+        }
+        for (size_t nchunks = 1; nchunks <= INGEST_MAX_CHUNKS; nchunks++) {
+            size_t n = ingest_split(data, size, nchunks, bounds);
+            int ok = n <= nchunks && bounds[0] == 0 && bounds[n] == size && (size == 0) == (n == 0);
+            char input[64];
+
+            for (size_t k = 1; ok && k <= n; k++) {
+                ok = bounds[k] > bounds[k - 1] && (bounds[k] == size || data[bounds[k] - 1] == '\n');
+            }
+            if (!ok) {
+                snprintf(input, sizeof(input), "size %zu, %zu pieces", size, nchunks);
+                failures = report(failures, "ingest_split", input, "bad pieces", "[0, size) at newlines");
+            }
+        }
+    }
+
+    return failures;
+}
+
+int main(void) {
+    long failures = 0;
+
+    failures += check_format_fixed();
+    failures += check_parse_number();
+    failures += check_ingest_split();
+
+    printf("%s: %ld failures\n", failures == 0 ? "PASS" : "FAIL", failures);
+
+    return failures == 0 ? 0 : 1;
+}
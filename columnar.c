@@ -0,0 +1,444 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "columnar.h"
+#include <fcntl.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Columnar chart writer
+ *
+ * Rows are appended to one in-memory buffer per column, already encoded little-endian, while the per-column
+ * min/max of the current row group is tracked. A full group is written out as its header, chunk table and column
+ * chunks. The file header is written as a placeholder first and completed by columnar_close(), which also appends
+ * the row group index.
+ */
+
+enum {
+    COLUMN_CHART,
+    COLUMN_JD,
+    COLUMN_BODY,
+    COLUMN_LON,
+    COLUMN_LAT,
+    COLUMN_DIST,
+    COLUMN_LON_SPEED,
+    COLUMN_LAT_SPEED,
+    COLUMN_DIST_SPEED,
+    COLUMN_SIGN,
+    COLUMN_HOUSE,
+    NUM_COLUMNS
+};
+
+static const struct {
+    const char *name;
+    ColumnType type;
+    int width;
+} columns[NUM_COLUMNS] = {
+    {"chart", COL_I64, 8},     {"jd", COL_F64, 8},        {"body", COL_I32, 4},       {"lon", COL_F64, 8},
+    {"lat", COL_F64, 8},       {"dist", COL_F64, 8},      {"lon_speed", COL_F64, 8},  {"lat_speed", COL_F64, 8},
+    {"dist_speed", COL_F64, 8}, {"sign", COL_U8, 1},      {"house", COL_U8, 1},
+};
+
+#define FILE_HEADER_SIZE 64
+#define COL_DESC_SIZE 32
+#define GROUP_HEADER_SIZE 16
+#define CHUNK_SIZE 24
+
+struct ColumnarWriter {
+    FILE *fp;
+    size_t group_rows;
+    size_t nrows;          // rows in the current group
+    uint64_t total_rows;
+    uint64_t offset;       // current end of the file
+    uint64_t *group_offsets;
+    size_t ngroups;
+    size_t groups_cap;
+    unsigned char *data[NUM_COLUMNS];
+    double min[NUM_COLUMNS];
+    double max[NUM_COLUMNS];
+    int error;
+};
+
+static uint64_t align_up(uint64_t offset) { return (offset + COLUMNAR_ALIGN - 1) / COLUMNAR_ALIGN * COLUMNAR_ALIGN; }
+
+static void put_le(unsigned char *p, uint64_t v, int width) {
+    for (int i = 0; i < width; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const unsigned char *p, int width) {
+    uint64_t v = 0;
+
+    for (int i = 0; i < width; i++) {
+        v |= (uint64_t)p[i] << (8 * i);
+    }
+
+    return v;
+}
+
+static uint64_t double_bits(double x) {
+    uint64_t bits;
+
+    memcpy(&bits, &x, sizeof(bits));
+
+    return bits;
+}
+
+static double bits_double(uint64_t bits) {
+    double x;
+
+    memcpy(&x, &bits, sizeof(x));
+
+    return x;
+}
+
+static void write_bytes(ColumnarWriter *cw, const void *p, size_t n) {
+    if (!cw->error && fwrite(p, 1, n, cw->fp) != n) {
+        cw->error = 1;
+    }
+    cw->offset += n;
+}
+
+static void write_padding(ColumnarWriter *cw, uint64_t to) {
+    static const unsigned char zeros[COLUMNAR_ALIGN];
+
+    while (cw->offset < to) {
+        write_bytes(cw, zeros, (size_t)(to - cw->offset < COLUMNAR_ALIGN ? to - cw->offset : COLUMNAR_ALIGN));
+    }
+}
+
+static void encode_file_header(const ColumnarWriter *cw, uint64_t index_offset, unsigned char *buf) {
+    memset(buf, 0, FILE_HEADER_SIZE + NUM_COLUMNS * COL_DESC_SIZE);
+    memcpy(buf, COLUMNAR_MAGIC, 8);
+    put_le(buf + 8, COLUMNAR_VERSION, 8);
+    put_le(buf + 16, NUM_COLUMNS, 8);
+    put_le(buf + 24, cw->total_rows, 8);
+    put_le(buf + 32, cw->ngroups, 8);
+    put_le(buf + 40, cw->group_rows, 8);
+    put_le(buf + 48, index_offset, 8);
+
+    for (int c = 0; c < NUM_COLUMNS; c++) {
+        unsigned char *d = buf + FILE_HEADER_SIZE + c * COL_DESC_SIZE;
+
+        strncpy((char *)d, columns[c].name, 15);
+        put_le(d + 16, (uint64_t)columns[c].type, 8);
+        put_le(d + 24, (uint64_t)columns[c].width, 8);
+    }
+}
+
+static void reset_group(ColumnarWriter *cw) {
+    cw->nrows = 0;
+    for (int c = 0; c < NUM_COLUMNS; c++) {
+        cw->min[c] = DBL_MAX;
+        cw->max[c] = -DBL_MAX;
+    }
+}
+
+/**
+ * @brief Create a columnar chart file
+ *
+ * @param path The file path
+ * @param group_rows The rows per row group (0 for COLUMNAR_GROUP_ROWS)
+ * @param serr The error message on failure
+ * @return ColumnarWriter* The writer, or NULL on failure
+ */
+ColumnarWriter *columnar_create(const char *path, size_t group_rows, char *serr) {
+    unsigned char header[FILE_HEADER_SIZE + NUM_COLUMNS * COL_DESC_SIZE];
+    ColumnarWriter *cw = (ColumnarWriter *)calloc(1, sizeof(ColumnarWriter));
+
+    if (cw == NULL) {
+        strcpy(serr, "out of memory");
+        return NULL;
+    }
+    cw->group_rows = group_rows > 0 ? group_rows : COLUMNAR_GROUP_ROWS;
+    for (int c = 0; c < NUM_COLUMNS; c++) {
+        cw->data[c] = (unsigned char *)malloc(cw->group_rows * columns[c].width);
+        if (cw->data[c] == NULL) {
+            strcpy(serr, "out of memory");
+            columnar_close(cw, NULL);
+            return NULL;
+        }
+    }
+
+    cw->fp = fopen(path, "wb");
+    if (cw->fp == NULL) {
+        sprintf(serr, "cannot create %.200s", path);
+        columnar_close(cw, NULL);
+        return NULL;
+    }
+
+    // Placeholder, completed by columnar_close()
+    encode_file_header(cw, 0, header);
+    write_bytes(cw, header, sizeof(header));
+    reset_group(cw);
+
+    return cw;
+}
+
+/**
+ * @brief Write the current row group
+ */
+static void flush_group(ColumnarWriter *cw) {
+    unsigned char header[GROUP_HEADER_SIZE + NUM_COLUMNS * CHUNK_SIZE];
+    uint64_t chunk_offsets[NUM_COLUMNS];
+    uint64_t offset;
+
+    if (cw->nrows == 0) {
+        return;
+    }
+
+    if (cw->ngroups == cw->groups_cap) {
+        size_t cap = cw->groups_cap ? cw->groups_cap * 2 : 64;
+        uint64_t *offsets = (uint64_t *)realloc(cw->group_offsets, cap * sizeof(uint64_t));
+
+        if (offsets == NULL) {
+            cw->error = 1;
+            return;
+        }
+        cw->group_offsets = offsets;
+        cw->groups_cap = cap;
+    }
+    cw->group_offsets[cw->ngroups++] = cw->offset;
+
+    // Lay the chunks out after the header, each at an alignment boundary
+    offset = cw->offset + sizeof(header);
+    for (int c = 0; c < NUM_COLUMNS; c++) {
+        chunk_offsets[c] = align_up(offset);
+        offset = chunk_offsets[c] + cw->nrows * columns[c].width;
+    }
+
+    put_le(header, cw->nrows, 8);
+    put_le(header + 8, NUM_COLUMNS, 8);
+    for (int c = 0; c < NUM_COLUMNS; c++) {
+        unsigned char *chunk = header + GROUP_HEADER_SIZE + c * CHUNK_SIZE;
+
+        put_le(chunk, chunk_offsets[c], 8);
+        put_le(chunk + 8, double_bits(cw->min[c]), 8);
+        put_le(chunk + 16, double_bits(cw->max[c]), 8);
+    }
+    write_bytes(cw, header, sizeof(header));
+
+    for (int c = 0; c < NUM_COLUMNS; c++) {
+        write_padding(cw, chunk_offsets[c]);
+        write_bytes(cw, cw->data[c], cw->nrows * columns[c].width);
+    }
+
+    cw->total_rows += cw->nrows;
+    reset_group(cw);
+}
+
+static void add_value(ColumnarWriter *cw, int c, uint64_t bits, double value) {
+    put_le(cw->data[c] + cw->nrows * columns[c].width, bits, columns[c].width);
+    if (value < cw->min[c]) {
+        cw->min[c] = value;
+    }
+    if (value > cw->max[c]) {
+        cw->max[c] = value;
+    }
+}
+
+static void add_double(ColumnarWriter *cw, int c, double value) { add_value(cw, c, double_bits(value), value); }
+
+static void add_int(ColumnarWriter *cw, int c, int64_t value) { add_value(cw, c, (uint64_t)value, (double)value); }
+
+/**
+ * @brief Append one row per computed body of a chart
+ *
+ * @param cw The writer
+ * @param chart_num The chart number
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param chart The planet data of the chart; failed bodies are skipped
+ * @param n The number of entries in chart
+ * @return int OK, or ERR if a write failed
+ */
+int columnar_add_chart(ColumnarWriter *cw, long chart_num, double tjd_ut, const PlanetData *chart, int n) {
+    for (int i = 0; i < n; i++) {
+        const PlanetData *p = &chart[i];
+
+        if (p->body < 0) {
+            continue;
+        }
+        add_int(cw, COLUMN_CHART, chart_num);
+        add_double(cw, COLUMN_JD, tjd_ut);
+        add_int(cw, COLUMN_BODY, p->body);
+        add_double(cw, COLUMN_LON, p->pos);
+        add_double(cw, COLUMN_LAT, p->lat);
+        add_double(cw, COLUMN_DIST, p->dist);
+        add_double(cw, COLUMN_LON_SPEED, p->speed);
+        add_double(cw, COLUMN_LAT_SPEED, p->lat_speed);
+        add_double(cw, COLUMN_DIST_SPEED, p->dist_speed);
+        add_int(cw, COLUMN_SIGN, p->sign_num);
+        add_int(cw, COLUMN_HOUSE, p->house); // 0-based, HOUSE_UNKNOWN when not placed
+
+        if (++cw->nrows == cw->group_rows) {
+            flush_group(cw);
+        }
+    }
+
+    return cw->error ? ERR : OK;
+}
+
+/**
+ * @brief Write the last row group, the index and the final file header, and release the writer
+ *
+ * @param cw The writer, or NULL
+ * @param serr The error message on failure, or NULL
+ * @return int OK on success, ERR if a write failed
+ */
+int columnar_close(ColumnarWriter *cw, char *serr) {
+    unsigned char header[FILE_HEADER_SIZE + NUM_COLUMNS * COL_DESC_SIZE];
+    int ret = OK;
+
+    if (cw == NULL) {
+        return OK;
+    }
+
+    if (cw->fp != NULL) {
+        uint64_t index_offset;
+
+        flush_group(cw);
+        write_padding(cw, align_up(cw->offset));
+        index_offset = cw->offset;
+        for (size_t g = 0; g < cw->ngroups; g++) {
+            unsigned char le[8];
+
+            put_le(le, cw->group_offsets[g], 8);
+            write_bytes(cw, le, sizeof(le));
+        }
+
+        encode_file_header(cw, index_offset, header);
+        if (fseek(cw->fp, 0, SEEK_SET) != 0 || fwrite(header, sizeof(header), 1, cw->fp) != 1) {
+            cw->error = 1;
+        }
+        if (fclose(cw->fp) != 0) {
+            cw->error = 1;
+        }
+        if (cw->error) {
+            if (serr != NULL) {
+                strcpy(serr, "cannot write the columnar file");
+            }
+            ret = ERR;
+        }
+    }
+
+    for (int c = 0; c < NUM_COLUMNS; c++) {
+        free(cw->data[c]);
+    }
+    free(cw->group_offsets);
+    free(cw);
+
+    return ret;
+}
+
+/**
+ * @brief Print the header, columns and value ranges of a columnar file
+ *
+ * The ranges come from the row group statistics, so the column data itself is not read.
+ *
+ * @param path The file path
+ * @param serr The error message on failure
+ * @return int OK on success, ERR otherwise
+ */
+int columnar_print_info(const char *path, char *serr) {
+    static const char *const type_names[] = {"?", "f64", "i64", "i32", "u8"};
+    const unsigned char *map;
+    struct stat st;
+    uint64_t ncols, nrows, ngroups, index_offset;
+    int fd, ret = ERR;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        sprintf(serr, "cannot open %.200s", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return ERR;
+    }
+    if ((size_t)st.st_size < FILE_HEADER_SIZE) {
+        sprintf(serr, "%.200s is not a columnar file", path);
+        close(fd);
+        return ERR;
+    }
+    map = (const unsigned char *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        sprintf(serr, "cannot map %.200s", path);
+        return ERR;
+    }
+
+    ncols = get_le(map + 16, 8);
+    nrows = get_le(map + 24, 8);
+    ngroups = get_le(map + 32, 8);
+    index_offset = get_le(map + 48, 8);
+
+    if (memcmp(map, COLUMNAR_MAGIC, 8) != 0 || get_le(map + 8, 8) != COLUMNAR_VERSION || ncols > 256 ||
+        FILE_HEADER_SIZE + ncols * COL_DESC_SIZE > (uint64_t)st.st_size ||
+        index_offset + ngroups * 8 > (uint64_t)st.st_size) {
+        sprintf(serr, "%.200s is not a columnar file or is truncated", path);
+    } else {
+        printf("Columnar file: %s\n", path);
+        printf("Rows: %llu in %llu groups of up to %llu\n", (unsigned long long)nrows, (unsigned long long)ngroups,
+               (unsigned long long)get_le(map + 40, 8));
+
+        ret = OK;
+        for (uint64_t c = 0; c < ncols && ret == OK; c++) {
+            const unsigned char *d = map + FILE_HEADER_SIZE + c * COL_DESC_SIZE;
+            uint64_t type = get_le(d + 16, 8);
+            double min = DBL_MAX, max = -DBL_MAX;
+
+            for (uint64_t g = 0; g < ngroups; g++) {
+                uint64_t goff = get_le(map + index_offset + g * 8, 8);
+                const unsigned char *chunk = map + goff + GROUP_HEADER_SIZE + c * CHUNK_SIZE;
+                double cmin, cmax;
+
+                if (goff + GROUP_HEADER_SIZE + ncols * CHUNK_SIZE > (uint64_t)st.st_size) {
+                    sprintf(serr, "%.200s is truncated", path);
+                    ret = ERR;
+                    break;
+                }
+                cmin = bits_double(get_le(chunk + 8, 8));
+                cmax = bits_double(get_le(chunk + 16, 8));
+                min = cmin < min ? cmin : min;
+                max = cmax > max ? cmax : max;
+            }
+            if (ret == OK) {
+                printf("%-12.16s %-4s min %.10g max %.10g\n", (const char *)d, type < 5 ? type_names[type] : "?",
+                       min, max);
+            }
+        }
+    }
+
+    munmap((void *)map, (size_t)st.st_size);
+
+    return ret;
+}
+
+/**
+ * @brief Entry point of the columnar mode: main columnar info <file>
+ *
+ * Files are written by the batch mode (main batch -O file).
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int columnar_main(int argc, char **argv) {
+    char serr[256];
+
+    if (argc != 3 || strcmp(argv[1], "info") != 0) {
+        fprintf(stderr, "Usage: main columnar info <file>\n");
+        return 1;
+    }
+    if (columnar_print_info(argv[2], serr) == ERR) {
+        fprintf(stderr, "Error: %s\n", serr);
+        return 1;
+    }
+
+    return 0;
+}
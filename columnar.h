@@ -0,0 +1,61 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include "planet.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Columnar chart file, little-endian whatever the host
+ *
+ * ColFileHeader, then ncols ColDesc, then the row groups, then an index of ngroups uint64 row group offsets at
+ * index_offset. A row group is a ColGroupHeader followed by one ColChunk per column, and the column data; every
+ * chunk starts at a COLUMNAR_ALIGN boundary and holds nrows fixed-width values. There is one row per computed body
+ * of every chart.
+ */
+
+#define COLUMNAR_MAGIC "CKRCOLS1"
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_ALIGN 64
+#define COLUMNAR_GROUP_ROWS 65536
+
+typedef enum { COL_F64 = 1, COL_I64 = 2, COL_I32 = 3, COL_U8 = 4 } ColumnType;
+
+typedef struct {
+    char magic[8];
+    uint64_t version;
+    uint64_t ncols;
+    uint64_t nrows;
+    uint64_t ngroups;
+    uint64_t group_rows;   // rows per group; the last group may hold fewer
+    uint64_t index_offset; // file offset of the row group index
+    uint64_t reserved;
+} ColFileHeader;
+
+typedef struct {
+    char name[16];
+    uint64_t type;  // ColumnType
+    uint64_t width; // bytes per value
+} ColDesc;
+
+typedef struct {
+    uint64_t nrows;
+    uint64_t ncols;
+} ColGroupHeader;
+
+typedef struct {
+    uint64_t offset; // file offset of the column data
+    double min;      // smallest value of the chunk
+    double max;      // largest value of the chunk
+} ColChunk;
+
+typedef struct ColumnarWriter ColumnarWriter;
+
+ColumnarWriter *columnar_create(const char *path, size_t group_rows, char *serr);
+int columnar_add_chart(ColumnarWriter *cw, long chart_num, double tjd_ut, const PlanetData *chart, int n);
+int columnar_close(ColumnarWriter *cw, char *serr);
+int columnar_print_info(const char *path, char *serr);
+
+int columnar_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,32 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "cpu.h"
+#include <pthread.h>
+
+/*
+ * CPU feature detection
+ *
+ * The kernels ask on every call, from any thread of the pool, so the answer is computed once under pthread_once()
+ * and read without synchronization afterwards.
+ */
+
+static pthread_once_t cpu_once = PTHREAD_ONCE_INIT;
+static int cpu_avx2;
+
+static void cpu_detect(void) {
+#ifdef HAVE_AVX2_KERNEL
+    __builtin_cpu_init();
+    cpu_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+}
+
+/**
+ * @brief Tell whether the AVX2 kernels can run on this CPU
+ *
+ * @return int Non-zero if the CPU supports AVX2 and the kernels were compiled in
+ */
+int cpu_has_avx2(void) {
+    pthread_once(&cpu_once, cpu_detect);
+
+    return cpu_avx2;
+}
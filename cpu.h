@@ -0,0 +1,12 @@
+#ifndef CPU_H
+#define CPU_H
+
+// The AVX2 kernels are compiled with GCC or Clang on x86 and selected at run time with cpu_has_avx2()
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL 1
+#endif
+
+int cpu_has_avx2(void);
+
+#endif
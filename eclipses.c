@@ -0,0 +1,511 @@
+#include "eclipses.h"
+#include "events.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Eclipse catalog
+ *
+ * swe_sol_eclipse_when_glob() and swe_lun_eclipse_when() each find the next eclipse after a date, so a catalog is a
+ * chain of searches that is inherently serial. The range is cut into segments of ECLIPSE_SEGMENT days that are
+ * searched independently on the pool: every segment starts its chain at its own start and keeps the eclipses whose
+ * maximum falls inside it, so each eclipse belongs to exactly one segment. After the segments are merged and sorted,
+ * eclipses of the same kind whose maxima are less than ECLIPSE_DEDUP_DAYS apart are collapsed, which covers an
+ * eclipse found by two neighbouring segments with maxima that differ by a rounding.
+ *
+ * The local circumstances at each city are computed by the segment that found the eclipse, in the same pass: a
+ * local search started just before the global beginning finds the eclipse if it is visible there. That search does
+ * not stop at this eclipse, though; from a city that does not see it, it runs on to the next visible one, which can
+ * be years later. So swe_sol_eclipse_how() and swe_lun_eclipse_how() first check the city at the global maximum and
+ * then every ECLIPSE_VISIBILITY_STEP of the global eclipse, and the search is only made when one of them sees the
+ * eclipse with the body above the horizon. A local eclipse shorter than the step can slip between the samples.
+ */
+
+// Shortest time between two eclipses of the same kind is about a lunation
+#define ECLIPSE_DEDUP_DAYS 1.0
+
+// Local searches start this long before the global beginning of the eclipse
+#define ECLIPSE_LOCAL_LEAD 1.0
+
+// Sampling of the visibility check over the global eclipse, days (10 minutes)
+#define ECLIPSE_VISIBILITY_STEP (10.0 / 1440.0)
+
+// True altitude below which the eclipsed body cannot be seen: refraction and the semidiameter lift it by less
+#define ECLIPSE_HORIZON (-1.0)
+
+/**
+ * @brief Initialize an empty eclipse list
+ *
+ * @param list The list
+ */
+void eclipse_list_init(EclipseList *list) { memset(list, 0, sizeof(*list)); }
+
+/**
+ * @brief Release an eclipse list and the local circumstances of its eclipses
+ *
+ * @param list The list
+ */
+void eclipse_list_free(EclipseList *list) {
+    for (size_t i = 0; i < list->n; i++) {
+        free(list->items[i].local);
+    }
+    free(list->items);
+    eclipse_list_init(list);
+}
+
+/**
+ * @brief Append an eclipse to a list; the list takes over its local circumstances
+ *
+ * @param list The list
+ * @param e The eclipse
+ * @return int OK on success, ERR if out of memory
+ */
+static int eclipse_list_push(EclipseList *list, const Eclipse *e) {
+    if (list->n == list->cap) {
+        size_t cap = list->cap ? 2 * list->cap : 64;
+        Eclipse *items = (Eclipse *)realloc(list->items, cap * sizeof(Eclipse));
+
+        if (items == NULL) {
+            return ERR;
+        }
+        list->items = items;
+        list->cap = cap;
+    }
+    list->items[list->n++] = *e;
+
+    return OK;
+}
+
+static int compare_eclipses(const void *a, const void *b) {
+    const Eclipse *ea = (const Eclipse *)a, *eb = (const Eclipse *)b;
+
+    if (ea->jd != eb->jd) {
+        return ea->jd < eb->jd ? -1 : 1;
+    }
+
+    return ea->kind - eb->kind;
+}
+
+/**
+ * @brief Get the name of an eclipse type
+ *
+ * @param kind ECLIPSE_SOLAR or ECLIPSE_LUNAR
+ * @param type The SE_ECL_* type flags
+ * @return const char* The name
+ */
+const char *eclipse_type_name(int kind, int32 type) {
+    if (type & SE_ECL_TOTAL) {
+        return "total";
+    }
+    if (kind == ECLIPSE_SOLAR && (type & SE_ECL_ANNULAR)) {
+        return "annular";
+    }
+    if (kind == ECLIPSE_SOLAR && (type & SE_ECL_HYBRID)) {
+        return "hybrid";
+    }
+    if (type & SE_ECL_PENUMBRAL) {
+        return "penumbral";
+    }
+
+    return "partial";
+}
+
+/**
+ * @brief Tell whether a city sees an eclipse at a time
+ *
+ * @return int 1 if the eclipse is in progress there with the body above the horizon, 0 if not, ERR on a library error
+ */
+static int visible_at(const Eclipse *e, int iflags, double *geo, double tjd, char *serr) {
+    double attr[20];
+    int32 rc;
+
+    if (e->kind == ECLIPSE_SOLAR) {
+        rc = swe_sol_eclipse_how(tjd, iflags, geo, attr, serr);
+    } else {
+        rc = swe_lun_eclipse_how(tjd, iflags, geo, attr, serr);
+    }
+    if (rc == ERR) {
+        return ERR;
+    }
+
+    // attr[5] is the true altitude of the Sun or the Moon
+    return rc > 0 && attr[5] > ECLIPSE_HORIZON;
+}
+
+/**
+ * @brief Compute the local circumstances of an eclipse at a city
+ *
+ * @return int OK on success (local->flags is 0 if the eclipse is not visible), ERR on a library error
+ */
+static int local_circumstances(const Eclipse *e, int iflags, const City *city, LocalEclipse *local, char *serr) {
+    double geo[3], tret[10], attr[20];
+    int32 rc;
+
+    memcpy(geo, city->geo, sizeof(geo));
+    memset(local, 0, sizeof(*local));
+
+    rc = visible_at(e, iflags, geo, e->jd, serr);
+    for (double t = e->jd_begin; rc == 0 && t <= e->jd_end; t += ECLIPSE_VISIBILITY_STEP) {
+        rc = visible_at(e, iflags, geo, t, serr);
+    }
+    if (rc != 1) {
+        return rc == ERR ? ERR : OK;
+    }
+
+    if (e->kind == ECLIPSE_SOLAR) {
+        rc = swe_sol_eclipse_when_loc(e->jd_begin - ECLIPSE_LOCAL_LEAD, iflags, geo, tret, attr, 0, serr);
+    } else {
+        rc = swe_lun_eclipse_when_loc(e->jd_begin - ECLIPSE_LOCAL_LEAD, iflags, geo, tret, attr, 0, serr);
+    }
+    if (rc == ERR) {
+        return ERR;
+    }
+
+    // A later eclipse means this one is not visible from the city
+    if (rc > 0 && tret[0] <= e->jd_end + ECLIPSE_LOCAL_LEAD) {
+        local->flags = rc;
+        local->jd = tret[0];
+        local->magnitude = attr[0];
+        local->altitude = attr[5];
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Find the next eclipse of a kind after a date, with its global circumstances
+ *
+ * @return int OK on success, ERR on a library error
+ */
+static int next_eclipse(int kind, int iflags, double tjd, Eclipse *e, char *serr) {
+    double tret[10], attr[20], geo[3] = {0, 0, 0};
+    int32 rc;
+
+    memset(e, 0, sizeof(*e));
+    e->kind = kind;
+    if (kind == ECLIPSE_SOLAR) {
+        rc = swe_sol_eclipse_when_glob(tjd, iflags, 0, tret, 0, serr);
+        if (rc == ERR) {
+            return ERR;
+        }
+        e->jd = tret[0];
+        e->jd_begin = tret[2];
+        e->jd_end = tret[3];
+        if (swe_sol_eclipse_where(tret[0], iflags, geo, attr, serr) == ERR) {
+            return ERR;
+        }
+        e->magnitude = attr[8];
+        e->lon = geo[0];
+        e->lat = geo[1];
+    } else {
+        rc = swe_lun_eclipse_when(tjd, iflags, 0, tret, 0, serr);
+        if (rc == ERR) {
+            return ERR;
+        }
+        e->jd = tret[0];
+        e->jd_begin = tret[6];
+        e->jd_end = tret[7];
+        if (swe_lun_eclipse_how(tret[0], iflags, geo, attr, serr) == ERR) {
+            return ERR;
+        }
+        e->magnitude = (rc & SE_ECL_PENUMBRAL) ? attr[1] : attr[0];
+        e->lon = NAN;
+        e->lat = NAN;
+    }
+    e->type = rc;
+
+    return OK;
+}
+
+typedef struct {
+    int kinds;
+    int iflags;
+    double jd_start;
+    double jd_end;
+    const City *cities;
+    int ncities;
+    EclipseList *lists; // one per segment
+    int *status;
+} EclipseCtx;
+
+/**
+ * @brief Find the eclipses of one kind whose maximum falls in [seg_start, seg_end)
+ */
+static int search_segment(const EclipseCtx *c, int kind, double seg_start, double seg_end, EclipseList *out,
+                          char *serr) {
+    double t = seg_start;
+
+    for (;;) {
+        Eclipse e;
+
+        if (next_eclipse(kind, c->iflags, t, &e, serr) == ERR) {
+            return ERR;
+        }
+        if (e.jd >= seg_end) {
+            return OK;
+        }
+        // The next search starts after this maximum, and always moves forward
+        t = fmax(t, e.jd) + ECLIPSE_DEDUP_DAYS;
+        if (e.jd < seg_start) {
+            continue;
+        }
+
+        if (c->ncities > 0) {
+            e.local = (LocalEclipse *)malloc(c->ncities * sizeof(LocalEclipse));
+            if (e.local == NULL) {
+                return ERR;
+            }
+            for (int i = 0; i < c->ncities; i++) {
+                if (local_circumstances(&e, c->iflags, &c->cities[i], &e.local[i], serr) == ERR) {
+                    free(e.local);
+                    return ERR;
+                }
+            }
+        }
+        if (eclipse_list_push(out, &e) == ERR) {
+            free(e.local);
+            return ERR;
+        }
+    }
+}
+
+static void eclipse_task(void *ctx, size_t begin, size_t end, int worker) {
+    EclipseCtx *c = (EclipseCtx *)ctx;
+    char serr[256];
+
+    (void)worker;
+
+    for (size_t s = begin; s < end; s++) {
+        double seg_start = c->jd_start + s * ECLIPSE_SEGMENT;
+        double seg_end = fmin(seg_start + ECLIPSE_SEGMENT, c->jd_end);
+
+        c->status[s] = OK;
+        for (int kind = ECLIPSE_SOLAR; kind <= ECLIPSE_LUNAR && c->status[s] == OK; kind <<= 1) {
+            if ((c->kinds & kind) && search_segment(c, kind, seg_start, seg_end, &c->lists[s], serr) == ERR) {
+                fprintf(stderr, "Error: segment at %.1f: %s\n", seg_start, serr);
+                c->status[s] = ERR;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Find the solar and/or lunar eclipses over a range, with local circumstances at a list of cities
+ *
+ * @param kinds ECLIPSE_SOLAR, ECLIPSE_LUNAR or ECLIPSE_BOTH
+ * @param iflags The ephemeris flags for the Swiss Ephemeris
+ * @param jd_start The start of the range (UT)
+ * @param jd_end The end of the range (UT)
+ * @param cities The cities, or NULL
+ * @param ncities The number of cities
+ * @param pool The pool to spread the segments over, or NULL for the calling thread
+ * @param out The list the eclipses are appended to, sorted by time
+ * @return int OK on success, ERR if any segment failed or out of memory
+ */
+int find_eclipses(int kinds, int iflags, double jd_start, double jd_end, const City *cities, int ncities,
+                  ThreadPool *pool, EclipseList *out) {
+    size_t nsegments = jd_end > jd_start ? (size_t)ceil((jd_end - jd_start) / ECLIPSE_SEGMENT) : 0;
+    EclipseCtx ctx = {kinds, iflags, jd_start, jd_end, cities, ncities, NULL, NULL};
+    size_t first = out->n, kept;
+    int ret = OK;
+
+    ctx.lists = (EclipseList *)calloc(nsegments + 1, sizeof(EclipseList));
+    ctx.status = (int *)calloc(nsegments + 1, sizeof(int));
+    if (ctx.lists == NULL || ctx.status == NULL) {
+        free(ctx.lists);
+        free(ctx.status);
+        return ERR;
+    }
+
+    if (pool != NULL) {
+        pool_run(pool, nsegments, 1, eclipse_task, &ctx);
+    } else {
+        eclipse_task(&ctx, 0, nsegments, 0);
+    }
+
+    for (size_t s = 0; s < nsegments; s++) {
+        if (ctx.status[s] == ERR) {
+            ret = ERR;
+        }
+        for (size_t i = 0; i < ctx.lists[s].n; i++) {
+            if (eclipse_list_push(out, &ctx.lists[s].items[i]) == ERR) {
+                free(ctx.lists[s].items[i].local);
+                ret = ERR;
+            }
+        }
+        // The local circumstances now belong to out
+        free(ctx.lists[s].items);
+    }
+    qsort(out->items + first, out->n - first, sizeof(Eclipse), compare_eclipses);
+
+    // Collapse the same eclipse found on both sides of a segment boundary
+    kept = first;
+    for (size_t i = first; i < out->n; i++) {
+        int duplicate = 0;
+
+        for (size_t j = kept; j-- > first && out->items[i].jd - out->items[j].jd < ECLIPSE_DEDUP_DAYS;) {
+            if (out->items[j].kind == out->items[i].kind) {
+                duplicate = 1;
+                break;
+            }
+        }
+        if (duplicate) {
+            free(out->items[i].local);
+        } else {
+            out->items[kept++] = out->items[i];
+        }
+    }
+    out->n = kept;
+
+    free(ctx.lists);
+    free(ctx.status);
+
+    return ret;
+}
+
+/**
+ * @brief Read a city list: one "name latitude longitude [altitude]" per line, '#' starts a comment
+ *
+ * @param path The file
+ * @param cities The cities, to be released with free()
+ * @return int The number of cities, or ERR
+ */
+int read_cities(const char *path, City **cities) {
+    FILE *fp = fopen(path, "r");
+    char line[256];
+    int n = 0, cap = 0, line_num = 0;
+
+    *cities = NULL;
+    if (fp == NULL) {
+        perror(path);
+        return ERR;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        City city;
+        double lat, lon, alt = 0.0;
+        int fields;
+
+        line_num++;
+        if (line[strspn(line, " \t\r\n")] == '\0' || line[strspn(line, " \t")] == '#') {
+            continue;
+        }
+        fields = sscanf(line, "%31s %lf %lf %lf", city.name, &lat, &lon, &alt);
+        if (fields < 3) {
+            fprintf(stderr, "Error: %s line %d: expected name latitude longitude [altitude]\n", path, line_num);
+            continue;
+        }
+        city.geo[0] = lon;
+        city.geo[1] = lat;
+        city.geo[2] = alt;
+
+        if (n == cap) {
+            City *c;
+
+            cap = cap ? 2 * cap : 16;
+            c = (City *)realloc(*cities, cap * sizeof(City));
+            if (c == NULL) {
+                fclose(fp);
+                return ERR;
+            }
+            *cities = c;
+        }
+        (*cities)[n++] = city;
+    }
+    fclose(fp);
+
+    return n;
+}
+
+/**
+ * @brief Entry point of the eclipses mode
+ *
+ * main eclipses <jd_start> <jd_end> [-e solar|lunar|both] [-c cities] [-f iflags] [-j threads]
+ *
+ * Prints one line per eclipse: time of maximum, kind, type, magnitude and, for solar eclipses, the place of
+ * greatest eclipse; then, with -c, one indented line per city where it is visible: local maximum, magnitude and
+ * altitude of the eclipsed body.
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int eclipses_main(int argc, char **argv) {
+    int kinds = ECLIPSE_BOTH;
+    int iflags = SEFLG_SWIEPH;
+    int nthreads = 1;
+    const char *cities_path = NULL;
+    City *cities = NULL;
+    int ncities = 0;
+    ThreadPool *pool = NULL;
+    EclipseList list;
+    int ret;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: main eclipses <jd_start> <jd_end> [-e solar|lunar|both] [-c cities] [-f iflags] "
+                        "[-j threads]\n");
+        return 1;
+    }
+
+    for (int i = 3; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-e") == 0) {
+            if (strcmp(argv[i + 1], "solar") == 0) {
+                kinds = ECLIPSE_SOLAR;
+            } else if (strcmp(argv[i + 1], "lunar") == 0) {
+                kinds = ECLIPSE_LUNAR;
+            } else if (strcmp(argv[i + 1], "both") == 0) {
+                kinds = ECLIPSE_BOTH;
+            } else {
+                fprintf(stderr, "Error: unknown eclipse kind %s, expected solar, lunar or both\n", argv[i + 1]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-c") == 0) {
+            cities_path = argv[i + 1];
+        } else if (strcmp(argv[i], "-f") == 0) {
+            iflags = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            nthreads = atoi(argv[i + 1]);
+        }
+    }
+    if (cities_path != NULL && (ncities = read_cities(cities_path, &cities)) == ERR) {
+        return 1;
+    }
+    if (nthreads != 1) {
+        pool = pool_create(nthreads, NULL);
+    }
+
+    eclipse_list_init(&list);
+    ret = find_eclipses(kinds, iflags, atof(argv[1]), atof(argv[2]), cities, ncities, pool, &list);
+    pool_destroy(pool);
+
+    for (size_t i = 0; i < list.n; i++) {
+        const Eclipse *e = &list.items[i];
+
+        print_jd(e->jd);
+        printf(" %-5s %-9s %7.4f", e->kind == ECLIPSE_SOLAR ? "solar" : "lunar", eclipse_type_name(e->kind, e->type),
+               e->magnitude);
+        if (e->kind == ECLIPSE_SOLAR) {
+            printf(" %9.4f %8.4f", e->lon, e->lat);
+        }
+        printf("\n");
+
+        for (int c = 0; e->local != NULL && c < ncities; c++) {
+            const LocalEclipse *l = &e->local[c];
+
+            if (l->flags == 0) {
+                continue;
+            }
+            printf("    %-20s ", cities[c].name);
+            print_jd(l->jd);
+            printf(" %-9s %7.4f alt %8.4f\n", eclipse_type_name(e->kind, l->flags), l->magnitude, l->altitude);
+        }
+    }
+
+    eclipse_list_free(&list);
+    free(cities);
+    swe_close();
+
+    return ret == OK ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+#ifndef ECLIPSES_H
+#define ECLIPSES_H
+
+#include "pool.h"
+#include <stddef.h>
+
+// Days searched per pool item: ten years, about 24 solar and 24 lunar eclipses
+#define ECLIPSE_SEGMENT 3652.5
+
+typedef enum { ECLIPSE_SOLAR = 1, ECLIPSE_LUNAR = 2, ECLIPSE_BOTH = 3 } EclipseKind;
+
+// A place to compute local circumstances for
+typedef struct {
+    char name[32];
+    double geo[3]; // longitude, latitude, altitude in meters, as the Swiss Ephemeris takes them
+} City;
+
+// Circumstances of an eclipse at one city; flags is 0 if the eclipse is not visible there
+typedef struct {
+    int32 flags;      // SE_ECL_* type and visibility flags
+    double jd;        // local maximum (UT)
+    double magnitude; // solar: fraction of the Sun's diameter covered; lunar: umbral magnitude
+    double altitude;  // altitude of the eclipsed body at the local maximum, degrees
+} LocalEclipse;
+
+// One eclipse, with the local circumstances at each city if requested
+typedef struct {
+    int kind;            // ECLIPSE_SOLAR or ECLIPSE_LUNAR
+    int32 type;          // SE_ECL_* type flags
+    double jd;           // maximum (UT)
+    double jd_begin;     // solar: first contact on Earth; lunar: start of the penumbral phase
+    double jd_end;       // solar: last contact on Earth; lunar: end of the penumbral phase
+    double magnitude;    // solar: magnitude at the point of greatest eclipse; lunar: umbral, or penumbral if penumbral
+    double lon;          // solar: geographic longitude of greatest eclipse; NAN for lunar eclipses
+    double lat;          // solar: geographic latitude of greatest eclipse; NAN for lunar eclipses
+    LocalEclipse *local; // one per city, or NULL
+} Eclipse;
+
+// Growable array of eclipses
+typedef struct {
+    Eclipse *items;
+    size_t n;
+    size_t cap;
+} EclipseList;
+
+void eclipse_list_init(EclipseList *list);
+void eclipse_list_free(EclipseList *list);
+
+int find_eclipses(int kinds, int iflags, double jd_start, double jd_end, const City *cities, int ncities,
+                  ThreadPool *pool, EclipseList *out);
+const char *eclipse_type_name(int kind, int32 type);
+int read_cities(const char *path, City **cities);
+
+int eclipses_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,505 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ephtab.h"
+#include "planet.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Memory-mapped ephemeris table
+ *
+ * The file holds swe_calc_ut samples (position and speed) of a set of bodies at a fixed step. It is opened with
+ * mmap(PROT_READ, MAP_SHARED), so every process reading the same file shares one copy in the page cache, and
+ * opening it costs a few system calls whatever its size.
+ *
+ * Layout (native byte order): the EphTabHeader padded to EPHTAB_ALIGN, then one block per body starting at an
+ * EPHTAB_ALIGN boundary, holding nsteps records of EPHTAB_RECORD doubles. Sample i is taken at jd_start + i * step.
+ * Positions between samples are interpolated with cubic Hermite polynomials built from the stored speeds; the
+ * largest midpoint error of every body is measured at build time and kept in the header.
+ *
+ * The sidereal mode is state of the Swiss Ephemeris, not a flag, so a sidereal table also records its ayanamsa at
+ * jd_start and a lookup is refused when the current mode gives a different one. The ayanamsa is compared once per
+ * thread and table, not on every lookup, so a thread must not change its sidereal mode while it uses a table.
+ */
+
+#define EPHTAB_MAGIC "CKRETAB1"
+#define EPHTAB_VERSION 2
+
+// Largest difference between the recorded and the current ayanamsa, degrees, for the same sidereal mode
+#define EPHTAB_AYANAMSA_EPS 1e-9
+
+typedef struct {
+    int32 body; // -1 for an unused slot
+    int32 reserved;
+    int64 offset;       // file offset of the block
+    double max_err;     // largest midpoint interpolation error, arcseconds
+} EphTabBody;
+
+typedef struct {
+    char magic[8];
+    int32 version;
+    int32 iflags;   // the frame: SEFLG_HELCTR, SEFLG_EQUATORIAL, SEFLG_SIDEREAL, ... (SEFLG_SPEED stripped)
+    int32 sid_mode; // sidereal mode the table was built with, -1 if tropical
+    int32 nbodies;
+    double jd_start;
+    double step;
+    int64 nsteps;
+    int64 file_size;
+    double ayanamsa; // ayanamsa at jd_start in degrees, 0 if tropical
+    EphTabBody bodies[SE_NPLANETS];
+} EphTabHeader;
+
+struct EphTable {
+    const unsigned char *map;
+    size_t size;
+    const EphTabHeader *header;
+    const double *blocks[SE_NPLANETS]; // NULL if the body is not in the table
+    double jd_end;
+    int64 serial; // tells tables apart in the per-thread sidereal check, even at a reused address
+};
+
+static int64 last_serial = 0;
+
+// Table last checked against the sidereal mode of this thread, and the outcome
+static __thread int64 sid_checked_serial = 0;
+static __thread int sid_checked_ok = 0;
+
+/**
+ * @brief Round a file offset up to the block alignment
+ */
+static int64 align_up(int64 offset) { return (offset + EPHTAB_ALIGN - 1) / EPHTAB_ALIGN * EPHTAB_ALIGN; }
+
+/**
+ * @brief Cubic Hermite interpolation between two samples
+ *
+ * @param p0 The value at the first sample
+ * @param v0 The speed at the first sample, per day
+ * @param p1 The value at the second sample
+ * @param v1 The speed at the second sample, per day
+ * @param h The step in days
+ * @param u The position between the samples, in [0, 1]
+ * @param speed The interpolated speed, per day
+ * @return double The interpolated value
+ */
+static double hermite(double p0, double v0, double p1, double v1, double h, double u, double *speed) {
+    double u2 = u * u, u3 = u2 * u;
+    double h00 = 2 * u3 - 3 * u2 + 1, h10 = u3 - 2 * u2 + u, h01 = -2 * u3 + 3 * u2, h11 = u3 - u2;
+
+    *speed = ((6 * u2 - 6 * u) * (p0 - p1) + (3 * u2 - 4 * u + 1) * h * v0 + (3 * u2 - 2 * u) * h * v1) / h;
+
+    return h00 * p0 + h10 * h * v0 + h01 * p1 + h11 * h * v1;
+}
+
+/**
+ * @brief Interpolate one body between samples i and i + 1
+ */
+static void interpolate(const double *r0, const double *r1, double h, double u, double *xx) {
+    // Unwrap the second longitude relative to the first
+    double lon1 = r1[0];
+
+    if (lon1 - r0[0] > 180.0) {
+        lon1 -= 360.0;
+    } else if (lon1 - r0[0] < -180.0) {
+        lon1 += 360.0;
+    }
+
+    xx[0] = swe_degnorm(hermite(r0[0], r0[3], lon1, r1[3], h, u, &xx[3]));
+    xx[1] = hermite(r0[1], r0[4], r1[1], r1[4], h, u, &xx[4]);
+    xx[2] = hermite(r0[2], r0[5], r1[2], r1[5], h, u, &xx[5]);
+}
+
+/**
+ * @brief Compute the ayanamsa of the current sidereal mode at a time, with the ephemeris of the flags
+ */
+static double current_ayanamsa(double tjd_ut, int iflags) {
+    double daya = 0.0;
+    char serr[256];
+
+    if (swe_get_ayanamsa_ex_ut(tjd_ut, iflags & (SEFLG_JPLEPH | SEFLG_SWIEPH | SEFLG_MOSEPH), &daya, serr) < 0) {
+        return NAN;
+    }
+
+    return daya;
+}
+
+/**
+ * @brief Check that the sidereal mode of the calling thread gives the ayanamsa a table was built with
+ */
+static int sidereal_mode_matches(const EphTable *tab, int iflags) {
+    if (sid_checked_serial != tab->serial) {
+        double daya = current_ayanamsa(tab->header->jd_start, iflags);
+
+        sid_checked_ok = fabs(daya - tab->header->ayanamsa) <= EPHTAB_AYANAMSA_EPS;
+        sid_checked_serial = tab->serial;
+    }
+
+    return sid_checked_ok;
+}
+
+/**
+ * @brief Generate a table file
+ *
+ * Lookups must use the same flags; with SEFLG_SIDEREAL the given sidereal mode is applied to the calling thread
+ * before sampling and recorded in the header.
+ *
+ * @param path The output file
+ * @param jd_start The Julian Day (UT) of the first sample
+ * @param step The sample step in days
+ * @param nsteps The number of samples per body
+ * @param bodies The planet IDs
+ * @param nbodies The number of planet IDs
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param sid_mode The sidereal mode (SE_SIDM_*), used with SEFLG_SIDEREAL only
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR on failure
+ */
+int ephtab_build(const char *path, double jd_start, double step, int64 nsteps, const int *bodies, int nbodies,
+                 int iflags, int sid_mode, char *serr) {
+    EphTabHeader header;
+    double *block;
+    int64 offset;
+    FILE *fp;
+    int ret = OK;
+
+    if (step <= 0 || nsteps < 2 || nbodies <= 0 || nbodies > SE_NPLANETS) {
+        strcpy(serr, "invalid range or body list");
+        return ERR;
+    }
+    if (iflags & (SEFLG_XYZ | SEFLG_RADIANS)) {
+        strcpy(serr, "only polar coordinates in degrees can be tabulated");
+        return ERR;
+    }
+    // Topocentric positions depend on the observer set at lookup time, which the table cannot follow
+    if (iflags & SEFLG_TOPOCTR) {
+        strcpy(serr, "topocentric positions cannot be tabulated");
+        return ERR;
+    }
+
+    if (iflags & SEFLG_SIDEREAL) {
+        swe_set_sid_mode(sid_mode, 0, 0);
+    }
+
+    block = (double *)malloc((size_t)nsteps * EPHTAB_RECORD * sizeof(double));
+    fp = fopen(path, "wb");
+    if (block == NULL || fp == NULL) {
+        sprintf(serr, "cannot create %.200s", path);
+        free(block);
+        if (fp != NULL) {
+            fclose(fp);
+        }
+        return ERR;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EPHTAB_MAGIC, sizeof(header.magic));
+    header.version = EPHTAB_VERSION;
+    header.iflags = iflags & ~SEFLG_SPEED;
+    header.sid_mode = (iflags & SEFLG_SIDEREAL) ? sid_mode : -1;
+    header.ayanamsa = (iflags & SEFLG_SIDEREAL) ? current_ayanamsa(jd_start, iflags) : 0.0;
+    header.jd_start = jd_start;
+    header.step = step;
+    header.nsteps = nsteps;
+    for (int i = 0; i < SE_NPLANETS; i++) {
+        header.bodies[i].body = -1;
+    }
+
+    offset = align_up(sizeof(EphTabHeader));
+    for (int b = 0; b < nbodies; b++) {
+        EphTabBody *entry = &header.bodies[header.nbodies];
+        size_t nbytes = (size_t)nsteps * EPHTAB_RECORD * sizeof(double);
+        int failed = 0;
+
+        if (bodies[b] < 0 || bodies[b] >= SE_NPLANETS) {
+            continue;
+        }
+
+        for (int64 i = 0; i < nsteps && !failed; i++) {
+            if (swe_calc_ut(jd_start + i * step, bodies[b], header.iflags | SEFLG_SPEED, &block[i * EPHTAB_RECORD],
+                            serr) == ERR) {
+                failed = 1;
+            }
+        }
+        if (failed) {
+            fprintf(stderr, "Warning: body %d not tabulated: %s\n", bodies[b], serr);
+            continue;
+        }
+
+        // Measure the interpolation error half way between samples
+        entry->max_err = 0.0;
+        for (int64 i = 0; i + 1 < nsteps; i++) {
+            double xx[6], ref[6];
+
+            interpolate(&block[i * EPHTAB_RECORD], &block[(i + 1) * EPHTAB_RECORD], step, 0.5, xx);
+            if (swe_calc_ut(jd_start + (i + 0.5) * step, bodies[b], header.iflags, ref, serr) != ERR) {
+                double d = fabs(swe_difdeg2n(xx[0], ref[0]));
+
+                d = fmax(d, fabs(xx[1] - ref[1]));
+                entry->max_err = fmax(entry->max_err, d * 3600.0);
+            }
+        }
+
+        entry->body = bodies[b];
+        entry->offset = offset;
+        if (fseek(fp, (long)offset, SEEK_SET) != 0 || fwrite(block, 1, nbytes, fp) != nbytes) {
+            sprintf(serr, "cannot write %.200s", path);
+            ret = ERR;
+            break;
+        }
+        offset = align_up(offset + nbytes);
+        header.nbodies++;
+    }
+
+    header.file_size = offset;
+    if (ret == OK && (fseek(fp, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, fp) != 1)) {
+        sprintf(serr, "cannot write %.200s", path);
+        ret = ERR;
+    }
+    if (fclose(fp) != 0 && ret == OK) {
+        sprintf(serr, "cannot write %.200s", path);
+        ret = ERR;
+    }
+
+    // Pad the last block so the file size matches the header
+    if (ret == OK && truncate(path, (off_t)offset) != 0) {
+        sprintf(serr, "cannot resize %.200s", path);
+        ret = ERR;
+    }
+
+    free(block);
+
+    return ret;
+}
+
+/**
+ * @brief Map a table file read-only
+ *
+ * @param path The file
+ * @param serr Error buffer (at least 256 bytes)
+ * @return EphTable* The table, or NULL on error
+ */
+EphTable *ephtab_open(const char *path, char *serr) {
+    EphTable *tab;
+    struct stat st;
+    void *map;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        sprintf(serr, "cannot open %.200s", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(EphTabHeader)) {
+        sprintf(serr, "%.200s is not an ephemeris table", path);
+        close(fd);
+        return NULL;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        sprintf(serr, "cannot map %.200s", path);
+        return NULL;
+    }
+
+    tab = (EphTable *)calloc(1, sizeof(EphTable));
+    if (tab == NULL) {
+        munmap(map, (size_t)st.st_size);
+        strcpy(serr, "out of memory");
+        return NULL;
+    }
+    tab->map = (const unsigned char *)map;
+    tab->size = (size_t)st.st_size;
+    tab->header = (const EphTabHeader *)map;
+
+    if (memcmp(tab->header->magic, EPHTAB_MAGIC, sizeof(tab->header->magic)) != 0 ||
+        tab->header->version != EPHTAB_VERSION || tab->header->file_size != (int64)st.st_size ||
+        tab->header->nsteps < 2 || tab->header->nsteps > (int64)(tab->size / (EPHTAB_RECORD * sizeof(double))) ||
+        tab->header->step <= 0 || (tab->header->iflags & SEFLG_TOPOCTR)) {
+        sprintf(serr, "%.200s is not a valid ephemeris table", path);
+        ephtab_close(tab);
+        return NULL;
+    }
+
+    for (int b = 0; b < tab->header->nbodies && b < SE_NPLANETS; b++) {
+        const EphTabBody *entry = &tab->header->bodies[b];
+        int64 nbytes = tab->header->nsteps * EPHTAB_RECORD * (int64)sizeof(double);
+
+        // nbytes fits the file by the nsteps check above, so the subtraction cannot overflow
+        if (entry->body < 0 || entry->body >= SE_NPLANETS || entry->offset < (int64)sizeof(EphTabHeader) ||
+            entry->offset % EPHTAB_ALIGN != 0 || entry->offset > (int64)tab->size - nbytes) {
+            sprintf(serr, "%.200s has an invalid body table", path);
+            ephtab_close(tab);
+            return NULL;
+        }
+        tab->blocks[entry->body] = (const double *)(tab->map + entry->offset);
+    }
+    tab->jd_end = tab->header->jd_start + (tab->header->nsteps - 1) * tab->header->step;
+    tab->serial = __atomic_add_fetch(&last_serial, 1, __ATOMIC_RELAXED);
+
+    return tab;
+}
+
+/**
+ * @brief Unmap a table
+ *
+ * @param tab The table
+ */
+void ephtab_close(EphTable *tab) {
+    if (tab == NULL) {
+        return;
+    }
+    munmap((void *)tab->map, tab->size);
+    free(tab);
+}
+
+/**
+ * @brief Print the range, frame and per-body interpolation errors of a table
+ *
+ * @param tab The table
+ */
+void ephtab_print_info(const EphTable *tab) {
+    const EphTabHeader *h = tab->header;
+    char name[AS_MAXCH];
+
+    printf("Range: %.6f to %.6f, step %.6f days, %lld samples\n", h->jd_start, tab->jd_end, h->step,
+           (long long)h->nsteps);
+    printf("Flags: %d\n", h->iflags);
+    printf("Bodies: %d\n\n", h->nbodies);
+    for (int b = 0; b < h->nbodies; b++) {
+        swe_get_planet_name(h->bodies[b].body, name);
+        printf("%-14s offset %12lld, max error %.4f\"\n", name, (long long)h->bodies[b].offset, h->bodies[b].max_err);
+    }
+}
+
+/**
+ * @brief Get the raw samples of a body, without copying
+ *
+ * @param tab The table
+ * @param body The planet ID
+ * @param nsteps The number of samples
+ * @return const double* The samples, EPHTAB_RECORD doubles each, or NULL if the body is not in the table
+ */
+const double *ephtab_samples(const EphTable *tab, int body, int64 *nsteps) {
+    if (tab == NULL || body < 0 || body >= SE_NPLANETS) {
+        return NULL;
+    }
+    *nsteps = tab->header->nsteps;
+
+    return tab->blocks[body];
+}
+
+/**
+ * @brief Interpolate a position from the table
+ *
+ * @param tab The table
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param body The planet ID
+ * @param iflags The flags for the Swiss Ephemeris; apart from SEFLG_SPEED they must match the table, and with
+ * SEFLG_SIDEREAL the sidereal mode of the calling thread must be the one the table was built with, and must not
+ * change while the thread uses the table
+ * @param xx The longitude, latitude, distance and their speeds
+ * @return int OK on success, ERR if the request is not covered by the table
+ */
+int ephtab_calc(const EphTable *tab, double tjd_ut, int body, int iflags, double *xx) {
+    const double *block;
+    double t, u;
+    int64 i;
+
+    if (tab == NULL || body < 0 || body >= SE_NPLANETS || tab->blocks[body] == NULL ||
+        (iflags & ~SEFLG_SPEED) != tab->header->iflags) {
+        return ERR;
+    }
+    if (!(tjd_ut >= tab->header->jd_start && tjd_ut <= tab->jd_end)) {
+        return ERR;
+    }
+    if ((iflags & SEFLG_SIDEREAL) && !sidereal_mode_matches(tab, iflags)) {
+        return ERR;
+    }
+
+    block = tab->blocks[body];
+    t = (tjd_ut - tab->header->jd_start) / tab->header->step;
+    i = (int64)t;
+    if (i >= tab->header->nsteps - 1) {
+        i = tab->header->nsteps - 2;
+    }
+    u = t - (double)i;
+
+    interpolate(&block[i * EPHTAB_RECORD], &block[(i + 1) * EPHTAB_RECORD], tab->header->step, u, xx);
+    if (!(iflags & SEFLG_SPEED)) {
+        xx[3] = xx[4] = xx[5] = 0.0;
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Entry point of the table tool
+ *
+ * main ephtab build <file> <jd_start> <jd_end> <step> [-f iflags] [-s sid_mode]
+ * main ephtab info <file>
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int ephtab_main(int argc, char **argv) {
+    char serr[256];
+
+    if (argc >= 6 && strcmp(argv[1], "build") == 0) {
+        int bodies[NUM_CHART_BODIES];
+        int iflags = SEFLG_SWIEPH | SEFLG_HELCTR;
+        int sid_mode = SE_SIDM_FAGAN_BRADLEY;
+        double jd_start = atof(argv[3]);
+        double step = atof(argv[5]);
+        int64 nsteps;
+
+        for (int i = 6; i + 1 < argc; i += 2) {
+            if (strcmp(argv[i], "-f") == 0) {
+                iflags = atoi(argv[i + 1]);
+            } else if (strcmp(argv[i], "-s") == 0) {
+                sid_mode = atoi(argv[i + 1]);
+            }
+        }
+        if (step <= 0) {
+            fprintf(stderr, "Error: step must be positive\n");
+            return 1;
+        }
+        for (int i = 0; i < NUM_CHART_BODIES; i++) {
+            bodies[i] = i;
+        }
+
+        nsteps = (int64)ceil((atof(argv[4]) - jd_start) / step) + 1;
+        if (ephtab_build(argv[2], jd_start, step, nsteps, bodies, NUM_CHART_BODIES, iflags, sid_mode, serr) == ERR) {
+            fprintf(stderr, "Error: %s\n", serr);
+            return 1;
+        }
+        swe_close();
+        return 0;
+    }
+
+    if (argc == 3 && strcmp(argv[1], "info") == 0) {
+        EphTable *tab = ephtab_open(argv[2], serr);
+
+        if (tab == NULL) {
+            fprintf(stderr, "Error: %s\n", serr);
+            return 1;
+        }
+        ephtab_print_info(tab);
+        ephtab_close(tab);
+        return 0;
+    }
+
+    fprintf(stderr, "Usage: main ephtab build <file> <jd_start> <jd_end> <step> [-f iflags] [-s sid_mode]\n"
+                    "       main ephtab info <file>\n");
+
+    return 1;
+}
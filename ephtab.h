@@ -0,0 +1,25 @@
+#ifndef EPHTAB_H
+#define EPHTAB_H
+
+#include "swephexp.h"
+
+// Alignment of the per-body blocks; a multiple of the 4 KiB and 16 KiB page sizes in use
+#define EPHTAB_ALIGN 16384
+
+// Doubles stored per sample: longitude, latitude, distance and their speeds
+#define EPHTAB_RECORD 6
+
+typedef struct EphTable EphTable;
+
+int ephtab_build(const char *path, double jd_start, double step, int64 nsteps, const int *bodies, int nbodies,
+                 int iflags, int sid_mode, char *serr);
+EphTable *ephtab_open(const char *path, char *serr);
+void ephtab_close(EphTable *tab);
+void ephtab_print_info(const EphTable *tab);
+
+const double *ephtab_samples(const EphTable *tab, int body, int64 *nsteps);
+int ephtab_calc(const EphTable *tab, double tjd_ut, int body, int iflags, double *xx);
+
+int ephtab_main(int argc, char **argv);
+
+#endif
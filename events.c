@@ -0,0 +1,815 @@
+#include "events.h"
+#include "planet.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Longitude crossing engine
+ *
+ * find_crossings() reports every time a body crosses any of a set of target longitudes, which generalizes
+ * swe_solcross_ut() and swe_mooncross_ut() to every body and to many targets at once. The scan never steps over a
+ * crossing: a body whose speed is bounded by body_max_speed() cannot reach a target closer than d degrees in less
+ * than d / vmax days, so that step is always safe. Where the current speed from xx[3] predicts the next target
+ * further away, the scan steps up to that prediction instead, as long as the speed keeps its sign; if the speed
+ * changes sign over such a step (a station) without a crossing being seen, the step is redone with safe steps only,
+ * so the crossing and re-crossing of a retrograde loop are both found. Each bracketed crossing is refined by Newton
+ * iterations on swe_calc_ut, falling back to bisection whenever a Newton step leaves the bracket.
+ */
+
+// Smallest scan step, in days
+#define SCAN_MIN_STEP (1.0 / 1440.0)
+
+// Largest scan step, in days; well below the time between two stations of any planet
+#define SCAN_MAX_STEP 5.0
+
+// Speed sampling step of the station search, in days, and the margin scanned around the range so that the
+// partner station and shadow of a station near the range boundaries are found too
+#define STATION_STEP 1.0
+#define STATION_STEP_FAST 0.05
+#define STATION_MARGIN 250.0
+
+// Longest search for a shadow crossing, in days
+#define SHADOW_MAX_SEARCH 400.0
+
+// Convergence of the refinement, in days
+#define REFINE_EPS 1e-8
+#define REFINE_MAX_ITER 60
+
+/**
+ * @brief Initialize an empty crossing list
+ *
+ * @param list The list
+ */
+void crossing_list_init(CrossingList *list) { memset(list, 0, sizeof(*list)); }
+
+/**
+ * @brief Release a crossing list
+ *
+ * @param list The list
+ */
+void crossing_list_free(CrossingList *list) {
+    free(list->items);
+    crossing_list_init(list);
+}
+
+/**
+ * @brief Append a crossing to a list
+ *
+ * @param list The list
+ * @param c The crossing
+ * @return int OK on success, ERR if out of memory
+ */
+int crossing_list_push(CrossingList *list, const Crossing *c) {
+    if (list->n == list->cap) {
+        size_t cap = list->cap ? 2 * list->cap : 64;
+        Crossing *items = (Crossing *)realloc(list->items, cap * sizeof(Crossing));
+
+        if (items == NULL) {
+            return ERR;
+        }
+        list->items = items;
+        list->cap = cap;
+    }
+    list->items[list->n++] = *c;
+
+    return OK;
+}
+
+static int compare_crossings(const void *a, const void *b) {
+    const Crossing *ca = (const Crossing *)a;
+    const Crossing *cb = (const Crossing *)b;
+
+    if (ca->jd != cb->jd) {
+        return ca->jd < cb->jd ? -1 : 1;
+    }
+
+    return ca->body - cb->body;
+}
+
+/**
+ * @brief Sort a crossing list by time, then by body
+ *
+ * @param list The list
+ */
+void crossing_list_sort(CrossingList *list) { qsort(list->items, list->n, sizeof(Crossing), compare_crossings); }
+
+/**
+ * @brief Get an upper bound of the longitudinal speed of a body
+ *
+ * The bounds include a safety margin and cover geocentric, topocentric, heliocentric and equatorial coordinates.
+ *
+ * @param body The planet ID
+ * @param iflags The flags for the Swiss Ephemeris
+ * @return double The bound in degrees per day
+ */
+double body_max_speed(int body, int iflags) {
+    // Geocentric bounds for SE_SUN to SE_INTP_PERG; the Moon's covers topocentric parallax
+    static const double geo[SE_NPLANETS] = {1.02, 16.5, 2.2,  1.27, 0.8,  0.25, 0.14, 0.07, 0.04, 0.04, 0.06, 1.0,
+                                            0.12, 10.0, 1.02, 0.16, 0.15, 0.5,  0.8,  0.6,  0.6,  1.0,  1.0};
+    // Heliocentric bounds differ for the inner planets
+    static const double helio[SE_NPLANETS] = {0.0,  16.5, 6.4,  1.65, 0.7,  0.25, 0.14, 0.07, 0.04, 0.04, 0.06, 1.0,
+                                              0.12, 10.0, 1.02, 0.16, 0.15, 0.5,  0.8,  0.6,  0.6,  1.0,  1.0};
+    double v = 2.0;
+
+    if (body >= 0 && body < SE_NPLANETS) {
+        v = (iflags & (SEFLG_HELCTR | SEFLG_BARYCTR)) ? helio[body] : geo[body];
+    }
+
+    // Right ascension moves up to about 10% faster than longitude; keep a margin for both
+    return fmax(v, 0.01) * 1.3;
+}
+
+/**
+ * @brief Signed distance from a target longitude, in [-180, 180)
+ */
+static double lon_diff(double lon, double target) {
+    double d = fmod(lon - target, 360.0);
+
+    if (d < -180.0) {
+        d += 360.0;
+    } else if (d >= 180.0) {
+        d -= 360.0;
+    }
+
+    return d;
+}
+
+/**
+ * @brief Refine a bracketed crossing
+ *
+ * @param body The planet ID
+ * @param iflags The flags for the Swiss Ephemeris, with SEFLG_SPEED
+ * @param target The target longitude
+ * @param a The start of the bracket
+ * @param fa The signed distance from the target at a
+ * @param b The end of the bracket
+ * @param jd The time of the crossing
+ * @param speed The speed at the crossing
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR on failure
+ */
+static int refine_crossing(int body, int iflags, double target, double a, double fa, double b, double *jd,
+                           double *speed, char *serr) {
+    double t = 0.5 * (a + b);
+    double xx[6];
+
+    for (int iter = 0; iter < REFINE_MAX_ITER; iter++) {
+        double f, next;
+
+        if (swe_calc_ut(t, body, iflags, xx, serr) == ERR) {
+            return ERR;
+        }
+        f = lon_diff(xx[0], target);
+        *speed = xx[3];
+
+        // Shrink the bracket around the sign change
+        if ((f < 0) == (fa < 0)) {
+            a = t;
+            fa = f;
+        } else {
+            b = t;
+        }
+
+        next = xx[3] != 0.0 ? t - f / xx[3] : a - 1.0;
+        if (!(next > a && next < b)) {
+            next = 0.5 * (a + b);
+        }
+        if (fabs(next - t) < REFINE_EPS || b - a < REFINE_EPS) {
+            t = next;
+            break;
+        }
+        t = next;
+    }
+
+    *jd = t;
+
+    return OK;
+}
+
+/**
+ * @brief Find all crossings of a set of target longitudes by one body
+ *
+ * @param body The planet ID
+ * @param iflags The flags for the Swiss Ephemeris (SEFLG_SPEED is added)
+ * @param jd_start The start of the range (UT)
+ * @param jd_end The end of the range (UT)
+ * @param targets The target longitudes in degrees
+ * @param ntargets The number of targets
+ * @param out The list the crossings are appended to, in time order
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR on failure
+ */
+int find_crossings(int body, int iflags, double jd_start, double jd_end, const double *targets, int ntargets,
+                   CrossingList *out, char *serr) {
+    double vmax = body_max_speed(body, iflags);
+    double t = jd_start, safe_until = jd_start;
+    double xx[6], x2[6];
+
+    iflags |= SEFLG_SPEED;
+    if (swe_calc_ut(t, body, iflags, xx, serr) == ERR) {
+        return ERR;
+    }
+
+    while (t < jd_end) {
+        double nearest = 360.0, ahead = 360.0;
+        double h, t2;
+
+        // Distance to the nearest target, and to the nearest one in the direction of motion
+        for (int j = 0; j < ntargets; j++) {
+            double d = lon_diff(xx[0], targets[j]);
+            double dir = xx[3] >= 0 ? -d : d;
+
+            nearest = fmin(nearest, fabs(d));
+            if (dir <= 0) {
+                dir += 360.0;
+            }
+            ahead = fmin(ahead, dir);
+        }
+
+        h = nearest / vmax;
+        if (t >= safe_until && xx[3] != 0.0) {
+            h = fmax(h, fmin(1.25 * ahead / fabs(xx[3]), SCAN_MAX_STEP));
+        }
+        h = fmax(h, SCAN_MIN_STEP);
+        t2 = fmin(t + h, jd_end);
+
+        if (swe_calc_ut(t2, body, iflags, x2, serr) == ERR) {
+            return ERR;
+        }
+
+        // A station inside a long step may hide a crossing and its re-crossing, and a single sign change found in
+        // such a step may be the wrong one of three: redo it with safe steps before recording anything
+        if (t >= safe_until && (xx[3] < 0) != (x2[3] < 0) && t2 - t > nearest / vmax) {
+            safe_until = t2;
+            continue;
+        }
+
+        for (int j = 0; j < ntargets; j++) {
+            double d1 = lon_diff(xx[0], targets[j]);
+            double d2 = lon_diff(x2[0], targets[j]);
+
+            // A sign change far from the target is the wrap-around at the opposite point
+            if ((d1 < 0) != (d2 < 0) && fabs(d1 - d2) < 180.0) {
+                Crossing c;
+                double speed;
+
+                if (refine_crossing(body, iflags, targets[j], t, d1, t2, &c.jd, &speed, serr) == ERR) {
+                    return ERR;
+                }
+                c.body = body;
+                c.target = j;
+                c.lon = targets[j];
+                c.direction = d2 > d1 ? 1 : -1;
+                if (crossing_list_push(out, &c) == ERR) {
+                    strcpy(serr, "out of memory");
+                    return ERR;
+                }
+            }
+        }
+
+        t = t2;
+        memcpy(xx, x2, sizeof(xx));
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Initialize an empty station list
+ *
+ * @param list The list
+ */
+void station_list_init(StationList *list) { memset(list, 0, sizeof(*list)); }
+
+/**
+ * @brief Release a station list
+ *
+ * @param list The list
+ */
+void station_list_free(StationList *list) {
+    free(list->items);
+    station_list_init(list);
+}
+
+/**
+ * @brief Append a station to a list
+ *
+ * @param list The list
+ * @param st The station
+ * @return int OK on success, ERR if out of memory
+ */
+static int station_list_push(StationList *list, const Station *st) {
+    if (list->n == list->cap) {
+        size_t cap = list->cap ? 2 * list->cap : 64;
+        Station *items = (Station *)realloc(list->items, cap * sizeof(Station));
+
+        if (items == NULL) {
+            return ERR;
+        }
+        list->items = items;
+        list->cap = cap;
+    }
+    list->items[list->n++] = *st;
+
+    return OK;
+}
+
+static int compare_stations(const void *a, const void *b) {
+    const Station *sa = (const Station *)a;
+    const Station *sb = (const Station *)b;
+
+    if (sa->jd != sb->jd) {
+        return sa->jd < sb->jd ? -1 : 1;
+    }
+
+    return sa->body - sb->body;
+}
+
+/**
+ * @brief Refine the time at which the longitude speed crosses zero
+ *
+ * Uses the Illinois variant of regula falsi, which keeps the bracket and converges superlinearly.
+ *
+ * @param body The planet ID
+ * @param iflags The flags for the Swiss Ephemeris, with SEFLG_SPEED
+ * @param a The start of the bracket
+ * @param fa The speed at a
+ * @param b The end of the bracket
+ * @param fb The speed at b
+ * @param jd The time of the station
+ * @param lon The longitude at the station
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR on failure
+ */
+static int refine_station(int body, int iflags, double a, double fa, double b, double fb, double *jd, double *lon,
+                          char *serr) {
+    double xx[6];
+    int side = 0;
+    double t = a;
+
+    for (int iter = 0; iter < REFINE_MAX_ITER && b - a > REFINE_EPS; iter++) {
+        t = (a * fb - b * fa) / (fb - fa);
+        if (!(t > a && t < b)) {
+            t = 0.5 * (a + b);
+        }
+        if (swe_calc_ut(t, body, iflags, xx, serr) == ERR) {
+            return ERR;
+        }
+
+        if ((xx[3] < 0) == (fa < 0)) {
+            a = t;
+            fa = xx[3];
+            if (side == -1) {
+                fb *= 0.5;
+            }
+            side = -1;
+        } else {
+            b = t;
+            fb = xx[3];
+            if (side == 1) {
+                fa *= 0.5;
+            }
+            side = 1;
+        }
+        if (xx[3] == 0.0) {
+            break;
+        }
+    }
+
+    if (swe_calc_ut(t, body, iflags, xx, serr) == ERR) {
+        return ERR;
+    }
+    *jd = t;
+    *lon = xx[0];
+
+    return OK;
+}
+
+/**
+ * @brief Find the time a body passes a longitude in direct motion, searching away from a station
+ *
+ * @param body The planet ID
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param lon The longitude
+ * @param jd The station to search from
+ * @param dir -1 to search backwards (last crossing before jd), +1 to search forwards (first crossing after jd)
+ * @param shadow_jd The time of the crossing, or NAN if none was found
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR on failure
+ */
+static int find_shadow(int body, int iflags, double lon, double jd, int dir, double *shadow_jd, char *serr) {
+    *shadow_jd = NAN;
+
+    for (double window = 30.0; window <= SHADOW_MAX_SEARCH; window *= 2.0) {
+        CrossingList list;
+        double result = NAN;
+
+        crossing_list_init(&list);
+        if (find_crossings(body, iflags, dir < 0 ? jd - window : jd, dir < 0 ? jd : jd + window, &lon, 1, &list,
+                           serr) == ERR) {
+            crossing_list_free(&list);
+            return ERR;
+        }
+        for (size_t i = 0; i < list.n; i++) {
+            if (list.items[i].direction > 0) {
+                if (dir > 0) {
+                    result = list.items[i].jd;
+                    break;
+                }
+                result = list.items[i].jd;
+            }
+        }
+        crossing_list_free(&list);
+
+        if (!isnan(result)) {
+            *shadow_jd = result;
+            break;
+        }
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Find the stations of one body
+ *
+ * @param body The planet ID
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param jd_start The start of the range (UT)
+ * @param jd_end The end of the range (UT)
+ * @param out The list the stations within the range are appended to, in time order
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR on failure
+ */
+static int find_body_stations(int body, int iflags, double jd_start, double jd_end, StationList *out, char *serr) {
+    // The true node and the osculating apogee change direction every few days
+    double step = (body == SE_TRUE_NODE || body == SE_OSCU_APOG) ? STATION_STEP_FAST : STATION_STEP;
+    double t0 = jd_start - STATION_MARGIN, t1 = jd_end + STATION_MARGIN;
+    double xx[6];
+    double t, speed;
+    StationList all;
+    int ret = OK;
+
+    iflags |= SEFLG_SPEED;
+    station_list_init(&all);
+
+    if (swe_calc_ut(t0, body, iflags, xx, serr) == ERR) {
+        return ERR;
+    }
+    speed = xx[3];
+
+    // Coarse speed sampling, then root refinement of every sign change
+    for (t = t0; t < t1;) {
+        double t2 = fmin(t + step, t1);
+
+        if (swe_calc_ut(t2, body, iflags, xx, serr) == ERR) {
+            station_list_free(&all);
+            return ERR;
+        }
+        if ((speed < 0) != (xx[3] < 0)) {
+            Station st;
+
+            if (refine_station(body, iflags, t, speed, t2, xx[3], &st.jd, &st.lon, serr) == ERR) {
+                station_list_free(&all);
+                return ERR;
+            }
+            st.body = body;
+            st.type = xx[3] < 0 ? STATION_RETROGRADE : STATION_DIRECT;
+            st.shadow_jd = NAN;
+            if (station_list_push(&all, &st) == ERR) {
+                station_list_free(&all);
+                strcpy(serr, "out of memory");
+                return ERR;
+            }
+        }
+        t = t2;
+        speed = xx[3];
+    }
+
+    // Shadows: the pre-shadow starts when the body first reaches the longitude of the following direct station,
+    // the post-shadow ends when it gets back to the longitude of the preceding retrograde station
+    for (size_t i = 0; i < all.n; i++) {
+        Station *st = &all.items[i];
+
+        if (st->jd < jd_start || st->jd >= jd_end) {
+            continue;
+        }
+        if (st->type == STATION_RETROGRADE && i + 1 < all.n) {
+            ret = find_shadow(body, iflags, all.items[i + 1].lon, st->jd, -1, &st->shadow_jd, serr);
+        } else if (st->type == STATION_DIRECT && i > 0) {
+            ret = find_shadow(body, iflags, all.items[i - 1].lon, st->jd, 1, &st->shadow_jd, serr);
+        }
+        if (ret == ERR) {
+            station_list_free(&all);
+            return ERR;
+        }
+        if (station_list_push(out, st) == ERR) {
+            station_list_free(&all);
+            strcpy(serr, "out of memory");
+            return ERR;
+        }
+    }
+
+    station_list_free(&all);
+
+    return OK;
+}
+
+typedef struct {
+    const int *bodies;
+    int iflags;
+    double jd_start;
+    double jd_end;
+    CrossingList *lists; // one per body
+    StationList *stations;
+    int *status;
+} EventCtx;
+
+static void ingress_task(void *ctx, size_t begin, size_t end, int worker) {
+    static const double cusps[NUM_SIGNS] = {0, 30, 60, 90, 120, 150, 180, 210, 240, 270, 300, 330};
+    EventCtx *c = (EventCtx *)ctx;
+    char serr[256];
+
+    (void)worker;
+
+    for (size_t b = begin; b < end; b++) {
+        c->status[b] = find_crossings(c->bodies[b], c->iflags, c->jd_start, c->jd_end, cusps, NUM_SIGNS, &c->lists[b],
+                                      serr);
+        if (c->status[b] == ERR) {
+            fprintf(stderr, "Error: body %d: %s\n", c->bodies[b], serr);
+        }
+    }
+}
+
+/**
+ * @brief Find the sign ingresses of several bodies, including re-ingresses during retrograde motion
+ *
+ * The target of each crossing is the sign boundary; the sign entered is target when direction is +1 and the
+ * previous sign when it is -1.
+ *
+ * @param bodies The planet IDs
+ * @param nbodies The number of planet IDs
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param jd_start The start of the range (UT)
+ * @param jd_end The end of the range (UT)
+ * @param pool The pool to spread the bodies over, or NULL for the calling thread
+ * @param out The list the ingresses are appended to, sorted by time
+ * @return int OK on success, ERR if any body failed
+ */
+int find_ingresses(const int *bodies, int nbodies, int iflags, double jd_start, double jd_end, ThreadPool *pool,
+                   CrossingList *out) {
+    EventCtx ctx = {bodies, iflags, jd_start, jd_end, NULL, NULL, NULL};
+    int ret = OK;
+
+    ctx.lists = (CrossingList *)calloc(nbodies, sizeof(CrossingList));
+    ctx.status = (int *)calloc(nbodies, sizeof(int));
+    if (ctx.lists == NULL || ctx.status == NULL) {
+        free(ctx.lists);
+        free(ctx.status);
+        return ERR;
+    }
+
+    if (pool != NULL) {
+        pool_run(pool, (size_t)nbodies, 1, ingress_task, &ctx);
+    } else {
+        ingress_task(&ctx, 0, (size_t)nbodies, 0);
+    }
+
+    for (int b = 0; b < nbodies; b++) {
+        if (ctx.status[b] == ERR) {
+            ret = ERR;
+        }
+        for (size_t i = 0; i < ctx.lists[b].n; i++) {
+            if (crossing_list_push(out, &ctx.lists[b].items[i]) == ERR) {
+                ret = ERR;
+            }
+        }
+        crossing_list_free(&ctx.lists[b]);
+    }
+    crossing_list_sort(out);
+
+    free(ctx.lists);
+    free(ctx.status);
+
+    return ret;
+}
+
+static void stations_task(void *ctx, size_t begin, size_t end, int worker) {
+    EventCtx *c = (EventCtx *)ctx;
+    char serr[256];
+
+    (void)worker;
+
+    for (size_t b = begin; b < end; b++) {
+        c->status[b] = find_body_stations(c->bodies[b], c->iflags, c->jd_start, c->jd_end, &c->stations[b], serr);
+        if (c->status[b] == ERR) {
+            fprintf(stderr, "Error: body %d: %s\n", c->bodies[b], serr);
+        }
+    }
+}
+
+/**
+ * @brief Find the retrograde and direct stations of several bodies, with their shadow periods
+ *
+ * The speed of every body is sampled coarsely (daily, or every 0.05 days for the true node and the osculating
+ * apogee), and every sign change is refined to the exact station.
+ *
+ * @param bodies The planet IDs
+ * @param nbodies The number of planet IDs
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param jd_start The start of the range (UT)
+ * @param jd_end The end of the range (UT)
+ * @param pool The pool to spread the bodies over, or NULL for the calling thread
+ * @param out The list the stations are appended to, sorted by time
+ * @return int OK on success, ERR if any body failed
+ */
+int find_stations(const int *bodies, int nbodies, int iflags, double jd_start, double jd_end, ThreadPool *pool,
+                  StationList *out) {
+    EventCtx ctx = {bodies, iflags, jd_start, jd_end, NULL, NULL, NULL};
+    int ret = OK;
+
+    ctx.stations = (StationList *)calloc(nbodies, sizeof(StationList));
+    ctx.status = (int *)calloc(nbodies, sizeof(int));
+    if (ctx.stations == NULL || ctx.status == NULL) {
+        free(ctx.stations);
+        free(ctx.status);
+        return ERR;
+    }
+
+    if (pool != NULL) {
+        pool_run(pool, (size_t)nbodies, 1, stations_task, &ctx);
+    } else {
+        stations_task(&ctx, 0, (size_t)nbodies, 0);
+    }
+
+    for (int b = 0; b < nbodies; b++) {
+        if (ctx.status[b] == ERR) {
+            ret = ERR;
+        }
+        for (size_t i = 0; i < ctx.stations[b].n; i++) {
+            if (station_list_push(out, &ctx.stations[b].items[i]) == ERR) {
+                ret = ERR;
+            }
+        }
+        station_list_free(&ctx.stations[b]);
+    }
+    qsort(out->items, out->n, sizeof(Station), compare_stations);
+
+    free(ctx.stations);
+    free(ctx.status);
+
+    return ret;
+}
+
+/**
+ * @brief Print a Julian Day as "jd YYYY-MM-DD hours"
+ *
+ * @param jd The Julian Day (UT)
+ */
+void print_jd(double jd) {
+    int year, month, day;
+    double hour;
+
+    swe_revjul(jd, SE_GREG_CAL, &year, &month, &day, &hour);
+    printf("%.8f %04d-%02d-%02d %08.5f", jd, year, month, day, hour);
+}
+
+/**
+ * @brief Parse the common options of the event modes: [-b bodies] [-f iflags] [-j threads]
+ *
+ * @return int OK on success, ERR on an invalid body list
+ */
+static int parse_event_options(int argc, char **argv, int first, int *bodies, int *nbodies, int *iflags,
+                               int *nthreads) {
+    for (int i = first; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-b") == 0) {
+            *nbodies = parse_body_list(argv[i + 1], bodies, SE_NPLANETS);
+        } else if (strcmp(argv[i], "-f") == 0) {
+            *iflags = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            *nthreads = atoi(argv[i + 1]);
+        }
+    }
+    if (*nbodies <= 0) {
+        fprintf(stderr, "Error: invalid body list\n");
+        return ERR;
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Entry point of the ingress mode
+ *
+ * main ingress <jd_start> <jd_end> [-b bodies] [-f iflags] [-j threads]
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int ingress_main(int argc, char **argv) {
+    int bodies[SE_NPLANETS];
+    int nbodies = SE_PLUTO + 1;
+    int iflags = SEFLG_SWIEPH;
+    int nthreads = 1;
+    ThreadPool *pool = NULL;
+    CrossingList list;
+    int ret;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: main ingress <jd_start> <jd_end> [-b bodies] [-f iflags] [-j threads]\n");
+        return 1;
+    }
+
+    for (int i = 0; i < nbodies; i++) {
+        bodies[i] = i;
+    }
+    if (parse_event_options(argc, argv, 3, bodies, &nbodies, &iflags, &nthreads) == ERR) {
+        return 1;
+    }
+    if (nthreads != 1) {
+        pool = pool_create(nthreads, NULL);
+    }
+
+    crossing_list_init(&list);
+    ret = find_ingresses(bodies, nbodies, iflags, atof(argv[1]), atof(argv[2]), pool, &list);
+    pool_destroy(pool);
+
+    for (size_t i = 0; i < list.n; i++) {
+        const Crossing *c = &list.items[i];
+        int sign = c->direction > 0 ? c->target : (c->target + NUM_SIGNS - 1) % NUM_SIGNS;
+        char name[AS_MAXCH];
+
+        swe_get_planet_name(c->body, name);
+        print_jd(c->jd);
+        printf(" %-12s %s%s\n", name, get_sign(sign), c->direction < 0 ? " R" : "");
+    }
+
+    crossing_list_free(&list);
+    swe_close();
+
+    return ret == OK ? 0 : 1;
+}
+
+/**
+ * @brief Entry point of the stations mode
+ *
+ * main stations <jd_start> <jd_end> [-b bodies] [-f iflags] [-j threads]
+ *
+ * Prints one line per station: time, body, SR/SD, longitude, then the start of the pre-shadow (SR) or the end of the
+ * post-shadow (SD).
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int stations_main(int argc, char **argv) {
+    int bodies[SE_NPLANETS];
+    int nbodies = SE_PLUTO - SE_MERCURY + 1;
+    int iflags = SEFLG_SWIEPH;
+    int nthreads = 1;
+    ThreadPool *pool = NULL;
+    StationList list;
+    int ret;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: main stations <jd_start> <jd_end> [-b bodies] [-f iflags] [-j threads]\n");
+        return 1;
+    }
+
+    for (int i = 0; i < nbodies; i++) {
+        bodies[i] = SE_MERCURY + i;
+    }
+    if (parse_event_options(argc, argv, 3, bodies, &nbodies, &iflags, &nthreads) == ERR) {
+        return 1;
+    }
+    if (nthreads != 1) {
+        pool = pool_create(nthreads, NULL);
+    }
+
+    station_list_init(&list);
+    ret = find_stations(bodies, nbodies, iflags, atof(argv[1]), atof(argv[2]), pool, &list);
+    pool_destroy(pool);
+
+    for (size_t i = 0; i < list.n; i++) {
+        const Station *st = &list.items[i];
+        char name[AS_MAXCH];
+
+        swe_get_planet_name(st->body, name);
+        print_jd(st->jd);
+        printf(" %-12s %s %12.7f shadow ", name, st->type == STATION_RETROGRADE ? "SR" : "SD", st->lon);
+        if (isnan(st->shadow_jd)) {
+            printf("-\n");
+        } else {
+            print_jd(st->shadow_jd);
+            printf("\n");
+        }
+    }
+
+    station_list_free(&list);
+    swe_close();
+
+    return ret == OK ? 0 : 1;
+}
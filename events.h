@@ -0,0 +1,62 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "pool.h"
+#include <stddef.h>
+
+// One crossing of a target longitude by a body
+typedef struct {
+    double jd;      // Julian Day (UT) of the crossing
+    int body;
+    int target;     // index of the target longitude that was crossed
+    double lon;     // the target longitude
+    int direction;  // +1 when crossed in direct motion, -1 in retrograde motion
+} Crossing;
+
+// Growable array of crossings
+typedef struct {
+    Crossing *items;
+    size_t n;
+    size_t cap;
+} CrossingList;
+
+void crossing_list_init(CrossingList *list);
+void crossing_list_free(CrossingList *list);
+int crossing_list_push(CrossingList *list, const Crossing *c);
+void crossing_list_sort(CrossingList *list);
+
+typedef enum { STATION_RETROGRADE = -1, STATION_DIRECT = 1 } StationType;
+
+// One station of a body, with the matching end of its shadow period
+typedef struct {
+    double jd;        // Julian Day (UT) at which the longitude speed crosses zero
+    int body;
+    int type;         // StationType
+    double lon;       // longitude at the station
+    double shadow_jd; // retrograde station: start of the pre-shadow; direct station: end of the post-shadow
+} Station;
+
+// Growable array of stations
+typedef struct {
+    Station *items;
+    size_t n;
+    size_t cap;
+} StationList;
+
+void station_list_init(StationList *list);
+void station_list_free(StationList *list);
+
+double body_max_speed(int body, int iflags);
+int find_crossings(int body, int iflags, double jd_start, double jd_end, const double *targets, int ntargets,
+                   CrossingList *out, char *serr);
+int find_ingresses(const int *bodies, int nbodies, int iflags, double jd_start, double jd_end, ThreadPool *pool,
+                   CrossingList *out);
+int find_stations(const int *bodies, int nbodies, int iflags, double jd_start, double jd_end, ThreadPool *pool,
+                  StationList *out);
+
+void print_jd(double jd);
+
+int ingress_main(int argc, char **argv);
+int stations_main(int argc, char **argv);
+
+#endif
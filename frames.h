@@ -0,0 +1,30 @@
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include "planet.h"
+
+// One arc second, in degrees
+#define FRAMES_DEFAULT_TOLERANCE (1.0 / 3600.0)
+
+// Oldest anchor a body is extrapolated from, in days; the true node and the osculating apogee wobble within hours
+#define FRAMES_MAX_AGE 1.0
+#define FRAMES_MAX_AGE_FAST (1.0 / 24.0)
+
+// Safety factor on the acceleration estimated from two anchors, which lags behind the true one
+#define FRAMES_ACCEL_MARGIN 2.0
+
+// A chart kept up to date frame by frame: the last exactly computed data of every body, and when it was computed
+typedef struct {
+    PlanetData anchor[NUM_CHART_BODIES]; // body is -1 when there is no anchor
+    double anchor_jd[NUM_CHART_BODIES];  // Julian Day (UT) of each anchor
+    double accel[NUM_CHART_BODIES][2];   // longitude and latitude acceleration, degrees/day^2; NAN when unknown
+    int iflags;                          // flags the anchors were computed with
+    long ncomputed;                      // bodies computed with the ephemeris so far
+    long nextrapolated;                  // bodies extrapolated from their anchor so far
+} ChartAnchors;
+
+void chart_anchors_init(ChartAnchors *a);
+int update_chart(ChartAnchors *a, double tjd_ut, int iflags, double tolerance, PlanetData *chart);
+int frames_main(int argc, char **argv);
+
+#endif
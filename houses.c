@@ -0,0 +1,381 @@
+#include "houses.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * House cusps
+ *
+ * The cusps of a tropical chart depend on the time only through the sidereal time and the obliquity of the
+ * ecliptic. Both are computed once per timestamp and the cusps of every observer are then derived from the ARMC
+ * with swe_houses_armc_ex2(), which is what swe_houses_ex2() does internally for a single observer. Sidereal charts
+ * go through swe_houses_ex2(), which applies the ayanamsa to the cusps.
+ */
+
+// Sidereal time and obliquity shared by all observers of one timestamp
+typedef struct {
+    double tjd_ut;
+    double eps;       // true obliquity, degrees
+    double sidtime;   // Greenwich apparent sidereal time, hours
+    double ayanamsa;
+} HouseFrame;
+
+/**
+ * @brief Compute the sidereal time and obliquity of a timestamp
+ *
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param frame The frame to fill
+ * @param serr The error message on failure
+ * @return int OK on success, ERR otherwise
+ */
+static int compute_frame(double tjd_ut, int iflags, HouseFrame *frame, char *serr) {
+    double x[6];
+
+    // x[0] is the true obliquity and x[2] the nutation in longitude
+    if (swe_calc_ut(tjd_ut, SE_ECL_NUT, iflags & (SEFLG_JPLEPH | SEFLG_SWIEPH | SEFLG_MOSEPH), x, serr) == ERR) {
+        return ERR;
+    }
+
+    frame->tjd_ut = tjd_ut;
+    frame->eps = x[0];
+    frame->sidtime = swe_sidtime0(tjd_ut, x[0], x[2]);
+    frame->ayanamsa = 0.0;
+    if ((iflags & SEFLG_SIDEREAL) && swe_get_ayanamsa_ex_ut(tjd_ut, iflags, &frame->ayanamsa, serr) == ERR) {
+        return ERR;
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Compute the house cusps of one observer in a precomputed frame
+ *
+ * A polar latitude where the house system is not defined makes the Swiss Ephemeris fall back to Porphyry houses;
+ * the cusps are filled, h->hsys is set to 'O' so that bodies are placed in the cusps actually computed, and ERR is
+ * returned.
+ */
+static int houses_in_frame(const HouseFrame *frame, int iflags, int hsys, double geolat, double geolon, HouseData *h,
+                           char *serr) {
+    int ret;
+
+    h->eps = frame->eps;
+    h->ayanamsa = frame->ayanamsa;
+    h->geolat = geolat;
+    h->hsys = hsys;
+
+    if (iflags & SEFLG_SIDEREAL) {
+        ret = swe_houses_ex2(frame->tjd_ut, iflags, geolat, geolon, hsys, h->cusps, h->ascmc, NULL, NULL, serr);
+    } else {
+        double armc = swe_degnorm(frame->sidtime * 15.0 + geolon);
+
+        ret = swe_houses_armc_ex2(armc, geolat, frame->eps, hsys, h->cusps, h->ascmc, NULL, NULL, serr);
+    }
+    if (ret < 0) {
+        h->hsys = 'O';
+        return ERR;
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Compute the house cusps of one observer
+ *
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param iflags The flags for the Swiss Ephemeris (SEFLG_SIDEREAL gives sidereal cusps)
+ * @param hsys The house system letter, e.g. 'P' for Placidus
+ * @param geolat The geographic latitude, degrees
+ * @param geolon The geographic longitude, degrees east
+ * @param h The house data to fill
+ * @param serr The error message on failure
+ * @return int OK on success, ERR otherwise (the cusps may still be filled, see houses_in_frame())
+ */
+int compute_houses(double tjd_ut, int iflags, int hsys, double geolat, double geolon, HouseData *h, char *serr) {
+    HouseFrame frame;
+
+    memset(h, 0, sizeof(*h));
+    if (compute_frame(tjd_ut, iflags, &frame, serr) == ERR) {
+        return ERR;
+    }
+
+    return houses_in_frame(&frame, iflags, hsys, geolat, geolon, h, serr);
+}
+
+/**
+ * @brief Compute the house cusps of a range of observers, reusing the frame while the timestamp does not change
+ *
+ * @return long The number of observers whose cusps could not be computed
+ */
+static long houses_range(const HouseInput *in, size_t begin, size_t end, int iflags, int hsys, HouseData *out) {
+    HouseFrame frame;
+    char serr[256];
+    int have_frame = 0;
+    long errors = 0;
+
+    for (size_t i = begin; i < end; i++) {
+        if (!have_frame || in[i].tjd_ut != frame.tjd_ut) {
+            have_frame = compute_frame(in[i].tjd_ut, iflags, &frame, serr) == OK;
+        }
+        if (!have_frame || houses_in_frame(&frame, iflags, hsys, in[i].geolat, in[i].geolon, &out[i], serr) == ERR) {
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+typedef struct {
+    const HouseInput *in;
+    int iflags;
+    int hsys;
+    HouseData *out;
+    long *errors; // one counter per worker
+} HousesCtx;
+
+static void houses_task(void *ctx, size_t begin, size_t end, int worker) {
+    HousesCtx *c = (HousesCtx *)ctx;
+
+    c->errors[worker] += houses_range(c->in, begin, end, c->iflags, c->hsys, c->out);
+}
+
+/**
+ * @brief Compute the house cusps of many observers
+ *
+ * The sidereal time and obliquity are computed once per run of consecutive inputs sharing a timestamp, so inputs
+ * should be ordered by time (e.g. all locations of an observer grid for one instant, then the next instant).
+ *
+ * @param in The observers
+ * @param n The number of observers
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param hsys The house system letter
+ * @param out The n house data structures to fill
+ * @param pool The pool to spread the observers over, or NULL for the calling thread
+ * @return long The number of observers whose cusps could not be computed, or fell back to Porphyry houses
+ */
+long compute_houses_batch(const HouseInput *in, size_t n, int iflags, int hsys, HouseData *out, ThreadPool *pool) {
+    long errors = 0;
+
+    if (pool != NULL) {
+        HousesCtx ctx = {in, iflags, hsys, out, NULL};
+
+        ctx.errors = (long *)calloc(pool_size(pool), sizeof(long));
+        if (ctx.errors != NULL) {
+            pool_run(pool, n, 0, houses_task, &ctx);
+            for (int w = 0; w < pool_size(pool); w++) {
+                errors += ctx.errors[w];
+            }
+            free(ctx.errors);
+            return errors;
+        }
+    }
+
+    return houses_range(in, 0, n, iflags, hsys, out);
+}
+
+/**
+ * @brief Get the house a point of the ecliptic falls in
+ *
+ * @param h The house data
+ * @param lon The ecliptic longitude, in the frame of the chart (sidereal if the cusps are)
+ * @param lat The ecliptic latitude
+ * @return int The house number, 0 for the first house, or -1 on failure
+ */
+int house_position(const HouseData *h, double lon, double lat) {
+    double xpin[2] = {swe_degnorm(lon + h->ayanamsa), lat};
+    char serr[256];
+    double pos = swe_house_pos(h->ascmc[SE_ARMC], h->geolat, h->eps, h->hsys, xpin, serr);
+
+    // swe_house_pos() returns 1.0 up to 12.999..., and 0 on failure
+    if (pos < 1.0) {
+        return -1;
+    }
+
+    return (int)pos > 12 ? 11 : (int)pos - 1;
+}
+
+/**
+ * @brief Tell whether positions computed with the flags can be placed in houses
+ *
+ * House positions take geocentric (or topocentric) ecliptic longitudes and latitudes of date, in degrees.
+ *
+ * @param iflags The flags for the Swiss Ephemeris
+ * @return int Non-zero if the positions are ecliptic longitudes and latitudes seen from the Earth
+ */
+int houses_can_place(int iflags) {
+    return !(iflags & (SEFLG_HELCTR | SEFLG_BARYCTR | SEFLG_EQUATORIAL | SEFLG_XYZ | SEFLG_RADIANS | SEFLG_J2000 |
+                       SEFLG_ICRS));
+}
+
+/**
+ * @brief Set the house of every body of a chart from the cusps of an observer
+ *
+ * Bodies whose calculation failed and bodies that cannot be placed get HOUSE_UNKNOWN.
+ *
+ * @param h The house data
+ * @param chart The planet data of the chart
+ * @param n The number of entries in chart
+ */
+void place_in_houses(const HouseData *h, PlanetData *chart, int n) {
+    for (int i = 0; i < n; i++) {
+        int house = chart[i].body >= 0 ? house_position(h, chart[i].pos, chart[i].lat) : -1;
+
+        chart[i].house = house >= 0 ? (unsigned char)house : HOUSE_UNKNOWN;
+    }
+}
+
+/**
+ * @brief Mark every body of a chart as not placed in houses
+ *
+ * @param chart The planet data of the chart
+ * @param n The number of entries in chart
+ */
+void mark_houses_unknown(PlanetData *chart, int n) {
+    for (int i = 0; i < n; i++) {
+        chart[i].house = HOUSE_UNKNOWN;
+    }
+}
+
+/**
+ * @brief Print the cusps of one observer on one line: jd lat lon asc mc cusp1 ... cusp12
+ */
+static void print_houses_line(const HouseInput *in, const HouseData *h) {
+    printf("%.6f %.4f %.4f %.6f %.6f", in->tjd_ut, in->geolat, in->geolon, h->ascmc[SE_ASC], h->ascmc[SE_MC]);
+    for (int i = 1; i <= 12; i++) {
+        printf(" %.6f", h->cusps[i]);
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Grid sub-mode: main houses grid <jd0> <jd1> <jd_step> <lat0> <lat1> <lon0> <lon1> <deg_step> [options]
+ */
+static int houses_grid(int argc, char **argv, int iflags, int hsys, int nthreads) {
+    static char outbuf[1 << 16];
+    double jd0 = atof(argv[1]), jd1 = atof(argv[2]), jd_step = atof(argv[3]);
+    double lat0 = atof(argv[4]), lat1 = atof(argv[5]), lon0 = atof(argv[6]), lon1 = atof(argv[7]);
+    double step = atof(argv[8]);
+    size_t ntimes, nlats, nlons, n, k = 0;
+    HouseInput *in;
+    HouseData *out;
+    ThreadPool *pool = NULL;
+    long errors;
+
+    (void)argc;
+
+    if (jd_step <= 0 || step <= 0 || jd1 < jd0 || lat1 < lat0 || lon1 < lon0) {
+        fprintf(stderr, "Error: invalid grid\n");
+        return 1;
+    }
+    ntimes = (size_t)((jd1 - jd0) / jd_step) + 1;
+    nlats = (size_t)((lat1 - lat0) / step) + 1;
+    nlons = (size_t)((lon1 - lon0) / step) + 1;
+    n = ntimes * nlats * nlons;
+
+    in = (HouseInput *)malloc(n * sizeof(HouseInput));
+    out = (HouseData *)malloc(n * sizeof(HouseData));
+    if (in == NULL || out == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(in);
+        free(out);
+        return 1;
+    }
+
+    // Time-major order, so that every location of an instant shares its sidereal time and obliquity
+    for (size_t t = 0; t < ntimes; t++) {
+        for (size_t a = 0; a < nlats; a++) {
+            for (size_t o = 0; o < nlons; o++) {
+                in[k].tjd_ut = jd0 + t * jd_step;
+                in[k].geolat = lat0 + a * step;
+                in[k].geolon = lon0 + o * step;
+                k++;
+            }
+        }
+    }
+
+    if (nthreads != 1) {
+        pool = pool_create(nthreads, NULL);
+    }
+    errors = compute_houses_batch(in, n, iflags, hsys, out, pool);
+    pool_destroy(pool);
+
+    setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+    for (k = 0; k < n; k++) {
+        print_houses_line(&in[k], &out[k]);
+    }
+    fflush(stdout);
+
+    if (errors > 0) {
+        fprintf(stderr, "Error: %ld observers without %c houses\n", errors, hsys);
+    }
+
+    free(in);
+    free(out);
+    swe_close();
+
+    return errors > 0 ? 1 : 0;
+}
+
+/**
+ * @brief Entry point of the houses mode
+ *
+ * main houses <jd_ut> <lat> <lon> [-H hsys] [-f iflags] prints the cusps of one observer;
+ * main houses grid <jd0> <jd1> <jd_step> <lat0> <lat1> <lon0> <lon1> <deg_step> [-H hsys] [-f iflags] [-j threads]
+ * prints one line per observer of the grid. Observers at polar latitudes get Porphyry cusps; the exit status is 1
+ * when any observer fell back or failed.
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int houses_main(int argc, char **argv) {
+    int grid = argc > 1 && strcmp(argv[1], "grid") == 0;
+    int first = grid ? 10 : 4;
+    int iflags = SEFLG_SWIEPH;
+    int hsys = DEFAULT_HOUSE_SYSTEM;
+    int nthreads = 1;
+    HouseData h;
+    char serr[256];
+    int ret = 0;
+
+    if (argc < first) {
+        fprintf(stderr, "Usage: main houses <jd_ut> <lat> <lon> [-H hsys] [-f iflags]\n"
+                        "       main houses grid <jd0> <jd1> <jd_step> <lat0> <lat1> <lon0> <lon1> <deg_step> "
+                        "[-H hsys] [-f iflags] [-j threads]\n");
+        return 1;
+    }
+    for (int i = first; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-H") == 0) {
+            hsys = argv[i + 1][0];
+        } else if (strcmp(argv[i], "-f") == 0) {
+            iflags = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            nthreads = atoi(argv[i + 1]);
+        }
+    }
+    if (hsys == 'G') {
+        fprintf(stderr, "Error: Gauquelin sectors are not houses\n");
+        return 1;
+    }
+
+    if (grid) {
+        return houses_grid(argc - 1, argv + 1, iflags, hsys, nthreads);
+    }
+
+    if (compute_houses(atof(argv[1]), iflags, hsys, atof(argv[2]), atof(argv[3]), &h, serr) == ERR) {
+        fprintf(stderr, "Error: %s\n", serr);
+        ret = 1;
+    }
+
+    // Fallback cusps are printed under the name of the system they were computed with; a failed frame has none
+    if (h.hsys != 0) {
+        printf("%s houses for Julian Day %.15f\n\n", swe_house_name(h.hsys), atof(argv[1]));
+        for (int i = 1; i <= 12; i++) {
+            printf("%s: %.6f\n", get_house(i - 1), h.cusps[i]);
+        }
+        printf("Ascendant: %.6f\nMidheaven: %.6f\n", h.ascmc[SE_ASC], h.ascmc[SE_MC]);
+    }
+    swe_close();
+
+    return ret;
+}
@@ -0,0 +1,36 @@
+#ifndef HOUSES_H
+#define HOUSES_H
+
+#include "planet.h"
+#include "pool.h"
+#include <stddef.h>
+
+#define DEFAULT_HOUSE_SYSTEM 'P'
+
+// One observer of a batched house computation
+typedef struct {
+    double tjd_ut;
+    double geolat;
+    double geolon;
+} HouseInput;
+
+// House cusps of one observer, with what swe_house_pos() needs to place bodies in them
+typedef struct {
+    double cusps[13];  // cusps[1] to cusps[12], in the Swiss Ephemeris layout; cusps[0] is unused
+    double ascmc[10];  // SE_ASC, SE_MC, SE_ARMC, SE_VERTEX, ...
+    double eps;        // true obliquity of the ecliptic
+    double ayanamsa;   // added to sidereal longitudes before placing them, 0 for tropical charts
+    double geolat;
+    int hsys;
+} HouseData;
+
+int compute_houses(double tjd_ut, int iflags, int hsys, double geolat, double geolon, HouseData *h, char *serr);
+long compute_houses_batch(const HouseInput *in, size_t n, int iflags, int hsys, HouseData *out, ThreadPool *pool);
+int house_position(const HouseData *h, double lon, double lat);
+int houses_can_place(int iflags);
+void place_in_houses(const HouseData *h, PlanetData *chart, int n);
+void mark_houses_unknown(PlanetData *chart, int n);
+
+int houses_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,352 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ingest.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Birth record ingest
+ *
+ * Fields are separated by blanks, by a comma or semicolon (optionally surrounded by blanks), or by a tab, so the
+ * same parser reads the original whitespace format as well as CSV and TSV exports; the date and the time may also
+ * be joined by 'T'. Numbers are converted without strtod(): a decimal with at most 15 significant digits is read
+ * into an integer and divided by an exact power of ten, which is a single correctly rounded operation and gives
+ * the same double as strtod(). Longer numbers and exponents are copied to a small buffer and passed to strtod().
+ */
+
+// Powers of ten that are exact in a double
+static const double pow10_exact[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+#define FAST_DIGITS 15
+
+static int is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static int is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+/**
+ * @brief Skip one field separator
+ *
+ * @return int OK if a separator was skipped, ERR if none was found
+ */
+static int skip_separator(const char **pp, const char *end) {
+    const char *p = *pp;
+
+    while (p < end && is_blank(*p)) {
+        p++;
+    }
+    if (p < end && (*p == ',' || *p == ';')) {
+        p++;
+        while (p < end && is_blank(*p)) {
+            p++;
+        }
+    }
+    if (p == *pp) {
+        return ERR;
+    }
+    *pp = p;
+
+    return OK;
+}
+
+/**
+ * @brief Parse an optionally signed decimal integer
+ */
+static int parse_int(const char **pp, const char *end, int *v) {
+    const char *p = *pp;
+    int neg = 0;
+    long x = 0;
+
+    if (p < end && (*p == '+' || *p == '-')) {
+        neg = *p == '-';
+        p++;
+    }
+    if (p == end || !is_digit(*p)) {
+        return ERR;
+    }
+    while (p < end && is_digit(*p)) {
+        if (x < 100000000) {
+            x = x * 10 + (*p - '0');
+        }
+        p++;
+    }
+    *v = (int)(neg ? -x : x);
+    *pp = p;
+
+    return OK;
+}
+
+/**
+ * @brief Parse a decimal number, "[+-]digits[.digits][e[+-]digits]"
+ */
+static int parse_number(const char **pp, const char *end, double *x) {
+    const char *p = *pp, *start;
+    uint64_t mant = 0;
+    int neg = 0, digits = 0, frac = 0, exact = 1;
+
+    if (p < end && (*p == '+' || *p == '-')) {
+        neg = *p == '-';
+        p++;
+    }
+    start = p;
+    while (p < end && is_digit(*p) && exact) {
+        mant = mant * 10 + (uint64_t)(*p++ - '0');
+        digits += digits > 0 || mant > 0;
+        exact = digits <= FAST_DIGITS;
+    }
+    if (p < end && *p == '.' && exact) {
+        p++;
+        while (p < end && is_digit(*p) && exact) {
+            mant = mant * 10 + (uint64_t)(*p++ - '0');
+            digits += digits > 0 || mant > 0;
+            exact = digits <= FAST_DIGITS && ++frac <= 22;
+        }
+    }
+    if (p == start || (p == start + 1 && *start == '.')) {
+        return ERR;
+    }
+
+    // Too many digits or an exponent: hand a copy of the token to strtod()
+    if (!exact || (p < end && (*p == 'e' || *p == 'E' || is_digit(*p) || *p == '.'))) {
+        char buf[64];
+        char *stop;
+        size_t n = 0;
+
+        p = *pp;
+        while (p < end && n + 1 < sizeof(buf) &&
+               (is_digit(*p) || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-')) {
+            buf[n++] = *p++;
+        }
+        buf[n] = '\0';
+        *x = strtod(buf, &stop);
+        if (stop == buf) {
+            return ERR;
+        }
+        *pp += stop - buf;
+        return OK;
+    }
+
+    *x = (double)mant / pow10_exact[frac];
+    if (neg) {
+        *x = -*x;
+    }
+    *pp = p;
+
+    return OK;
+}
+
+/**
+ * @brief Parse a UTC offset given either as decimal hours ("+5.5") or as "+HH:MM"
+ */
+static int parse_tz(const char **pp, const char *end, double *tz) {
+    const char *p = *pp;
+    int hh, mm;
+
+    if (parse_int(&p, end, &hh) == OK && p < end && *p == ':') {
+        p++;
+        if (parse_int(&p, end, &mm) == ERR) {
+            return ERR;
+        }
+        *tz = hh + (**pp == '-' ? -1.0 : 1.0) * mm / 60.0;
+        *pp = p;
+        return OK;
+    }
+
+    return parse_number(pp, end, tz);
+}
+
+/**
+ * @brief Parse one birth record in place
+ *
+ * The record is "YYYY-MM-DD HH:MM[:SS] TZ LAT LON [IFLAGS]", where TZ is the UTC offset in hours ("+1", "-5.5")
+ * or as "+HH:MM", and LAT/LON are decimal degrees (north and east positive). See the top of this file for the
+ * accepted separators.
+ *
+ * @param p The start of the record
+ * @param end The end of the record; a trailing newline is allowed
+ * @param default_iflags The flags used when the record does not carry its own
+ * @param rec The parsed record
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR on malformed input
+ */
+int parse_birth_fields(const char *p, const char *end, int default_iflags, BirthRecord *rec, char *serr) {
+    const char *tz;
+
+    memset(rec, 0, sizeof(*rec));
+    rec->iflags = default_iflags;
+
+    if (parse_int(&p, end, &rec->year) == ERR || p == end || *p++ != '-' ||
+        parse_int(&p, end, &rec->month) == ERR || p == end || *p++ != '-' || parse_int(&p, end, &rec->day) == ERR) {
+        strcpy(serr, "expected date and time as YYYY-MM-DD HH:MM[:SS]");
+        return ERR;
+    }
+    if (p < end && *p == 'T') {
+        p++;
+    } else if (skip_separator(&p, end) == ERR) {
+        p = end;
+    }
+    if (parse_int(&p, end, &rec->hour) == ERR || p == end || *p++ != ':' || parse_int(&p, end, &rec->min) == ERR) {
+        strcpy(serr, "expected date and time as YYYY-MM-DD HH:MM[:SS]");
+        return ERR;
+    }
+
+    // Seconds are optional
+    if (p < end && *p == ':') {
+        p++;
+        if (parse_number(&p, end, &rec->sec) == ERR) {
+            strcpy(serr, "malformed seconds");
+            return ERR;
+        }
+    }
+
+    if (skip_separator(&p, end) == ERR) {
+        strcpy(serr, "expected time zone, latitude and longitude");
+        return ERR;
+    }
+    tz = p;
+    if (parse_tz(&p, end, &rec->tz) == ERR || (p < end && !is_blank(*p) && *p != ',' && *p != ';' && *p != '\n')) {
+        const char *q = tz;
+
+        while (q < end && !is_blank(*q) && *q != ',' && *q != ';' && *q != '\n') {
+            q++;
+        }
+        sprintf(serr, "malformed time zone '%.*s'", (int)(q - tz < 32 ? q - tz : 32), tz);
+        return ERR;
+    }
+    if (skip_separator(&p, end) == ERR || parse_number(&p, end, &rec->lat) == ERR ||
+        skip_separator(&p, end) == ERR || parse_number(&p, end, &rec->lon) == ERR) {
+        strcpy(serr, "expected time zone, latitude and longitude");
+        return ERR;
+    }
+
+    // Flags are optional, anything else left on the record is an error
+    if (skip_separator(&p, end) == OK && p < end && (is_digit(*p) || *p == '-' || *p == '+')) {
+        parse_int(&p, end, &rec->iflags);
+    }
+    while (p < end && (is_blank(*p) || *p == '\n')) {
+        p++;
+    }
+    if (p < end) {
+        sprintf(serr, "unexpected trailing data '%.*s'", (int)(end - p < 32 ? end - p : 32), p);
+        return ERR;
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Map a whole input file read-only
+ *
+ * @param path The file path
+ * @param in The mapping; an empty file gives an empty mapping
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR otherwise
+ */
+int ingest_map(const char *path, MappedInput *in, char *serr) {
+    struct stat st;
+    void *map;
+    int fd = open(path, O_RDONLY);
+
+    in->data = NULL;
+    in->size = 0;
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        sprintf(serr, "cannot open %.200s", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return ERR;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        sprintf(serr, "%.200s is not a regular file", path);
+        close(fd);
+        return ERR;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return OK;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        sprintf(serr, "cannot map %.200s", path);
+        return ERR;
+    }
+    posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    in->data = (const char *)map;
+    in->size = (size_t)st.st_size;
+
+    return OK;
+}
+
+/**
+ * @brief Unmap an input file
+ *
+ * @param in The mapping
+ */
+void ingest_unmap(MappedInput *in) {
+    if (in->data != NULL) {
+        munmap((void *)in->data, in->size);
+    }
+    in->data = NULL;
+    in->size = 0;
+}
+
+/**
+ * @brief Tell the kernel that a parsed range of the mapping will not be read again
+ *
+ * Only whole pages inside the range are released, so the neighbouring ranges are not affected.
+ *
+ * @param in The mapping
+ * @param begin The start of the range
+ * @param end The end of the range
+ */
+void ingest_release(const MappedInput *in, size_t begin, size_t end) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t first = (begin + page - 1) / page * page;
+    size_t last = end / page * page;
+
+    if (in->data != NULL && last > first) {
+        posix_madvise((void *)(in->data + first), last - first, POSIX_MADV_DONTNEED);
+    }
+}
+
+/**
+ * @brief Split a range into pieces that end at line boundaries
+ *
+ * Each cut is moved forward past the next newline, so no line straddles two pieces; pieces that would be empty
+ * are dropped.
+ *
+ * @param data The range
+ * @param size The size of the range
+ * @param nchunks The wanted number of pieces, at least 1
+ * @param bounds The offsets of the pieces: piece i is [bounds[i], bounds[i + 1]) (nchunks + 1 entries)
+ * @return size_t The number of pieces
+ */
+size_t ingest_split(const char *data, size_t size, size_t nchunks, size_t *bounds) {
+    size_t n = 0;
+
+    bounds[0] = 0;
+    for (size_t i = 1; i <= nchunks && bounds[n] < size; i++) {
+        // size * i / nchunks without overflow; the last cut is always size, so the pieces cover the whole range
+        size_t cut = size / nchunks * i + size % nchunks * i / nchunks;
+        const char *nl;
+
+        if (cut <= bounds[n]) {
+            continue;
+        }
+        nl = i == nchunks ? NULL : (const char *)memchr(data + cut, '\n', size - cut);
+        bounds[++n] = nl != NULL ? (size_t)(nl - data) + 1 : size;
+    }
+
+    return n;
+}
@@ -0,0 +1,30 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include "batch.h"
+#include <stddef.h>
+
+/*
+ * Zero-copy ingest of birth record files
+ *
+ * The file is mapped read-only and parsed where it lies: records are never copied into line buffers and the
+ * parser works on [begin, end) ranges instead of NUL-terminated strings. ingest_split() cuts a range at line
+ * boundaries so that the pieces can be parsed on separate threads.
+ */
+
+// Bytes of the mapping parsed per round by run_batch_mapped(); bounds the memory held by parsed records
+#define INGEST_WINDOW (64u << 20)
+#define INGEST_MAX_CHUNKS 256
+
+typedef struct {
+    const char *data;
+    size_t size;
+} MappedInput;
+
+int ingest_map(const char *path, MappedInput *in, char *serr);
+void ingest_unmap(MappedInput *in);
+void ingest_release(const MappedInput *in, size_t begin, size_t end);
+size_t ingest_split(const char *data, size_t size, size_t nchunks, size_t *bounds);
+int parse_birth_fields(const char *p, const char *end, int default_iflags, BirthRecord *rec, char *serr);
+
+#endif
@@ -0,0 +1,202 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "instr.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Instrumentation
+ *
+ * Every stage has a call counter, a total time and a log-linear latency histogram in the style of HdrHistogram:
+ * values below 16 ns get a bucket each, and every power of two above is split into 16 buckets, so a bucket is
+ * within 6.25% of any value it holds. Each thread records into its own shard, registered on first use, so the hot
+ * path takes no lock; a dump sums the shards.
+ *
+ * SIGUSR1 asks for a dump, which is printed by the next instr_poll() since printing is not safe in a signal handler.
+ */
+
+#define INSTR_SUB_BITS 4
+#define INSTR_SUB_BUCKETS (1 << INSTR_SUB_BITS)
+#define INSTR_MAX_EXP 40 // 2^40 ns, about 18 minutes; longer durations go to the last bucket
+#define INSTR_BUCKETS ((INSTR_MAX_EXP - INSTR_SUB_BITS + 2) * INSTR_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[INSTR_BUCKETS];
+} StageHistogram;
+
+typedef struct InstrShard {
+    StageHistogram stages[NUM_STAGES];
+    struct InstrShard *next;
+} InstrShard;
+
+static const char *const stage_names[NUM_STAGES] = {"time_conv", "calc", "classify", "houses", "output"};
+
+int instr_enabled = 0;
+
+static pthread_mutex_t shards_lock = PTHREAD_MUTEX_INITIALIZER;
+static InstrShard *shards = NULL;
+static __thread InstrShard *my_shard = NULL;
+static volatile sig_atomic_t dump_requested = 0;
+
+static void on_dump_signal(int sig) {
+    (void)sig;
+    dump_requested = 1;
+}
+
+/**
+ * @brief Get a monotonic time stamp
+ *
+ * @return uint64_t The time in nanoseconds
+ */
+uint64_t instr_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int bucket_index(uint64_t v) {
+    int e;
+
+    if (v < INSTR_SUB_BUCKETS) {
+        return (int)v;
+    }
+    e = 63 - __builtin_clzll(v);
+    if (e > INSTR_MAX_EXP) {
+        return INSTR_BUCKETS - 1;
+    }
+
+    return (e - INSTR_SUB_BITS + 1) * INSTR_SUB_BUCKETS + (int)((v >> (e - INSTR_SUB_BITS)) & (INSTR_SUB_BUCKETS - 1));
+}
+
+// Lowest value of a bucket
+static uint64_t bucket_value(int i) {
+    int e = i / INSTR_SUB_BUCKETS + INSTR_SUB_BITS - 1;
+
+    if (i < INSTR_SUB_BUCKETS) {
+        return (uint64_t)i;
+    }
+
+    return ((uint64_t)INSTR_SUB_BUCKETS + (uint64_t)(i % INSTR_SUB_BUCKETS)) << (e - INSTR_SUB_BITS);
+}
+
+// Only the owning thread writes a shard; relaxed stores keep concurrent dumps free of torn values
+static void shard_add(uint64_t *x, uint64_t v) {
+    __atomic_store_n(x, __atomic_load_n(x, __ATOMIC_RELAXED) + v, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Record the duration of one stage on the calling thread
+ *
+ * @param stage The stage
+ * @param ns The duration in nanoseconds
+ */
+void instr_record(Stage stage, uint64_t ns) {
+    StageHistogram *h;
+
+    if (my_shard == NULL) {
+        my_shard = (InstrShard *)calloc(1, sizeof(InstrShard));
+        if (my_shard == NULL) {
+            return;
+        }
+        pthread_mutex_lock(&shards_lock);
+        my_shard->next = shards;
+        shards = my_shard;
+        pthread_mutex_unlock(&shards_lock);
+    }
+
+    h = &my_shard->stages[stage];
+    shard_add(&h->count, 1);
+    shard_add(&h->total_ns, ns);
+    shard_add(&h->buckets[bucket_index(ns)], 1);
+    if (ns > __atomic_load_n(&h->max_ns, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&h->max_ns, ns, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Turn the instrumentation on, and dump it on SIGUSR1 (see instr_poll())
+ */
+void instr_enable(void) {
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_dump_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+
+    instr_enabled = 1;
+}
+
+/**
+ * @brief Dump the instrumentation if SIGUSR1 was received since the last call
+ *
+ * @param f The output stream
+ */
+void instr_poll(FILE *f) {
+    if (dump_requested) {
+        dump_requested = 0;
+        instr_dump(f);
+    }
+}
+
+static double percentile(const uint64_t *buckets, uint64_t count, double q) {
+    uint64_t rank = (uint64_t)(q * (count - 1)) + 1;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < INSTR_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return (double)bucket_value(i);
+        }
+    }
+
+    return 0.0;
+}
+
+/**
+ * @brief Print the cumulative counters and latency percentiles of every stage, in microseconds
+ *
+ * @param f The output stream
+ */
+void instr_dump(FILE *f) {
+    static uint64_t buckets[INSTR_BUCKETS];
+
+    fprintf(f, "%-10s %12s %12s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "total_ms", "mean_us", "p50_us",
+            "p90_us", "p99_us", "p999_us", "max_us");
+
+    pthread_mutex_lock(&shards_lock);
+    for (int s = 0; s < NUM_STAGES; s++) {
+        uint64_t count = 0, total = 0, max = 0;
+
+        memset(buckets, 0, sizeof(buckets));
+        for (const InstrShard *sh = shards; sh != NULL; sh = sh->next) {
+            const StageHistogram *h = &sh->stages[s];
+            uint64_t m = __atomic_load_n(&h->max_ns, __ATOMIC_RELAXED);
+
+            count += __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+            total += __atomic_load_n(&h->total_ns, __ATOMIC_RELAXED);
+            max = m > max ? m : max;
+            for (int i = 0; i < INSTR_BUCKETS; i++) {
+                buckets[i] += __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+            }
+        }
+        if (count == 0) {
+            continue;
+        }
+
+        fprintf(f, "%-10s %12llu %12.3f %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", stage_names[s],
+                (unsigned long long)count, total * 1e-6, total * 1e-3 / count, percentile(buckets, count, 0.5) * 1e-3,
+                percentile(buckets, count, 0.9) * 1e-3, percentile(buckets, count, 0.99) * 1e-3,
+                percentile(buckets, count, 0.999) * 1e-3, max * 1e-3);
+    }
+    pthread_mutex_unlock(&shards_lock);
+    fflush(f);
+}
@@ -0,0 +1,44 @@
+#ifndef INSTR_H
+#define INSTR_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Stages of producing a chart
+typedef enum {
+    STAGE_TIME_CONV, // civil time to Julian Day
+    STAGE_CALC,      // one body position, from whichever source answers it
+    STAGE_CLASSIFY,  // sign, element, quality of one body
+    STAGE_HOUSES,    // cusps and house placement of one chart
+    STAGE_OUTPUT,    // formatting of one chart
+    NUM_STAGES
+} Stage;
+
+extern int instr_enabled;
+
+uint64_t instr_now(void);
+void instr_record(Stage stage, uint64_t ns);
+void instr_enable(void);
+void instr_poll(FILE *f);
+void instr_dump(FILE *f);
+
+/**
+ * @brief Start timing a stage; costs a single test while the instrumentation is off
+ *
+ * @return uint64_t The start time, to pass to instr_stop()
+ */
+static inline uint64_t instr_start(void) { return instr_enabled ? instr_now() : 0; }
+
+/**
+ * @brief Stop timing a stage and record its duration
+ *
+ * @param stage The stage
+ * @param t0 The value returned by instr_start()
+ */
+static inline void instr_stop(Stage stage, uint64_t t0) {
+    if (instr_enabled) {
+        instr_record(stage, instr_now() - t0);
+    }
+}
+
+#endif
@@ -0,0 +1,467 @@
+#include "output.h"
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Output writer
+ *
+ * Charts are formatted straight into one large buffer that is handed to write(2) when full. Doubles go through a
+ * fixed-precision formatter that scales the exact binary value by a power of ten in 128-bit integer arithmetic and
+ * rounds half to even, so it prints the same digits as printf("%.*f") without parsing a format string. Values it
+ * cannot handle exactly (huge, NaN, infinite) fall back to snprintf.
+ */
+
+// Room for any double printed with %.17f
+#define WRITER_MAX_NUMBER 352
+
+static const uint64_t pow10_table[18] = {1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+                                         100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+                                         10000000000000ULL, 100000000000000ULL, 1000000000000000ULL,
+                                         10000000000000000ULL, 100000000000000000ULL};
+
+// Body names are looked up once; output is only written from one thread
+static char body_names[NUM_CHART_BODIES][AS_MAXCH];
+static int body_names_ready = 0;
+
+/**
+ * @brief Start a writer on a file descriptor
+ *
+ * @param w The writer
+ * @param fd The file descriptor, which stays owned by the caller
+ * @param cap The buffer size (0 for WRITER_DEFAULT_SIZE)
+ * @return int OK on success, ERR if out of memory
+ */
+int writer_open(Writer *w, int fd, size_t cap) {
+    w->fd = fd;
+    w->len = 0;
+    w->error = 0;
+    w->cap = cap > 4 * WRITER_MAX_NUMBER ? cap : WRITER_DEFAULT_SIZE;
+    w->buf = (char *)malloc(w->cap);
+
+    return w->buf != NULL ? OK : ERR;
+}
+
+/**
+ * @brief Write out the buffer
+ *
+ * @param w The writer
+ * @return int OK, or ERR if this or an earlier write failed
+ */
+int writer_flush(Writer *w) {
+    size_t done = 0;
+
+    while (!w->error && done < w->len) {
+        ssize_t n = write(w->fd, w->buf + done, w->len - done);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            w->error = 1;
+        } else {
+            done += (size_t)n;
+        }
+    }
+    w->len = 0;
+
+    return w->error ? ERR : OK;
+}
+
+/**
+ * @brief Flush a writer and release its buffer
+ *
+ * @param w The writer
+ * @return int OK, or ERR if a write failed
+ */
+int writer_close(Writer *w) {
+    int ret = writer_flush(w);
+
+    free(w->buf);
+    w->buf = NULL;
+
+    return ret;
+}
+
+static void writer_reserve(Writer *w, size_t n) {
+    if (w->cap - w->len < n) {
+        writer_flush(w);
+    }
+}
+
+void writer_bytes(Writer *w, const char *s, size_t n) {
+    if (n > w->cap - w->len) {
+        writer_flush(w);
+        if (n > w->cap) {
+            // Too large to buffer: write it through
+            Writer direct = {w->fd, (char *)s, n, n, w->error};
+
+            writer_flush(&direct);
+            w->error = direct.error;
+            return;
+        }
+    }
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+void writer_str(Writer *w, const char *s) { writer_bytes(w, s, strlen(s)); }
+
+void writer_char(Writer *w, char c) {
+    writer_reserve(w, 1);
+    w->buf[w->len++] = c;
+}
+
+// Digits of v at dst, returns their count
+static int format_u64(char *dst, uint64_t v) {
+    char tmp[20];
+    int n = 0;
+
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    for (int i = 0; i < n; i++) {
+        dst[i] = tmp[n - 1 - i];
+    }
+
+    return n;
+}
+
+void writer_long(Writer *w, long v) {
+    writer_reserve(w, 21);
+    if (v < 0) {
+        w->buf[w->len++] = '-';
+        w->len += format_u64(w->buf + w->len, 0 - (uint64_t)v);
+    } else {
+        w->len += format_u64(w->buf + w->len, (uint64_t)v);
+    }
+}
+
+/**
+ * @brief Format x like printf("%.*f", decimals, x)
+ *
+ * @param dst The destination, at least WRITER_MAX_NUMBER bytes
+ * @return int The number of characters written
+ */
+static int format_fixed(char *dst, double x, int decimals) {
+#ifdef __SIZEOF_INT128__
+    uint64_t bits, mant, q;
+    unsigned __int128 prod;
+    int exp, n = 0;
+
+    if (decimals >= 0 && decimals <= 17 && isfinite(x) && fabs(x) < 9.2e18 / pow10_table[decimals]) {
+        // x = mant * 2^exp exactly
+        memcpy(&bits, &x, sizeof(bits));
+        mant = bits & ((1ULL << 52) - 1);
+        exp = (int)((bits >> 52) & 0x7ff);
+        if (exp == 0) {
+            exp = 1;
+        } else {
+            mant |= 1ULL << 52;
+        }
+        exp -= 1075;
+
+        // q = x * 10^decimals, rounded half to even; prod < 2^110, so a shift of more than 111 bits leaves 0
+        prod = (unsigned __int128)mant * pow10_table[decimals];
+        if (exp >= 0) {
+            q = (uint64_t)(prod << exp);
+        } else if (-exp > 111) {
+            q = 0;
+        } else {
+            unsigned __int128 rem = prod & (((unsigned __int128)1 << -exp) - 1);
+            unsigned __int128 half = (unsigned __int128)1 << (-exp - 1);
+
+            q = (uint64_t)(prod >> -exp);
+            if (rem > half || (rem == half && (q & 1))) {
+                q++;
+            }
+        }
+
+        // printf keeps the sign of values that round to zero
+        if (signbit(x)) {
+            dst[n++] = '-';
+        }
+        n += format_u64(dst + n, q / pow10_table[decimals]);
+        if (decimals > 0) {
+            uint64_t frac = q % pow10_table[decimals];
+
+            dst[n++] = '.';
+            for (int i = decimals - 1; i >= 0; i--) {
+                dst[n + i] = (char)('0' + frac % 10);
+                frac /= 10;
+            }
+            n += decimals;
+        }
+
+        return n;
+    }
+#endif
+
+    return snprintf(dst, WRITER_MAX_NUMBER, "%.*f", decimals, x);
+}
+
+/**
+ * @brief Write a double with a fixed number of decimals, exactly as printf("%.*f") would
+ *
+ * @param w The writer
+ * @param x The value
+ * @param decimals The number of decimals
+ */
+void writer_fixed(Writer *w, double x, int decimals) {
+    writer_reserve(w, WRITER_MAX_NUMBER);
+    w->len += format_fixed(w->buf + w->len, x, decimals);
+}
+
+/**
+ * @brief Write the shortest form of a double rounded to a number of decimals (trailing zeros removed)
+ *
+ * @param w The writer
+ * @param x The value
+ * @param decimals The maximum number of decimals
+ */
+void writer_trimmed(Writer *w, double x, int decimals) {
+    char *start;
+    int n;
+
+    writer_reserve(w, WRITER_MAX_NUMBER);
+    start = w->buf + w->len;
+    n = format_fixed(start, x, decimals);
+    if (decimals > 0 && memchr(start, '.', n) != NULL) {
+        while (start[n - 1] == '0') {
+            n--;
+        }
+        if (start[n - 1] == '.') {
+            n--;
+        }
+    }
+    w->len += n;
+}
+
+/**
+ * @brief Parse an output format name: text, csv or jsonl
+ *
+ * @return int OK on success, ERR for an unknown name
+ */
+int parse_output_format(const char *s, OutputFormat *fmt) {
+    if (strcmp(s, "text") == 0) {
+        *fmt = OUTPUT_TEXT;
+    } else if (strcmp(s, "csv") == 0) {
+        *fmt = OUTPUT_CSV;
+    } else if (strcmp(s, "jsonl") == 0) {
+        *fmt = OUTPUT_JSONL;
+    } else {
+        return ERR;
+    }
+
+    return OK;
+}
+
+static const char *body_name(int body) {
+    if (!body_names_ready) {
+        for (int i = 0; i < NUM_CHART_BODIES; i++) {
+            swe_get_planet_name(i, body_names[i]);
+        }
+        body_names_ready = 1;
+    }
+
+    return body >= 0 && body < NUM_CHART_BODIES ? body_names[body] : "?";
+}
+
+/**
+ * @brief Write what comes before the first chart: the column names for CSV, nothing otherwise
+ *
+ * @param w The writer
+ * @param fmt The output format
+ */
+void write_output_header(Writer *w, OutputFormat fmt) {
+    if (fmt == OUTPUT_CSV) {
+        writer_str(w, "chart,jd,body,name,lon,lat,speed,sign,sign_num,element,quality,house,retrograde\n");
+    }
+}
+
+static void write_chart_text(Writer *w, long chart_num, double tjd_ut, const PlanetData *chart, int n,
+                             const Aspect *found, int nfound, const AspectDef *aspects) {
+    writer_str(w, "Chart ");
+    writer_long(w, chart_num);
+    writer_str(w, ": Planet Data for Julian Day ");
+    writer_fixed(w, tjd_ut, 15);
+    writer_str(w, "\n\n");
+
+    // Same layout as print_planet_data()
+    for (int i = 0; i < n; i++) {
+        const PlanetData *p = &chart[i];
+
+        if (p->body < 0) {
+            continue;
+        }
+        writer_str(w, "Planet Data:\nName: ");
+        writer_str(w, body_name(p->body));
+        writer_str(w, "\nQuality: ");
+        writer_str(w, get_quality_name((Quality)p->quality));
+        writer_str(w, "\nElement: ");
+        writer_str(w, get_element_name((Element)p->element));
+        writer_str(w, "\nSign: ");
+        writer_str(w, get_sign(p->sign_num));
+        writer_str(w, "\nSign Number: ");
+        writer_long(w, p->sign_num);
+        writer_str(w, "\nPosition: ");
+        writer_fixed(w, p->pos, 15);
+        writer_str(w, "\nAbsolute Position: ");
+        writer_fixed(w, p->abs_pos, 15);
+        writer_str(w, "\nEmoji: ");
+        writer_str(w, get_emoji(p->sign_num));
+        writer_str(w, "\nHouse: ");
+        writer_str(w, get_house(p->house));
+        writer_str(w, p->retrograde ? "\nRetrograde: True\n\n" : "\nRetrograde: False\n\n");
+    }
+
+    // Same layout as print_aspects()
+    if (found != NULL) {
+        writer_str(w, "Aspects:\n");
+        for (int a = 0; a < nfound; a++) {
+            writer_str(w, body_name(chart[found[a].body1].body));
+            writer_char(w, ' ');
+            writer_str(w, aspects[found[a].aspect].name);
+            writer_char(w, ' ');
+            writer_str(w, body_name(chart[found[a].body2].body));
+            writer_str(w, found[a].orb < 0 || signbit(found[a].orb) ? ", orb " : ", orb +");
+            writer_fixed(w, found[a].orb, 4);
+            writer_str(w, found[a].applying ? ", applying\n" : ", separating\n");
+        }
+        writer_char(w, '\n');
+    }
+}
+
+static void write_chart_csv(Writer *w, long chart_num, double tjd_ut, const PlanetData *chart, int n) {
+    for (int i = 0; i < n; i++) {
+        const PlanetData *p = &chart[i];
+
+        if (p->body < 0) {
+            continue;
+        }
+        writer_long(w, chart_num);
+        writer_char(w, ',');
+        writer_trimmed(w, tjd_ut, 9);
+        writer_char(w, ',');
+        writer_long(w, p->body);
+        writer_char(w, ',');
+        writer_str(w, body_name(p->body));
+        writer_char(w, ',');
+        writer_trimmed(w, p->pos, 10);
+        writer_char(w, ',');
+        writer_trimmed(w, p->lat, 10);
+        writer_char(w, ',');
+        writer_trimmed(w, p->speed, 10);
+        writer_char(w, ',');
+        writer_str(w, get_sign(p->sign_num));
+        writer_char(w, ',');
+        writer_long(w, p->sign_num);
+        writer_char(w, ',');
+        writer_str(w, get_element_name((Element)p->element));
+        writer_char(w, ',');
+        writer_str(w, get_quality_name((Quality)p->quality));
+        writer_char(w, ',');
+        if (p->house != HOUSE_UNKNOWN) {
+            writer_long(w, p->house + 1);
+        }
+        writer_str(w, p->retrograde ? ",1\n" : ",0\n");
+    }
+}
+
+static void write_chart_jsonl(Writer *w, long chart_num, double tjd_ut, const PlanetData *chart, int n,
+                              const Aspect *found, int nfound, const AspectDef *aspects) {
+    int first = 1;
+
+    writer_str(w, "{\"chart\":");
+    writer_long(w, chart_num);
+    writer_str(w, ",\"jd\":");
+    writer_trimmed(w, tjd_ut, 9);
+    writer_str(w, ",\"bodies\":[");
+    for (int i = 0; i < n; i++) {
+        const PlanetData *p = &chart[i];
+
+        if (p->body < 0) {
+            continue;
+        }
+        writer_str(w, first ? "{\"body\":" : ",{\"body\":");
+        first = 0;
+        writer_long(w, p->body);
+        writer_str(w, ",\"name\":\"");
+        writer_str(w, body_name(p->body));
+        writer_str(w, "\",\"lon\":");
+        writer_trimmed(w, p->pos, 10);
+        writer_str(w, ",\"lat\":");
+        writer_trimmed(w, p->lat, 10);
+        writer_str(w, ",\"speed\":");
+        writer_trimmed(w, p->speed, 10);
+        writer_str(w, ",\"sign\":\"");
+        writer_str(w, get_sign(p->sign_num));
+        writer_str(w, "\",\"sign_num\":");
+        writer_long(w, p->sign_num);
+        writer_str(w, ",\"element\":\"");
+        writer_str(w, get_element_name((Element)p->element));
+        writer_str(w, "\",\"quality\":\"");
+        writer_str(w, get_quality_name((Quality)p->quality));
+        writer_str(w, "\",\"house\":");
+        if (p->house == HOUSE_UNKNOWN) {
+            writer_str(w, "null");
+        } else {
+            writer_long(w, p->house + 1);
+        }
+        writer_str(w, p->retrograde ? ",\"retrograde\":true}" : ",\"retrograde\":false}");
+    }
+    writer_char(w, ']');
+
+    if (found != NULL) {
+        writer_str(w, ",\"aspects\":[");
+        for (int a = 0; a < nfound; a++) {
+            writer_str(w, a ? ",{\"body1\":" : "{\"body1\":");
+            writer_long(w, chart[found[a].body1].body);
+            writer_str(w, ",\"body2\":");
+            writer_long(w, chart[found[a].body2].body);
+            writer_str(w, ",\"aspect\":\"");
+            writer_str(w, aspects[found[a].aspect].name);
+            writer_str(w, "\",\"orb\":");
+            writer_trimmed(w, found[a].orb, 6);
+            writer_str(w, found[a].applying ? ",\"applying\":true}" : ",\"applying\":false}");
+        }
+        writer_char(w, ']');
+    }
+    writer_str(w, "}\n");
+}
+
+/**
+ * @brief Write one chart
+ *
+ * Text output has the layout of print_planet_data() and print_aspects(); CSV has one row per body (aspects are not
+ * part of it); JSON Lines has one object per chart.
+ *
+ * @param w The writer
+ * @param fmt The output format
+ * @param chart_num The chart number, counted from 1
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param chart The planet data of the chart; failed bodies are skipped
+ * @param n The number of entries in chart
+ * @param found The aspects of the chart, or NULL to leave them out
+ * @param nfound The number of aspects
+ * @param aspects The aspect set the aspects refer to
+ */
+void write_chart(Writer *w, OutputFormat fmt, long chart_num, double tjd_ut, const PlanetData *chart, int n,
+                 const Aspect *found, int nfound, const AspectDef *aspects) {
+    switch (fmt) {
+    case OUTPUT_CSV:
+        write_chart_csv(w, chart_num, tjd_ut, chart, n);
+        break;
+    case OUTPUT_JSONL:
+        write_chart_jsonl(w, chart_num, tjd_ut, chart, n, found, nfound, aspects);
+        break;
+    default:
+        write_chart_text(w, chart_num, tjd_ut, chart, n, found, nfound, aspects);
+        break;
+    }
+}
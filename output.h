@@ -0,0 +1,36 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "aspects.h"
+#include "planet.h"
+#include <stddef.h>
+
+#define WRITER_DEFAULT_SIZE (1 << 20)
+
+typedef enum { OUTPUT_TEXT, OUTPUT_CSV, OUTPUT_JSONL } OutputFormat;
+
+// Buffered writer on a file descriptor, emptied with write(2) when full
+typedef struct {
+    int fd;
+    char *buf;
+    size_t len;
+    size_t cap;
+    int error; // non-zero once a write failed; later output is dropped
+} Writer;
+
+int writer_open(Writer *w, int fd, size_t cap);
+int writer_close(Writer *w);
+int writer_flush(Writer *w);
+void writer_bytes(Writer *w, const char *s, size_t n);
+void writer_str(Writer *w, const char *s);
+void writer_char(Writer *w, char c);
+void writer_long(Writer *w, long v);
+void writer_fixed(Writer *w, double x, int decimals);
+void writer_trimmed(Writer *w, double x, int decimals);
+
+int parse_output_format(const char *s, OutputFormat *fmt);
+void write_output_header(Writer *w, OutputFormat fmt);
+void write_chart(Writer *w, OutputFormat fmt, long chart_num, double tjd_ut, const PlanetData *chart, int n,
+                 const Aspect *found, int nfound, const AspectDef *aspects);
+
+#endif
@@ -0,0 +1,349 @@
+#include "planet.h"
+#include "cheb.h"
+#include "ephtab.h"
+#include "instr.h"
+#include <stdio.h>
+
+// Optional read-only sources consulted before Swiss Ephemeris, shared by all threads
+static const EphTable *eph_table = NULL;
+static const ChebFile *cheb_cache = NULL;
+
+// Optional cache of computed positions, consulted first; it does its own locking
+static CalcCache *calc_cache = NULL;
+
+// Array of zodiac signs
+static const char *const signs[NUM_SIGNS] = {"Ari", "Tau", "Gem", "Can", "Leo", "Vir",
+                                             "Lib", "Sco", "Sag", "Cap", "Aqu", "Pis"};
+
+// Array of zodiac sign emojis
+static const char *const emojis[NUM_SIGNS] = {"♈️", "♉️", "♊️", "♋️", "♌️", "♍️", "♎️", "♏️", "♐️", "♑️", "♒️", "♓️"};
+
+// Element and quality of each sign
+static const unsigned char sign_elements[NUM_SIGNS] = {ELEMENT_FIRE, ELEMENT_EARTH, ELEMENT_AIR, ELEMENT_WATER,
+                                                       ELEMENT_FIRE, ELEMENT_EARTH, ELEMENT_AIR, ELEMENT_WATER,
+                                                       ELEMENT_FIRE, ELEMENT_EARTH, ELEMENT_AIR, ELEMENT_WATER};
+static const unsigned char sign_qualities[NUM_SIGNS] = {QUALITY_CARDINAL, QUALITY_FIXED, QUALITY_MUTABLE,
+                                                        QUALITY_CARDINAL, QUALITY_FIXED, QUALITY_MUTABLE,
+                                                        QUALITY_CARDINAL, QUALITY_FIXED, QUALITY_MUTABLE,
+                                                        QUALITY_CARDINAL, QUALITY_FIXED, QUALITY_MUTABLE};
+
+static const char *const elements[] = {"Fire", "Earth", "Air", "Water"};
+static const char *const qualities[] = {"Cardinal", "Fixed", "Mutable"};
+
+// Array of house names
+static const char *const houses[12] = {"First_House", "Second_House", "Third_House",    "Fourth_House",
+                                       "Fifth_House", "Sixth_House",  "Seventh_House",  "Eighth_House",
+                                       "Ninth_House", "Tenth_House",  "Eleventh_House", "Twelfth_House"};
+
+/**
+ * @brief Get the zodiac sign number based on the position
+ *
+ * @param pos The position of the planet
+ * @return int The sign number, SIGN_ARI to SIGN_PIS
+ */
+int get_sign_number(double pos) {
+    // Positions outside [0, 360) only come with unusual flags (e.g. SEFLG_XYZ)
+    if (pos < 0.0 || pos >= 360.0) {
+        pos = swe_degnorm(pos);
+    }
+
+    return (int)(pos / 30.0) % NUM_SIGNS;
+}
+
+/**
+ * @brief Get the natural house number based on the position
+ *
+ * The natural house is the one the sign rules when the first house starts at 0 Aries. It is only used when no
+ * observer is known; see place_in_houses() for the real house placement.
+ *
+ * @param pos The position of the planet
+ * @return int The house number, 0 for the first house
+ */
+int get_house_number(double pos) { return get_sign_number(pos); }
+
+/**
+ * @brief Get the zodiac sign abbreviation
+ *
+ * @param sign_num The sign number
+ * @return const char* The zodiac sign
+ */
+const char *get_sign(int sign_num) { return signs[sign_num]; }
+
+/**
+ * @brief Get the emoji of a zodiac sign
+ *
+ * @param sign_num The sign number
+ * @return const char* The emoji
+ */
+const char *get_emoji(int sign_num) { return emojis[sign_num]; }
+
+/**
+ * @brief Get the quality of a zodiac sign
+ *
+ * @param sign_num The sign number
+ * @return Quality The quality
+ */
+Quality get_quality(int sign_num) { return (Quality)sign_qualities[sign_num]; }
+
+/**
+ * @brief Get the element of a zodiac sign
+ *
+ * @param sign_num The sign number
+ * @return Element The element
+ */
+Element get_element(int sign_num) { return (Element)sign_elements[sign_num]; }
+
+/**
+ * @brief Get the name of a quality
+ *
+ * @param quality The quality
+ * @return const char* The quality name
+ */
+const char *get_quality_name(Quality quality) { return qualities[quality]; }
+
+/**
+ * @brief Get the name of an element
+ *
+ * @param element The element
+ * @return const char* The element name
+ */
+const char *get_element_name(Element element) { return elements[element]; }
+
+/**
+ * @brief Get the name of a house
+ *
+ * @param house The house number, 0 for the first house, or HOUSE_UNKNOWN
+ * @return const char* The house name
+ */
+const char *get_house(int house) { return house >= 0 && house < 12 ? houses[house] : "Unknown_House"; }
+
+/**
+ * @brief Get the planet position within the zodiac sign
+ *
+ * @param pos The position of the planet
+ * @return double The planet position within the zodiac sign
+ */
+double get_planet_position(double pos) { return pos - (int)(pos / 30.0) * 30.0; }
+
+/**
+ * @brief Answer planet positions from a Chebyshev cache where it covers the request
+ *
+ * The cache must stay open while it is in use; pass NULL to go back to Swiss Ephemeris only.
+ *
+ * @param cf The cache, or NULL
+ */
+void set_cheb_cache(const ChebFile *cf) { cheb_cache = cf; }
+
+/**
+ * @brief Keep computed positions in an LRU cache and answer repeated requests from it
+ *
+ * Topocentric positions are not cached since they depend on the observer. The cache must stay alive while it is in
+ * use; pass NULL to stop using it.
+ *
+ * @param cache The cache, or NULL
+ */
+void set_calc_cache(CalcCache *cache) { calc_cache = cache; }
+
+/**
+ * @brief Answer planet positions from a memory-mapped ephemeris table where it covers the request
+ *
+ * The table is consulted before the Chebyshev cache. It must stay open while it is in use; pass NULL to stop
+ * using it.
+ *
+ * @param tab The table, or NULL
+ */
+void set_ephtab(const EphTable *tab) { eph_table = tab; }
+
+/**
+ * @brief Compute a position from the first source that covers the request
+ *
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param planet_id The planet ID
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param xx The coordinates
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int32 The flags actually used, or ERR
+ */
+static int32 calc_position(double tjd_ut, int planet_id, int iflags, double *xx, char *serr) {
+    int cacheable = calc_cache != NULL && !(iflags & SEFLG_TOPOCTR);
+    int32 ret;
+
+    if (cacheable && calc_cache_get(calc_cache, tjd_ut, planet_id, iflags, xx) == OK) {
+        return iflags;
+    }
+
+    if (ephtab_calc(eph_table, tjd_ut, planet_id, iflags, xx) == OK) {
+        ret = iflags;
+    } else {
+        ret = cheb_calc_ut(cheb_cache, tjd_ut, planet_id, iflags, xx, serr);
+    }
+
+    if (cacheable && ret != ERR) {
+        calc_cache_put(calc_cache, tjd_ut, planet_id, iflags, xx);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Fill the planet data structure from the coordinates returned by Swiss Ephemeris
+ *
+ * @param planet The planet data structure
+ * @param planet_id The planet ID
+ * @param xx The coordinates returned by swe_calc_ut, with speeds (SEFLG_SPEED)
+ */
+void set_planet_data(PlanetData *planet, int planet_id, const double *xx) {
+    int sign_num = get_sign_number(xx[0]);
+
+    planet->body = planet_id;
+
+    // Set the position and absolute position in the structure
+    planet->pos = xx[0];
+    planet->abs_pos = get_planet_position(planet->pos);
+    planet->speed = xx[3];
+    planet->lat = xx[1];
+    planet->dist = xx[2];
+    planet->lat_speed = xx[4];
+    planet->dist_speed = xx[5];
+    planet->retrograde = xx[3] < 0.0;
+
+    // Set the sign, element, quality and house indices; each is a table lookup
+    planet->sign_num = (unsigned char)sign_num;
+    planet->element = sign_elements[sign_num];
+    planet->quality = sign_qualities[sign_num];
+    planet->house = (unsigned char)get_house_number(planet->pos);
+}
+
+/**
+ * @brief Compute the planet data into a caller-owned structure
+ *
+ * @param planet_id The planet ID
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param iflags The flags for the Swiss Ephemeris; SEFLG_SPEED is always added for the retrograde test
+ * @param planet The planet data structure to fill; on error its body is set to -1
+ * @return int OK on success, ERR if Swiss Ephemeris failed
+ */
+int get_planet_data_into(int planet_id, double tjd_ut, int iflags, PlanetData *planet) {
+    // Array for planet coordinates
+    double xx[6];
+
+    // Error buffer
+    char serr[256];
+    uint64_t t0 = instr_start();
+    int32 ret;
+
+    // Call to Swiss Ephemeris (or the table and cache in front of it) to calculate the planet's position
+    ret = calc_position(tjd_ut, planet_id, iflags | SEFLG_SPEED, xx, serr);
+    instr_stop(STAGE_CALC, t0);
+    if (ret == ERR) {
+        fprintf(stderr, "Error: %s\n", serr);
+        planet->body = -1;
+        return ERR;
+    }
+
+    t0 = instr_start();
+    set_planet_data(planet, planet_id, xx);
+    instr_stop(STAGE_CLASSIFY, t0);
+
+    return OK;
+}
+
+/**
+ * @brief Compute a full chart (bodies 0 to NUM_CHART_BODIES - 1) into a caller-owned array
+ *
+ * A batch of charts is filled without any allocation by pointing chart at consecutive slices of one array of
+ * n * NUM_CHART_BODIES entries.
+ *
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param chart The array of NUM_CHART_BODIES planet data structures to fill, indexed by planet ID
+ * @return int OK if every body was computed, ERR otherwise
+ */
+int get_chart_data(double tjd_ut, int iflags, PlanetData *chart) {
+    int ret = OK;
+
+    for (int i = 0; i < NUM_CHART_BODIES; i++) {
+        if (get_planet_data_into(i, tjd_ut, iflags, &chart[i]) == ERR) {
+            ret = ERR;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Get the planet data based on the planet ID, Julian Day, and flags
+ *
+ * The result is heap allocated and must be released with free(); see get_planet_data_into() for the
+ * allocation-free variant.
+ *
+ * @param planet_id The planet ID
+ * @param tjd_ut The Julian Day in Universal Time
+ * @param iflags The flags for the Swiss Ephemeris
+ * @return PlanetData* The planet data structure
+ */
+PlanetData *get_planet_data(int planet_id, double tjd_ut, int iflags) {
+    // Dynamically allocate memory for the planet data structure
+    PlanetData *planet = (PlanetData *)malloc(sizeof(PlanetData));
+
+    if (planet == NULL) {
+        return NULL;
+    }
+
+    if (get_planet_data_into(planet_id, tjd_ut, iflags, planet) == ERR) {
+        free(planet);
+        return NULL;
+    }
+
+    // Return the planet data structure
+    return planet;
+}
+
+/**
+ * @brief Parse a comma-separated list of planet IDs, e.g. "0,1,4"
+ *
+ * @param s The list
+ * @param bodies The planet IDs
+ * @param max The capacity of bodies
+ * @return int The number of planet IDs, or -1 on malformed input
+ */
+int parse_body_list(const char *s, int *bodies, int max) {
+    int n = 0;
+
+    while (*s != '\0') {
+        char *end;
+        long id = strtol(s, &end, 10);
+
+        if (end == s || n == max || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        bodies[n++] = (int)id;
+        s = *end == ',' ? end + 1 : end;
+    }
+
+    return n;
+}
+
+/**
+ * @brief Print the planet data in human-readable format
+ *
+ * @param planet The planet data structure
+ */
+void print_planet_data(const PlanetData *planet) {
+    char name[AS_MAXCH];
+
+    swe_get_planet_name(planet->body, name);
+
+    printf("Planet Data:\n");
+    printf("Name: %s\n", name);
+    printf("Quality: %s\n", get_quality_name((Quality)planet->quality));
+    printf("Element: %s\n", get_element_name((Element)planet->element));
+    printf("Sign: %s\n", get_sign(planet->sign_num));
+    printf("Sign Number: %d\n", planet->sign_num);
+    printf("Position: %.15f\n", planet->pos);
+    printf("Absolute Position: %.15f\n", planet->abs_pos);
+    printf("Emoji: %s\n", get_emoji(planet->sign_num));
+    printf("House: %s\n", get_house(planet->house));
+    printf("Retrograde: %s\n", planet->retrograde ? "True" : "False");
+    printf("\n");
+}
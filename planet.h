@@ -0,0 +1,74 @@
+#ifndef PLANET_H
+#define PLANET_H
+
+#include "calccache.h"
+#include "cheb.h"
+#include "ephtab.h"
+#include "swephexp.h"
+
+// Number of bodies in a chart: SE_SUN up to SE_EARTH
+#define NUM_CHART_BODIES 15
+
+// Zodiac signs, in ecliptic order from 0 degrees
+typedef enum {
+    SIGN_ARI,
+    SIGN_TAU,
+    SIGN_GEM,
+    SIGN_CAN,
+    SIGN_LEO,
+    SIGN_VIR,
+    SIGN_LIB,
+    SIGN_SCO,
+    SIGN_SAG,
+    SIGN_CAP,
+    SIGN_AQU,
+    SIGN_PIS,
+    NUM_SIGNS
+} Sign;
+
+typedef enum { ELEMENT_FIRE, ELEMENT_EARTH, ELEMENT_AIR, ELEMENT_WATER } Element;
+
+typedef enum { QUALITY_CARDINAL, QUALITY_FIXED, QUALITY_MUTABLE } Quality;
+
+// Define the structure to hold the planet data; names are only looked up when the data is printed
+typedef struct {
+    double pos;
+    double abs_pos;
+    double speed;             // longitude speed, degrees per day
+    double lat;               // ecliptic latitude, degrees
+    double dist;              // distance, AU
+    double lat_speed;         // degrees per day
+    double dist_speed;        // AU per day
+    int32 body;               // planet ID, -1 if the calculation failed
+    unsigned char sign_num;   // Sign
+    unsigned char element;    // Element
+    unsigned char quality;    // Quality
+    unsigned char house;      // house index, 0 for the first house, HOUSE_UNKNOWN if it could not be placed
+    unsigned char retrograde; // non-zero if the longitude speed is negative
+} PlanetData;
+
+// House index of a body that could not be placed in the houses of its observer
+#define HOUSE_UNKNOWN 255
+
+int get_sign_number(double pos);
+int get_house_number(double pos);
+const char *get_sign(int sign_num);
+const char *get_emoji(int sign_num);
+Quality get_quality(int sign_num);
+Element get_element(int sign_num);
+const char *get_quality_name(Quality quality);
+const char *get_element_name(Element element);
+const char *get_house(int house);
+double get_planet_position(double pos);
+
+void set_calc_cache(CalcCache *cache);
+void set_cheb_cache(const ChebFile *cf);
+void set_ephtab(const EphTable *tab);
+void set_planet_data(PlanetData *planet, int planet_id, const double *xx);
+int get_planet_data_into(int planet_id, double tjd_ut, int iflags, PlanetData *planet);
+int get_chart_data(double tjd_ut, int iflags, PlanetData *chart);
+PlanetData *get_planet_data(int planet_id, double tjd_ut, int iflags);
+int parse_body_list(const char *s, int *bodies, int max);
+void print_planet_data(const PlanetData *planet);
+
+#endif
@@ -0,0 +1,242 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct ThreadPool {
+    pthread_t *threads;
+    int nthreads;
+    WorkerConfig cfg;
+    char *ephe_path;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;
+    pthread_cond_t done_cv;
+
+    // The task currently being run, protected by lock
+    PoolTask task;
+    void *ctx;
+    size_t n;
+    size_t chunk;
+    size_t next;
+    int active;
+    unsigned long generation;
+    int shutdown;
+};
+
+typedef struct {
+    ThreadPool *pool;
+    int worker;
+} WorkerArg;
+
+/**
+ * @brief Initialize a worker configuration with the library defaults
+ *
+ * @param cfg The configuration
+ */
+void worker_config_init(WorkerConfig *cfg) { memset(cfg, 0, sizeof(*cfg)); }
+
+/**
+ * @brief Apply a worker configuration to the calling thread
+ *
+ * @param cfg The configuration
+ */
+void worker_config_apply(const WorkerConfig *cfg) {
+    if (cfg->ephe_path != NULL) {
+        swe_set_ephe_path(cfg->ephe_path);
+    }
+}
+
+/**
+ * @brief Get the number of online processors
+ *
+ * @return int The default number of worker threads
+ */
+int pool_default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n > 0 ? (int)n : 1;
+}
+
+/**
+ * @brief Worker thread: configure the thread-local library state, then run task chunks until shutdown
+ */
+static void *pool_worker(void *arg) {
+    WorkerArg *warg = (WorkerArg *)arg;
+    ThreadPool *pool = warg->pool;
+    int worker = warg->worker;
+    unsigned long seen = 0;
+
+    free(warg);
+    worker_config_apply(&pool->cfg);
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->shutdown && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_cv, &pool->lock);
+        }
+        if (pool->shutdown) {
+            break;
+        }
+        seen = pool->generation;
+
+        // Claim chunks until the index space is exhausted
+        while (pool->next < pool->n) {
+            size_t begin = pool->next;
+            size_t end = begin + pool->chunk < pool->n ? begin + pool->chunk : pool->n;
+
+            pool->next = end;
+            pthread_mutex_unlock(&pool->lock);
+            pool->task(pool->ctx, begin, end, worker);
+            pthread_mutex_lock(&pool->lock);
+        }
+
+        if (--pool->active == 0) {
+            pthread_cond_signal(&pool->done_cv);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    // Release the files this thread opened
+    swe_close();
+
+    return NULL;
+}
+
+/**
+ * @brief Create a pool of worker threads
+ *
+ * Every worker applies the configuration to its own thread-local library state before taking work.
+ *
+ * @param nthreads The number of workers, or 0 for one per online processor
+ * @param cfg The worker configuration, or NULL for the library defaults
+ * @return ThreadPool* The pool, or NULL on failure
+ */
+ThreadPool *pool_create(int nthreads, const WorkerConfig *cfg) {
+    ThreadPool *pool = (ThreadPool *)calloc(1, sizeof(ThreadPool));
+
+    if (pool == NULL) {
+        return NULL;
+    }
+    if (nthreads <= 0) {
+        nthreads = pool_default_threads();
+    }
+
+    if (cfg != NULL) {
+        pool->cfg = *cfg;
+    } else {
+        worker_config_init(&pool->cfg);
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cv, NULL);
+    pthread_cond_init(&pool->done_cv, NULL);
+
+    // Keep a private copy of the path, the workers read it after this call returns
+    if (pool->cfg.ephe_path != NULL) {
+        pool->ephe_path = strdup(pool->cfg.ephe_path);
+        if (pool->ephe_path == NULL) {
+            pool_destroy(pool);
+            return NULL;
+        }
+        pool->cfg.ephe_path = pool->ephe_path;
+    }
+
+    pool->threads = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+    if (pool->threads == NULL) {
+        pool_destroy(pool);
+        return NULL;
+    }
+
+    for (int i = 0; i < nthreads; i++) {
+        WorkerArg *warg = (WorkerArg *)malloc(sizeof(WorkerArg));
+
+        if (warg == NULL) {
+            pool_destroy(pool);
+            return NULL;
+        }
+        warg->pool = pool;
+        warg->worker = i;
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, warg) != 0) {
+            free(warg);
+            pool_destroy(pool);
+            return NULL;
+        }
+        pool->nthreads++;
+    }
+
+    return pool;
+}
+
+/**
+ * @brief Get the number of workers of a pool
+ *
+ * @param pool The pool
+ * @return int The number of workers
+ */
+int pool_size(const ThreadPool *pool) { return pool->nthreads; }
+
+/**
+ * @brief Run a task over the index space [0, n) and wait until every item is processed
+ *
+ * Items are handed out in chunks to whichever worker is free. Only one pool_run() may be active at a time.
+ *
+ * @param pool The pool
+ * @param n The number of items
+ * @param chunk The number of items per chunk, or 0 to pick one from n and the pool size
+ * @param task The task
+ * @param ctx The context passed to the task
+ */
+void pool_run(ThreadPool *pool, size_t n, size_t chunk, PoolTask task, void *ctx) {
+    if (n == 0) {
+        return;
+    }
+    if (chunk == 0) {
+        chunk = n / (8 * (size_t)pool->nthreads) + 1;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->n = n;
+    pool->chunk = chunk;
+    pool->next = 0;
+    pool->active = pool->nthreads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cv);
+
+    while (pool->active > 0) {
+        pthread_cond_wait(&pool->done_cv, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Stop the workers and free the pool
+ *
+ * @param pool The pool
+ */
+void pool_destroy(ThreadPool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done_cv);
+    pthread_cond_destroy(&pool->work_cv);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->ephe_path);
+    free(pool);
+}
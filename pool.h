@@ -0,0 +1,27 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "swephexp.h"
+#include <stddef.h>
+
+// Library settings applied once in every worker thread; libswe keeps them in thread-local storage. The topocentric
+// observer is not among them: it changes with every chart and is set by the code computing the chart.
+typedef struct {
+    const char *ephe_path; // NULL keeps the library default
+} WorkerConfig;
+
+typedef struct ThreadPool ThreadPool;
+
+// A task processes the items [begin, end) on behalf of the given worker
+typedef void (*PoolTask)(void *ctx, size_t begin, size_t end, int worker);
+
+void worker_config_init(WorkerConfig *cfg);
+void worker_config_apply(const WorkerConfig *cfg);
+
+int pool_default_threads(void);
+ThreadPool *pool_create(int nthreads, const WorkerConfig *cfg);
+int pool_size(const ThreadPool *pool);
+void pool_run(ThreadPool *pool, size_t n, size_t chunk, PoolTask task, void *ctx);
+void pool_destroy(ThreadPool *pool);
+
+#endif
@@ -0,0 +1,502 @@
+#include "riseset.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Rise and set grid
+ *
+ * swe_rise_trans() recomputes the body's position for every call, although at a given instant it is the same for
+ * every city on Earth. The grid computes the apparent right ascension and declination once, on a table spaced
+ * RISESET_TABLE_STEP apart over the whole range, and solves every (city, day, event) on that table: the body rises
+ * (sets) when its hour angle is -H0 (+H0), where cos H0 = (sin h0 - sin lat sin dec) / (cos lat cos dec) and h0 is
+ * the geocentric altitude of the centre when the upper limb appears on the horizon, the event swe_rise_trans()
+ * reports by default. h0 is built the way swe_rise_trans() builds it: the body's parallax minus its apparent
+ * semidiameter, both tabulated with the positions, plus the true altitude of the apparent horizon, which
+ * swe_refrac_extended() gives once per city for the default atmosphere at the city's altitude. Each
+ * iteration moves the time by the hour angle still missing, divided by the rate at which the hour angle grows, and
+ * converges to the event nearest to the starting time within a few iterations if the start is good:
+ *
+ * - the first day of a city starts from the same event of the previous city in the chunk, shifted by the difference
+ *   in longitude (cities are sorted by longitude), or from an estimate from the transit if there is none;
+ * - every next day starts from the previous day's event plus the body's mean day (1.035 days for the Moon).
+ *
+ * Day d of a city is the local mean day from jd_start + d - longitude / 360, so jd_start is meant to be a midnight
+ * UT. A day without the event (the Moon skips one rise and one set a month) gets NAN. Beyond RISESET_MAX_LAT, and in
+ * exact mode, every event is searched with swe_rise_trans() from the start of the day instead: the hour angle
+ * equation above gets ill-conditioned where the body grazes the horizon, and there a day can have two rises.
+ *
+ * The remaining differences to swe_rise_trans() come from the linear interpolation of the table and from taking the
+ * parallax and semidiameter geocentric; they are of the order of a second of time.
+ */
+
+// Rate of the Greenwich sidereal time, degrees per day
+#define SIDEREAL_RATE 360.98564736629
+
+// Convergence of the solver, in days, and its iteration limit; far below a second, so that the times do not depend on
+// the seed
+#define RISESET_EPS 1e-9
+#define RISESET_MAX_ITER 16
+
+// The atmosphere swe_rise_trans() assumes when given a zero pressure and temperature: the pressure of the standard
+// atmosphere at the observer's altitude, at 0 degrees Celsius
+#define SEA_LEVEL_PRESSURE 1013.25
+#define RISESET_TEMPERATURE 0.0
+#define LAPSE_RATE 0.0065
+
+#define EARTH_RADIUS_KM 6378.14
+#define AU_KM 149597870.7
+
+typedef enum { EVENT_RISE = -1, EVENT_SET = 1 } RiseSetEvent;
+
+// Positions of the body shared by all the cities; angles are unwrapped so that they interpolate linearly
+typedef struct {
+    double jd0;
+    int n;
+    double period; // mean time between two rises, in days
+    double *ra;
+    double *dec;
+    double *h0;  // parallax minus apparent semidiameter, degrees; the horizon of the city is added to it
+    double *gst; // Greenwich apparent sidereal time
+} BodyTable;
+
+typedef struct {
+    const BodyTable *tab;
+    long *errors; // failed swe_rise_trans() searches, one counter per worker
+    int body;
+    int iflags;
+    const City *cities;
+    const size_t *order; // city indices sorted by longitude
+    double jd_start;
+    int ndays;
+    int exact;
+    double *rise;
+    double *set;
+} RiseSetCtx;
+
+/**
+ * @brief Tabulate the body's position over a range
+ *
+ * @return int OK on success, ERR on a library error or out of memory
+ */
+static int body_table_init(BodyTable *tab, int body, int iflags, double jd_start, double jd_end, char *serr) {
+    int eflags = (iflags & (SEFLG_JPLEPH | SEFLG_SWIEPH | SEFLG_MOSEPH)) | SEFLG_EQUATORIAL;
+
+    memset(tab, 0, sizeof(*tab));
+    tab->jd0 = jd_start;
+    tab->n = (int)ceil((jd_end - jd_start) / RISESET_TABLE_STEP) + 1;
+    tab->ra = (double *)malloc(4 * (size_t)tab->n * sizeof(double));
+    if (tab->ra == NULL) {
+        strcpy(serr, "out of memory");
+        return ERR;
+    }
+    tab->dec = tab->ra + tab->n;
+    tab->h0 = tab->dec + tab->n;
+    tab->gst = tab->h0 + tab->n;
+
+    for (int i = 0; i < tab->n; i++) {
+        double t = jd_start + i * RISESET_TABLE_STEP;
+        double xx[6], attr[20];
+
+        if (swe_calc_ut(t, body, eflags, xx, serr) == ERR) {
+            free(tab->ra);
+            return ERR;
+        }
+        tab->ra[i] = xx[0];
+        tab->dec[i] = xx[1];
+        tab->gst[i] = swe_sidtime(t) * 15.0;
+        tab->h0[i] = asin(EARTH_RADIUS_KM / (xx[2] * AU_KM)) * RADTODEG;
+        // attr[3] is the apparent diameter; points without a disc (nodes, apogees) fail or give zero
+        if (swe_pheno_ut(t, body, eflags & ~SEFLG_EQUATORIAL, attr, serr) != ERR) {
+            tab->h0[i] -= attr[3] / 2.0;
+        }
+        if (i > 0) {
+            tab->ra[i] = tab->ra[i - 1] + swe_difdeg2n(tab->ra[i], tab->ra[i - 1]);
+            tab->gst[i] = tab->gst[i - 1] + swe_difdeg2n(tab->gst[i], tab->gst[i - 1]);
+        }
+    }
+    tab->period = SIDEREAL_RATE / (SIDEREAL_RATE - (tab->ra[tab->n - 1] - tab->ra[0]) / (jd_end - jd_start));
+
+    return OK;
+}
+
+static void body_table_free(BodyTable *tab) {
+    free(tab->ra);
+    memset(tab, 0, sizeof(*tab));
+}
+
+/**
+ * @brief Compute the true altitude of the apparent horizon, as swe_rise_trans() does with its default atmosphere
+ *
+ * @param geoalt The altitude of the observer above sea level, metres
+ * @return double The altitude in degrees, minus the refraction at the horizon
+ */
+static double horizon_altitude(double geoalt) {
+    double pressure = SEA_LEVEL_PRESSURE;
+    double dret[4];
+
+    if (geoalt > 0) {
+        pressure *= pow(1.0 - LAPSE_RATE * geoalt / 288.0, 5.255);
+    }
+
+    return swe_refrac_extended(0.0, geoalt, pressure, RISESET_TEMPERATURE, LAPSE_RATE, SE_APP_TO_TRUE, dret);
+}
+
+/**
+ * @brief Hour angle still missing to an event at a time
+ *
+ * @param tab The table
+ * @param lat The geographic latitude
+ * @param lon The geographic longitude
+ * @param horizon The true altitude of the city's apparent horizon, from horizon_altitude()
+ * @param event EVENT_RISE or EVENT_SET
+ * @param t The time
+ * @param dh The missing hour angle, in (-180, 180] degrees
+ * @param rate The rate of the hour angle, degrees per day
+ * @return int OK, or ERR if the body does not reach the horizon at that time
+ */
+static int missing_hour_angle(const BodyTable *tab, double lat, double lon, double horizon, int event, double t,
+                              double *dh, double *rate) {
+    double x = (t - tab->jd0) / RISESET_TABLE_STEP;
+    int i = (int)floor(x);
+    double f, ra, dec, h0, gst, cos_h0;
+
+    if (i < 0) {
+        i = 0;
+    } else if (i > tab->n - 2) {
+        i = tab->n - 2;
+    }
+    f = x - i;
+    ra = tab->ra[i] + f * (tab->ra[i + 1] - tab->ra[i]);
+    dec = (tab->dec[i] + f * (tab->dec[i + 1] - tab->dec[i])) * DEGTORAD;
+    h0 = (tab->h0[i] + f * (tab->h0[i + 1] - tab->h0[i]) + horizon) * DEGTORAD;
+    gst = tab->gst[i] + f * (tab->gst[i + 1] - tab->gst[i]);
+
+    cos_h0 = (sin(h0) - sin(lat * DEGTORAD) * sin(dec)) / (cos(lat * DEGTORAD) * cos(dec));
+    if (cos_h0 < -1.0 || cos_h0 > 1.0) {
+        return ERR;
+    }
+
+    *dh = swe_difdeg2n(event * acos(cos_h0) * RADTODEG, gst + lon - ra);
+    *rate = SIDEREAL_RATE - (tab->ra[i + 1] - tab->ra[i]) / RISESET_TABLE_STEP;
+
+    return OK;
+}
+
+/**
+ * @brief Solve for the event nearest to a starting time
+ *
+ * @return double The time of the event, or NAN if the body does not reach the horizon or the solver did not converge
+ */
+static double solve_event(const BodyTable *tab, double lat, double lon, double horizon, int event, double t) {
+    for (int iter = 0; iter < RISESET_MAX_ITER; iter++) {
+        double dh, rate, dt;
+
+        if (missing_hour_angle(tab, lat, lon, horizon, event, t, &dh, &rate) == ERR) {
+            return NAN;
+        }
+        dt = dh / rate;
+        t += dt;
+        if (fabs(dt) < RISESET_EPS) {
+            return t;
+        }
+    }
+
+    return NAN;
+}
+
+/**
+ * @brief Estimate an event of a day from scratch, from the hour angle missing at local noon
+ */
+static double cold_seed(const BodyTable *tab, double lat, double lon, double horizon, int event, double day_start) {
+    double t = day_start + 0.5;
+    double dh, rate;
+
+    if (missing_hour_angle(tab, lat, lon, horizon, event, t, &dh, &rate) == ERR) {
+        return t;
+    }
+
+    return t + dh / rate;
+}
+
+/**
+ * @brief Search one event of one day with swe_rise_trans()
+ *
+ * @return double The time of the event, or NAN if there is none that day or the search failed; failures are
+ * printed and counted for the worker
+ */
+static double rise_trans_event(const RiseSetCtx *c, const City *city, int event, double day_start, int worker) {
+    double geo[3], tret[10];
+    char serr[256];
+    int32 rc;
+
+    memcpy(geo, city->geo, sizeof(geo));
+    rc = swe_rise_trans(day_start, c->body, NULL, c->iflags & (SEFLG_JPLEPH | SEFLG_SWIEPH | SEFLG_MOSEPH),
+                        event == EVENT_RISE ? SE_CALC_RISE : SE_CALC_SET, geo, 0.0, 0.0, tret, serr);
+    if (rc == ERR) {
+        fprintf(stderr, "Error: %s: %s\n", city->name, serr);
+        c->errors[worker]++;
+    }
+
+    return rc == OK && tret[0] < day_start + 1.0 ? tret[0] : NAN;
+}
+
+/**
+ * @brief Fill the days of one event of one city
+ *
+ * @param seed The first day's starting time, or NAN for a cold start
+ * @param worker The worker computing the city
+ */
+static void city_events(const RiseSetCtx *c, size_t city, int event, double seed, int worker) {
+    const City *ci = &c->cities[city];
+    double lon = ci->geo[0], lat = ci->geo[1], horizon = horizon_altitude(ci->geo[2]);
+    double *out = &(event == EVENT_RISE ? c->rise : c->set)[city * c->ndays];
+    int fallback = c->exact || fabs(lat) > RISESET_MAX_LAT;
+
+    for (int d = 0; d < c->ndays; d++) {
+        double start = c->jd_start + d - lon / 360.0;
+        double t;
+
+        if (fallback) {
+            out[d] = rise_trans_event(c, ci, event, start, worker);
+            continue;
+        }
+
+        if (isnan(seed)) {
+            seed = cold_seed(c->tab, lat, lon, horizon, event, start);
+        }
+        t = solve_event(c->tab, lat, lon, horizon, event, seed);
+        for (int retry = 0; retry < 2 && !isnan(t) && t < start; retry++) {
+            t = solve_event(c->tab, lat, lon, horizon, event, t + c->tab->period);
+        }
+        // A seed from a distant neighbour can also overshoot by a day
+        if (!isnan(t) && t >= start + 1.0) {
+            double earlier = solve_event(c->tab, lat, lon, horizon, event, t - c->tab->period);
+
+            if (!isnan(earlier) && earlier >= start && earlier < start + 1.0) {
+                t = earlier;
+            }
+        }
+
+        if (isnan(t) || t < start) {
+            out[d] = NAN;
+            seed = NAN;
+        } else if (t >= start + 1.0) {
+            // No event on this day; the one found belongs to the next
+            out[d] = NAN;
+            seed = t;
+        } else {
+            out[d] = t;
+            seed = t + c->tab->period;
+        }
+    }
+}
+
+static void riseset_task(void *ctx, size_t begin, size_t end, int worker) {
+    RiseSetCtx *c = (RiseSetCtx *)ctx;
+
+    for (size_t k = begin; k < end; k++) {
+        size_t city = c->order[k];
+        double rise_seed = NAN, set_seed = NAN;
+
+        // The first day starts from the previous city's, shifted by the difference in longitude
+        if (k > begin) {
+            size_t prev = c->order[k - 1];
+            double shift = (c->cities[prev].geo[0] - c->cities[city].geo[0]) / 360.0;
+
+            rise_seed = c->rise[prev * c->ndays] + shift;
+            set_seed = c->set[prev * c->ndays] + shift;
+        }
+        city_events(c, city, EVENT_RISE, rise_seed, worker);
+        city_events(c, city, EVENT_SET, set_seed, worker);
+    }
+}
+
+typedef struct {
+    double lon;
+    size_t index;
+} CityOrder;
+
+static int compare_longitudes(const void *a, const void *b) {
+    const CityOrder *ca = (const CityOrder *)a, *cb = (const CityOrder *)b;
+
+    if (ca->lon != cb->lon) {
+        return ca->lon < cb->lon ? -1 : 1;
+    }
+
+    return ca->index < cb->index ? -1 : ca->index > cb->index;
+}
+
+/**
+ * @brief Compute the daily rise and set times of a body for many cities
+ *
+ * @param body The planet ID
+ * @param iflags The ephemeris flags for the Swiss Ephemeris
+ * @param cities The cities
+ * @param ncities The number of cities
+ * @param jd_start The start of the first day at Greenwich, normally a midnight UT; each city's days start at its
+ *                 local mean midnight
+ * @param ndays The number of days
+ * @param exact Non-zero to search every event with swe_rise_trans() instead of the shared table; cities beyond
+ *              RISESET_MAX_LAT are always searched that way
+ * @param pool The pool to spread the cities over, or NULL for the calling thread
+ * @param rise The rise times (UT), city-major: rise[city * ndays + day], NAN for a day without rise
+ * @param set The set times, laid out like rise
+ * @return int OK on success, ERR on a library error, including a failed swe_rise_trans() search, or out of memory
+ */
+int riseset_grid(int body, int iflags, const City *cities, size_t ncities, double jd_start, int ndays, int exact,
+                 ThreadPool *pool, double *rise, double *set) {
+    RiseSetCtx ctx = {NULL, NULL, body, iflags, cities, NULL, jd_start, ndays, exact, rise, set};
+    int nworkers = pool != NULL ? pool_size(pool) : 1;
+    size_t *order = (size_t *)malloc((ncities + 1) * sizeof(size_t));
+    CityOrder *sorted = (CityOrder *)malloc((ncities + 1) * sizeof(CityOrder));
+    long *errors = (long *)calloc(nworkers, sizeof(long));
+    BodyTable tab;
+    char serr[256];
+    int ret = OK;
+
+    if (order == NULL || sorted == NULL || errors == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(order);
+        free(sorted);
+        free(errors);
+        return ERR;
+    }
+    // The table covers the local days of every longitude and the searches that overshoot the last day
+    if (body_table_init(&tab, body, iflags, jd_start - 1.0, jd_start + ndays + 2.0, serr) == ERR) {
+        fprintf(stderr, "Error: %s\n", serr);
+        free(order);
+        free(sorted);
+        free(errors);
+        return ERR;
+    }
+
+    for (size_t i = 0; i < ncities; i++) {
+        sorted[i].lon = cities[i].geo[0];
+        sorted[i].index = i;
+    }
+    qsort(sorted, ncities, sizeof(CityOrder), compare_longitudes);
+    for (size_t i = 0; i < ncities; i++) {
+        order[i] = sorted[i].index;
+    }
+    free(sorted);
+
+    ctx.tab = &tab;
+    ctx.errors = errors;
+    ctx.order = order;
+    if (pool != NULL) {
+        pool_run(pool, ncities, RISESET_CHUNK, riseset_task, &ctx);
+    } else {
+        riseset_task(&ctx, 0, ncities, 0);
+    }
+
+    for (int w = 0; w < nworkers; w++) {
+        if (errors[w] > 0) {
+            ret = ERR;
+        }
+    }
+
+    body_table_free(&tab);
+    free(order);
+    free(errors);
+
+    return ret;
+}
+
+static void print_event(double jd) {
+    int year, month, day, sec;
+    double hour;
+
+    if (isnan(jd)) {
+        printf(" %-19s", "-");
+        return;
+    }
+    swe_revjul(jd, SE_GREG_CAL, &year, &month, &day, &hour);
+    sec = (int)(hour * 3600.0);
+    printf(" %04d-%02d-%02d %02d:%02d:%02d", year, month, day, sec / 3600, sec / 60 % 60, sec % 60);
+}
+
+/**
+ * @brief Entry point of the riseset mode
+ *
+ * main riseset <jd_start> <ndays> <cities> [-b body] [-x] [-f iflags] [-j threads]
+ *
+ * Prints one line per city and day: city, local date, then the rise and set date and time (UT), "-" if there is
+ * none. The cities file has one "name latitude longitude [altitude]" per line, as for the eclipses mode. -x searches
+ * every event with swe_rise_trans(), as is always done for cities beyond RISESET_MAX_LAT (60 degrees).
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int riseset_main(int argc, char **argv) {
+    int body = SE_SUN;
+    int iflags = SEFLG_SWIEPH;
+    int nthreads = 1;
+    int exact = 0;
+    City *cities;
+    int ncities, ndays;
+    double jd_start, *rise, *set;
+    ThreadPool *pool = NULL;
+    int ret;
+
+    if (argc < 4) {
+        fprintf(stderr, "Usage: main riseset <jd_start> <ndays> <cities> [-b body] [-x] [-f iflags] [-j threads]\n");
+        return 1;
+    }
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "-x") == 0) {
+            exact = 1;
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            body = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            iflags = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        }
+    }
+
+    jd_start = atof(argv[1]);
+    ndays = atoi(argv[2]);
+    ncities = read_cities(argv[3], &cities);
+    if (ncities == ERR || ndays <= 0) {
+        free(cities);
+        return 1;
+    }
+    rise = (double *)malloc(((size_t)ncities * ndays + 1) * sizeof(double));
+    set = (double *)malloc(((size_t)ncities * ndays + 1) * sizeof(double));
+    if (rise == NULL || set == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(rise);
+        free(set);
+        free(cities);
+        return 1;
+    }
+    if (nthreads != 1) {
+        pool = pool_create(nthreads, NULL);
+    }
+
+    ret = riseset_grid(body, iflags, cities, ncities, jd_start, ndays, exact, pool, rise, set);
+    pool_destroy(pool);
+
+    for (int c = 0; ret == OK && c < ncities; c++) {
+        for (int d = 0; d < ndays; d++) {
+            int year, month, day;
+            double hour;
+
+            swe_revjul(jd_start + d, SE_GREG_CAL, &year, &month, &day, &hour);
+            printf("%-20s %04d-%02d-%02d", cities[c].name, year, month, day);
+            print_event(rise[(size_t)c * ndays + d]);
+            print_event(set[(size_t)c * ndays + d]);
+            printf("\n");
+        }
+    }
+
+    free(rise);
+    free(set);
+    free(cities);
+    swe_close();
+
+    return ret == OK ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+#ifndef RISESET_H
+#define RISESET_H
+
+#include "eclipses.h"
+#include "pool.h"
+#include <stddef.h>
+
+// Beyond this latitude a body can stay up or down for days and the grid solver hands over to swe_rise_trans()
+#define RISESET_MAX_LAT 60.0
+
+// Spacing of the shared position table, in days
+#define RISESET_TABLE_STEP (1.0 / 24.0)
+
+// Cities per pool item; neighbouring cities in a chunk seed each other
+#define RISESET_CHUNK 64
+
+int riseset_grid(int body, int iflags, const City *cities, size_t ncities, double jd_start, int ndays, int exact,
+                 ThreadPool *pool, double *rise, double *set);
+
+int riseset_main(int argc, char **argv);
+
+#endif
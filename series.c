@@ -0,0 +1,242 @@
+#include "series.h"
+#include "output.h"
+#include "planet.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Steps computed per pool item, so that a few bodies still spread over many workers
+#define SERIES_BLOCK 4096
+
+/**
+ * @brief Allocate a time series for the grid jd_start, jd_start + step, ... up to jd_end
+ *
+ * @param ts The time series
+ * @param jd_start The first Julian Day (UT)
+ * @param jd_end The last Julian Day (UT), included if it falls on the grid
+ * @param step The step in days
+ * @param bodies The planet IDs
+ * @param nbodies The number of planet IDs
+ * @return int OK on success, ERR on invalid arguments or out of memory
+ */
+int series_init(TimeSeries *ts, double jd_start, double jd_end, double step, const int *bodies, int nbodies) {
+    memset(ts, 0, sizeof(*ts));
+    if (step <= 0 || jd_end < jd_start || nbodies <= 0) {
+        return ERR;
+    }
+
+    ts->jd_start = jd_start;
+    ts->step = step;
+    // The small epsilon keeps jd_end on the grid despite rounding in (jd_end - jd_start) / step
+    ts->nsteps = (size_t)floor((jd_end - jd_start) / step + 1e-9) + 1;
+    ts->nbodies = nbodies;
+    ts->bodies = (int *)malloc(nbodies * sizeof(int));
+    ts->data = (double *)malloc((size_t)NUM_SERIES_COLUMNS * nbodies * ts->nsteps * sizeof(double));
+    if (ts->bodies == NULL || ts->data == NULL) {
+        series_free(ts);
+        return ERR;
+    }
+    memcpy(ts->bodies, bodies, nbodies * sizeof(int));
+
+    return OK;
+}
+
+/**
+ * @brief Release a time series
+ *
+ * @param ts The time series
+ */
+void series_free(TimeSeries *ts) {
+    free(ts->bodies);
+    free(ts->data);
+    ts->bodies = NULL;
+    ts->data = NULL;
+}
+
+/**
+ * @brief Get the column of one quantity of one body
+ *
+ * @param ts The time series
+ * @param body_index The index of the body in ts->bodies
+ * @param column The quantity
+ * @return double* The nsteps contiguous values
+ */
+double *series_column(const TimeSeries *ts, int body_index, SeriesColumn column) {
+    return &ts->data[((size_t)body_index * NUM_SERIES_COLUMNS + column) * ts->nsteps];
+}
+
+/**
+ * @brief Get the Julian Day of a step
+ *
+ * @param ts The time series
+ * @param i The step
+ * @return double The Julian Day (UT)
+ */
+double series_jd(const TimeSeries *ts, size_t i) { return ts->jd_start + (double)i * ts->step; }
+
+typedef struct {
+    TimeSeries *ts;
+    int iflags;
+    size_t nblocks;
+    long *errors; // one counter per worker
+} SeriesCtx;
+
+/**
+ * @brief Compute the steps [begin, end) of one body
+ *
+ * Consecutive calls for the same body hit the library's per-body caches, which is why the time loop is inside.
+ *
+ * @return long The number of failed steps
+ */
+static long compute_block(TimeSeries *ts, int b, size_t begin, size_t end, int iflags) {
+    double *col[NUM_SERIES_COLUMNS];
+    double xx[6];
+    char serr[256];
+    long errors = 0;
+
+    for (int c = 0; c < NUM_SERIES_COLUMNS; c++) {
+        col[c] = series_column(ts, b, (SeriesColumn)c);
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        if (swe_calc_ut(series_jd(ts, i), ts->bodies[b], iflags, xx, serr) == ERR) {
+            if (errors++ == 0) {
+                fprintf(stderr, "Error: %s\n", serr);
+            }
+            for (int c = 0; c < NUM_SERIES_COLUMNS; c++) {
+                xx[c] = NAN;
+            }
+        }
+        for (int c = 0; c < NUM_SERIES_COLUMNS; c++) {
+            col[c][i] = xx[c];
+        }
+    }
+
+    return errors;
+}
+
+static void series_task(void *ctx, size_t begin, size_t end, int worker) {
+    SeriesCtx *c = (SeriesCtx *)ctx;
+
+    for (size_t item = begin; item < end; item++) {
+        int b = (int)(item / c->nblocks);
+        size_t first = (item % c->nblocks) * SERIES_BLOCK;
+        size_t last = first + SERIES_BLOCK < c->ts->nsteps ? first + SERIES_BLOCK : c->ts->nsteps;
+
+        c->errors[worker] += compute_block(c->ts, b, first, last, c->iflags);
+    }
+}
+
+/**
+ * @brief Fill a time series
+ *
+ * Failed calculations are stored as NaN.
+ *
+ * @param ts The time series
+ * @param iflags The flags for the Swiss Ephemeris (add SEFLG_SPEED to get the speed columns)
+ * @param pool The pool to spread bodies and blocks of steps over, or NULL for the calling thread
+ * @return long The number of failed calculations
+ */
+long series_compute(TimeSeries *ts, int iflags, ThreadPool *pool) {
+    long errors = 0;
+
+    if (pool != NULL) {
+        SeriesCtx ctx = {ts, iflags, (ts->nsteps + SERIES_BLOCK - 1) / SERIES_BLOCK, NULL};
+
+        ctx.errors = (long *)calloc(pool_size(pool), sizeof(long));
+        if (ctx.errors != NULL) {
+            pool_run(pool, (size_t)ts->nbodies * ctx.nblocks, 1, series_task, &ctx);
+            for (int w = 0; w < pool_size(pool); w++) {
+                errors += ctx.errors[w];
+            }
+            free(ctx.errors);
+            return errors;
+        }
+    }
+
+    for (int b = 0; b < ts->nbodies; b++) {
+        errors += compute_block(ts, b, 0, ts->nsteps, iflags);
+    }
+
+    return errors;
+}
+
+/**
+ * @brief Entry point of the time series mode
+ *
+ * main series <jd_start> <jd_end> <step> [-b bodies] [-f iflags] [-j threads]
+ *
+ * Prints one line per step and body: jd, body, longitude, latitude, distance and their speeds.
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int series_main(int argc, char **argv) {
+    int bodies[SE_NPLANETS];
+    int nbodies = NUM_CHART_BODIES;
+    int iflags = SEFLG_SWIEPH | SEFLG_SPEED;
+    int nthreads = 1;
+    ThreadPool *pool = NULL;
+    TimeSeries ts;
+    Writer out;
+    long errors;
+
+    if (argc < 4) {
+        fprintf(stderr, "Usage: main series <jd_start> <jd_end> <step> [-b bodies] [-f iflags] [-j threads]\n");
+        return 1;
+    }
+
+    for (int i = 0; i < NUM_CHART_BODIES; i++) {
+        bodies[i] = i;
+    }
+    for (int i = 4; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-b") == 0) {
+            nbodies = parse_body_list(argv[i + 1], bodies, SE_NPLANETS);
+        } else if (strcmp(argv[i], "-f") == 0) {
+            iflags = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            nthreads = atoi(argv[i + 1]);
+        }
+    }
+
+    if (nbodies <= 0 || series_init(&ts, atof(argv[1]), atof(argv[2]), atof(argv[3]), bodies, nbodies) == ERR) {
+        fprintf(stderr, "Error: invalid range or body list\n");
+        return 1;
+    }
+    if (nthreads != 1) {
+        pool = pool_create(nthreads, NULL);
+    }
+
+    errors = series_compute(&ts, iflags, pool);
+    pool_destroy(pool);
+
+    fflush(stdout);
+    if (writer_open(&out, STDOUT_FILENO, 0) == ERR) {
+        fprintf(stderr, "Error: out of memory\n");
+        series_free(&ts);
+        return 1;
+    }
+    for (size_t i = 0; i < ts.nsteps; i++) {
+        for (int b = 0; b < ts.nbodies; b++) {
+            writer_fixed(&out, series_jd(&ts, i), 6);
+            writer_char(&out, ' ');
+            writer_long(&out, ts.bodies[b]);
+            for (int c = 0; c < NUM_SERIES_COLUMNS; c++) {
+                writer_char(&out, ' ');
+                writer_fixed(&out, series_column(&ts, b, (SeriesColumn)c)[i], 10);
+            }
+            writer_char(&out, '\n');
+        }
+    }
+    if (writer_close(&out) == ERR) {
+        errors++;
+    }
+
+    series_free(&ts);
+    swe_close();
+
+    return errors > 0 ? 1 : 0;
+}
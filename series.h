@@ -0,0 +1,36 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include "pool.h"
+#include <stddef.h>
+
+// Quantities stored per body and step, in swe_calc_ut order
+typedef enum {
+    SERIES_LON,
+    SERIES_LAT,
+    SERIES_DIST,
+    SERIES_LON_SPEED,
+    SERIES_LAT_SPEED,
+    SERIES_DIST_SPEED,
+    NUM_SERIES_COLUMNS
+} SeriesColumn;
+
+// Positions of several bodies over a Julian Day grid, stored as one contiguous column per quantity per body
+typedef struct {
+    double jd_start;
+    double step;
+    size_t nsteps;
+    int nbodies;
+    int *bodies;
+    double *data; // NUM_SERIES_COLUMNS * nbodies columns of nsteps values
+} TimeSeries;
+
+int series_init(TimeSeries *ts, double jd_start, double jd_end, double step, const int *bodies, int nbodies);
+void series_free(TimeSeries *ts);
+double *series_column(const TimeSeries *ts, int body_index, SeriesColumn column);
+double series_jd(const TimeSeries *ts, size_t i);
+long series_compute(TimeSeries *ts, int iflags, ThreadPool *pool);
+
+int series_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,808 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "server.h"
+#include "houses.h"
+#include "instr.h"
+#include "planet.h"
+#include "pool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Chart server
+ *
+ * One I/O thread owns the listening socket and every connection, all non-blocking and driven by epoll. Each round
+ * of events is parsed into a batch of jobs, the batch is computed on the worker pool (or inline when it holds a
+ * single chart, which saves the wake-up of a worker), and the answers are appended to the output buffers of their
+ * connections. The ephemeris files stay open in every thread for the life of the server.
+ */
+
+#define SERVER_MAX_EVENTS 64
+#define SERVER_INBUF 8192
+
+typedef struct Conn {
+    int fd;
+    int closed;
+    int want_write;    // EPOLLOUT is registered
+    int eof;           // the peer shut down its side: no more reads, close once the answers are sent
+    size_t pending;    // jobs of the current round still to be answered
+    size_t in_len;
+    char in[SERVER_INBUF];
+    char *out;
+    size_t out_len;
+    size_t out_sent;
+    size_t out_cap;
+    struct Conn *next_dead;
+} Conn;
+
+typedef struct {
+    Conn *conn;
+    int json;
+    ServerRequest req;
+    PlanetData chart[NUM_CHART_BODIES];
+    HouseData houses;
+    int status;        // OK, or ERR if a body or the houses failed
+} ServerJob;
+
+typedef struct {
+    int epfd;
+    ServerJob *jobs;
+    size_t njobs;
+    size_t jobs_cap;
+    Conn *dead;        // connections closed during the current round, freed at its end
+} Server;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int set_nonblocking(int fd) {
+    int fl = fcntl(fd, F_GETFL, 0);
+
+    return fl < 0 || fcntl(fd, F_SETFL, fl | O_NONBLOCK) < 0 ? ERR : OK;
+}
+
+/**
+ * @brief Close a connection; it is freed at the end of the round since pending jobs may still point at it
+ */
+static void conn_close(Server *srv, Conn *conn) {
+    if (conn->closed) {
+        return;
+    }
+    epoll_ctl(srv->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->closed = 1;
+    conn->next_dead = srv->dead;
+    srv->dead = conn;
+}
+
+static int out_reserve(Conn *conn, size_t n) {
+    if (conn->out_len + n > conn->out_cap) {
+        size_t cap = conn->out_cap ? conn->out_cap : 4096;
+        char *out;
+
+        while (cap < conn->out_len + n) {
+            cap *= 2;
+        }
+        out = (char *)realloc(conn->out, cap);
+        if (out == NULL) {
+            return ERR;
+        }
+        conn->out = out;
+        conn->out_cap = cap;
+    }
+
+    return OK;
+}
+
+static int out_append(Conn *conn, const void *data, size_t n) {
+    if (out_reserve(conn, n) == ERR) {
+        return ERR;
+    }
+    memcpy(conn->out + conn->out_len, data, n);
+    conn->out_len += n;
+
+    return OK;
+}
+
+static int out_printf(Conn *conn, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    if (out_reserve(conn, 256) == ERR) {
+        return ERR;
+    }
+    va_start(ap, fmt);
+    n = vsnprintf(conn->out + conn->out_len, conn->out_cap - conn->out_len, fmt, ap);
+    va_end(ap);
+
+    // Longer than the reserve: grow and format again
+    if (n >= 0 && (size_t)n >= conn->out_cap - conn->out_len) {
+        if (out_reserve(conn, (size_t)n + 1) == ERR) {
+            return ERR;
+        }
+        va_start(ap, fmt);
+        vsnprintf(conn->out + conn->out_len, conn->out_cap - conn->out_len, fmt, ap);
+        va_end(ap);
+    }
+    if (n < 0) {
+        return ERR;
+    }
+    conn->out_len += (size_t)n;
+
+    return OK;
+}
+
+/**
+ * @brief Register the events a connection waits for: reads until the peer's EOF, writes while output is queued
+ */
+static void conn_watch(Server *srv, Conn *conn) {
+    struct epoll_event ev;
+
+    ev.events = (conn->eof ? 0 : EPOLLIN) | (conn->want_write ? EPOLLOUT : 0);
+    ev.data.ptr = conn;
+    epoll_ctl(srv->epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+/**
+ * @brief Send as much of the output buffer as the socket accepts, and watch for writability if some is left
+ */
+static void conn_flush(Server *srv, Conn *conn) {
+    while (!conn->closed && conn->out_sent < conn->out_len) {
+        ssize_t n = send(conn->fd, conn->out + conn->out_sent, conn->out_len - conn->out_sent, MSG_NOSIGNAL);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                conn_close(srv, conn);
+            }
+            break;
+        }
+        conn->out_sent += (size_t)n;
+    }
+    if (conn->closed) {
+        return;
+    }
+    if (conn->out_sent == conn->out_len) {
+        conn->out_sent = conn->out_len = 0;
+    }
+    if (conn->eof && conn->out_len == 0 && conn->pending == 0) {
+        conn_close(srv, conn);
+        return;
+    }
+
+    if ((conn->out_len > 0) != conn->want_write) {
+        conn->want_write = conn->out_len > 0;
+        conn_watch(srv, conn);
+    }
+}
+
+/**
+ * @brief Find the value of a key in a flat JSON object
+ *
+ * @return const char* The first character of the value, or NULL if the key is missing
+ */
+static const char *json_field(const char *line, const char *key) {
+    size_t len = strlen(key);
+    const char *p = line;
+
+    while ((p = strchr(p, '"')) != NULL) {
+        if (strncmp(p + 1, key, len) == 0 && p[len + 1] == '"') {
+            p += len + 2;
+            while (*p == ' ' || *p == '\t') {
+                p++;
+            }
+            if (*p != ':') {
+                return NULL;
+            }
+            p++;
+            while (*p == ' ' || *p == '\t') {
+                p++;
+            }
+            return p;
+        }
+        p++;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Parse a JSON chart request into a binary one
+ *
+ * @return int OK on success, ERR if "jd" is missing
+ */
+static int parse_json_request(const char *line, ServerRequest *req) {
+    const char *jd = json_field(line, "jd");
+    const char *lat = json_field(line, "lat");
+    const char *lon = json_field(line, "lon");
+    const char *iflags = json_field(line, "iflags");
+    const char *hsys = json_field(line, "hsys");
+
+    if (jd == NULL) {
+        return ERR;
+    }
+
+    memset(req, 0, sizeof(*req));
+    req->magic = SERVER_REQ_MAGIC;
+    req->tjd_ut = strtod(jd, NULL);
+    req->geolat = lat != NULL ? strtod(lat, NULL) : 0.0;
+    req->geolon = lon != NULL ? strtod(lon, NULL) : 0.0;
+    req->iflags = iflags != NULL ? (int32_t)strtol(iflags, NULL, 10) : SEFLG_SWIEPH;
+
+    // Houses need an observer: by default they are computed whenever one is given
+    if (hsys != NULL && hsys[0] == '"') {
+        req->hsys = (uint8_t)hsys[1];
+    } else if (lat != NULL && lon != NULL) {
+        req->hsys = DEFAULT_HOUSE_SYSTEM;
+    }
+
+    return OK;
+}
+
+static int add_job(Server *srv, Conn *conn, int json, const ServerRequest *req) {
+    if (srv->njobs == srv->jobs_cap) {
+        size_t cap = srv->jobs_cap ? srv->jobs_cap * 2 : 64;
+        ServerJob *jobs = (ServerJob *)realloc(srv->jobs, cap * sizeof(ServerJob));
+
+        if (jobs == NULL) {
+            return ERR;
+        }
+        srv->jobs = jobs;
+        srv->jobs_cap = cap;
+    }
+
+    srv->jobs[srv->njobs].conn = conn;
+    srv->jobs[srv->njobs].json = json;
+    srv->jobs[srv->njobs].req = *req;
+    srv->njobs++;
+    conn->pending++;
+
+    return OK;
+}
+
+/**
+ * @brief Turn the complete requests at the start of the input buffer into jobs
+ *
+ * @return int OK, or ERR on a protocol error
+ */
+static int parse_requests(Server *srv, Conn *conn) {
+    size_t pos = 0;
+    int ret = OK;
+
+    while (pos < conn->in_len) {
+        char *p = conn->in + pos;
+        size_t avail = conn->in_len - pos;
+        ServerRequest req;
+
+        if (*p == '{') {
+            char *end = (char *)memchr(p, '\n', avail);
+
+            if (end == NULL) {
+                // A line that cannot fit in the buffer will never complete
+                ret = pos == 0 && avail == SERVER_INBUF ? ERR : OK;
+                break;
+            }
+            *end = '\0';
+
+            // An invalid request still takes its place in the answer order, as a job without magic
+            if (parse_json_request(p, &req) == ERR) {
+                memset(&req, 0, sizeof(req));
+            }
+            if (add_job(srv, conn, 1, &req) == ERR) {
+                ret = ERR;
+                break;
+            }
+            pos += (size_t)(end - p) + 1;
+        } else if ((unsigned char)*p == SERVER_REQ_MAGIC) {
+            if (avail < sizeof(ServerRequest)) {
+                break;
+            }
+            memcpy(&req, p, sizeof(req));
+            if (add_job(srv, conn, 0, &req) == ERR) {
+                ret = ERR;
+                break;
+            }
+            pos += sizeof(ServerRequest);
+        } else if (*p == '\n' || *p == '\r' || *p == ' ') {
+            pos++;
+        } else {
+            ret = ERR;
+            break;
+        }
+    }
+
+    memmove(conn->in, conn->in + pos, conn->in_len - pos);
+    conn->in_len -= pos;
+
+    return ret;
+}
+
+static void conn_read(Server *srv, Conn *conn) {
+    // Reads are no longer watched after EOF, so only a hangup or an error can get here
+    if (conn->eof) {
+        conn_close(srv, conn);
+        return;
+    }
+
+    for (;;) {
+        ssize_t n = read(conn->fd, conn->in + conn->in_len, SERVER_INBUF - conn->in_len);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n < 0) {
+            conn_close(srv, conn);
+            return;
+        }
+        // A half-closed connection still gets the answers to the requests it sent
+        if (n == 0) {
+            conn->eof = 1;
+            conn_watch(srv, conn);
+            conn_flush(srv, conn);
+            return;
+        }
+        conn->in_len += (size_t)n;
+        if (parse_requests(srv, conn) == ERR) {
+            conn_close(srv, conn);
+            return;
+        }
+    }
+}
+
+static void accept_connections(Server *srv, int lfd) {
+    for (;;) {
+        int fd = accept(lfd, NULL, NULL);
+        struct epoll_event ev;
+        Conn *conn;
+
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        conn = (Conn *)calloc(1, sizeof(Conn));
+        if (conn == NULL || set_nonblocking(fd) == ERR) {
+            free(conn);
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(srv->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            free(conn);
+            close(fd);
+        }
+    }
+}
+
+/**
+ * @brief Compute the chart of one job
+ */
+static void compute_job(ServerJob *job) {
+    const ServerRequest *req = &job->req;
+    char serr[256];
+
+    if (req->magic != SERVER_REQ_MAGIC) {
+        job->status = ERR;
+        return;
+    }
+    if (req->iflags & SEFLG_TOPOCTR) {
+        swe_set_topo(req->geolon, req->geolat, 0);
+    }
+
+    job->status = get_chart_data(req->tjd_ut, req->iflags, job->chart);
+    memset(&job->houses, 0, sizeof(job->houses));
+    if (req->hsys == 0 || req->hsys == 'G' || !houses_can_place(req->iflags)) {
+        mark_houses_unknown(job->chart, NUM_CHART_BODIES);
+    } else {
+        uint64_t t0 = instr_start();
+
+        // As in batch mode, a polar fallback to Porphyry still places the bodies
+        if (compute_houses(req->tjd_ut, req->iflags, req->hsys, req->geolat, req->geolon, &job->houses, serr) ==
+            ERR) {
+            job->status = ERR;
+        }
+        if (job->houses.hsys != 0) {
+            place_in_houses(&job->houses, job->chart, NUM_CHART_BODIES);
+        } else {
+            mark_houses_unknown(job->chart, NUM_CHART_BODIES);
+        }
+        instr_stop(STAGE_HOUSES, t0);
+    }
+}
+
+static void job_task(void *ctx, size_t begin, size_t end, int worker) {
+    ServerJob *jobs = (ServerJob *)ctx;
+
+    (void)worker;
+
+    for (size_t i = begin; i < end; i++) {
+        compute_job(&jobs[i]);
+    }
+}
+
+/**
+ * @brief Queue the binary answer of a job
+ *
+ * @return int OK, or ERR if the output buffer could not grow; part of the answer may then be queued
+ */
+static int write_binary_answer(Conn *conn, const ServerJob *job) {
+    ServerResponseHeader hdr;
+    double points[SERVER_NUM_POINTS];
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = SERVER_RESP_MAGIC;
+    hdr.status = job->status == OK ? 0 : 1;
+    hdr.nbodies = NUM_CHART_BODIES;
+    if (out_append(conn, &hdr, sizeof(hdr)) == ERR) {
+        return ERR;
+    }
+
+    for (int i = 0; i < NUM_CHART_BODIES; i++) {
+        const PlanetData *p = &job->chart[i];
+        ServerBody body;
+
+        memset(&body, 0, sizeof(body));
+        body.body = p->body;
+        if (p->body >= 0) {
+            body.sign = p->sign_num;
+            body.house = p->house;
+            body.retrograde = p->retrograde;
+            body.lon = p->pos;
+            body.lat = p->lat;
+            body.speed = p->speed;
+        }
+        if (out_append(conn, &body, sizeof(body)) == ERR) {
+            return ERR;
+        }
+    }
+
+    memcpy(points, &job->houses.cusps[1], 12 * sizeof(double));
+    points[12] = job->houses.ascmc[SE_ASC];
+    points[13] = job->houses.ascmc[SE_MC];
+
+    return out_append(conn, points, sizeof(points));
+}
+
+/**
+ * @brief Queue the JSON answer of a job
+ *
+ * @return int OK, or ERR if the output buffer could not grow; part of the answer may then be queued
+ */
+static int write_json_answer(Conn *conn, const ServerJob *job) {
+    int ret;
+
+    if (job->req.magic != SERVER_REQ_MAGIC) {
+        return out_printf(conn, "{\"status\":\"error\",\"error\":\"missing jd\"}\n");
+    }
+
+    if (out_printf(conn, "{\"jd\":%.9f,\"status\":\"%s\",\"bodies\":[", job->req.tjd_ut,
+                   job->status == OK ? "ok" : "error") == ERR) {
+        return ERR;
+    }
+    for (int i = 0; i < NUM_CHART_BODIES; i++) {
+        const PlanetData *p = &job->chart[i];
+
+        if (p->body < 0) {
+            ret = out_printf(conn, "%s{\"body\":%d,\"error\":true}", i ? "," : "", i);
+        } else {
+            char house[8] = "null";
+
+            // Houses are numbered from 1, as in the batch JSONL output
+            if (p->house != HOUSE_UNKNOWN) {
+                snprintf(house, sizeof(house), "%d", p->house + 1);
+            }
+            ret = out_printf(conn,
+                       "%s{\"body\":%d,\"lon\":%.9f,\"lat\":%.9f,\"speed\":%.9f,\"sign\":%d,\"house\":%s,"
+                       "\"retrograde\":%s}",
+                       i ? "," : "", p->body, p->pos, p->lat, p->speed, p->sign_num, house,
+                       p->retrograde ? "true" : "false");
+        }
+        if (ret == ERR) {
+            return ERR;
+        }
+    }
+    if (out_printf(conn, "]") == ERR) {
+        return ERR;
+    }
+    if (job->req.hsys != 0) {
+        if (out_printf(conn, ",\"asc\":%.9f,\"mc\":%.9f,\"cusps\":[", job->houses.ascmc[SE_ASC],
+                       job->houses.ascmc[SE_MC]) == ERR) {
+            return ERR;
+        }
+        for (int i = 1; i <= 12; i++) {
+            if (out_printf(conn, "%s%.9f", i > 1 ? "," : "", job->houses.cusps[i]) == ERR) {
+                return ERR;
+            }
+        }
+        if (out_printf(conn, "]") == ERR) {
+            return ERR;
+        }
+    }
+
+    return out_printf(conn, "}\n");
+}
+
+/**
+ * @brief Compute the jobs of a round and queue their answers, in request order
+ */
+static void run_jobs(Server *srv, ThreadPool *pool) {
+    if (pool == NULL || srv->njobs == 1) {
+        job_task(srv->jobs, 0, srv->njobs, 0);
+    } else {
+        pool_run(pool, srv->njobs, 1, job_task, srv->jobs);
+    }
+
+    for (size_t i = 0; i < srv->njobs; i++) {
+        Conn *conn = srv->jobs[i].conn;
+        size_t mark = conn->out_len;
+        uint64_t t0;
+        int ret;
+
+        if (conn->closed) {
+            continue;
+        }
+        t0 = instr_start();
+        if (srv->jobs[i].json) {
+            ret = write_json_answer(conn, &srv->jobs[i]);
+        } else {
+            ret = write_binary_answer(conn, &srv->jobs[i]);
+        }
+        instr_stop(STAGE_OUTPUT, t0);
+
+        // A truncated answer would shift every later one on the stream: drop it with the connection
+        if (ret == ERR) {
+            conn->out_len = mark;
+            fprintf(stderr, "Error: out of memory for an answer, closing the connection\n");
+            conn_close(srv, conn);
+        }
+    }
+    for (size_t i = 0; i < srv->njobs; i++) {
+        srv->jobs[i].conn->pending = 0;
+    }
+    for (size_t i = 0; i < srv->njobs; i++) {
+        conn_flush(srv, srv->jobs[i].conn);
+    }
+    srv->njobs = 0;
+}
+
+static int open_listener(const char *path) {
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: socket path too long\n");
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Error: socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    // Replace the socket of an earlier run, never a file that happens to have the name
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "Error: %s exists and is not a socket\n", path);
+            close(fd);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("Error: bind");
+    } else if (listen(fd, SOMAXCONN) < 0) {
+        perror("Error: listen");
+    } else if (set_nonblocking(fd) == ERR) {
+        perror("Error: fcntl");
+    } else {
+        return fd;
+    }
+    close(fd);
+
+    return -1;
+}
+
+/**
+ * @brief Serve chart requests on a listening socket until SIGINT or SIGTERM
+ */
+static int serve(int lfd, ThreadPool *pool) {
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    struct epoll_event ev;
+    Server srv;
+
+    memset(&srv, 0, sizeof(srv));
+    srv.epfd = epoll_create1(0);
+    if (srv.epfd < 0) {
+        perror("Error: epoll_create1");
+        return ERR;
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(srv.epfd, EPOLL_CTL_ADD, lfd, &ev);
+
+    while (!stop_requested) {
+        int n = epoll_wait(srv.epfd, events, SERVER_MAX_EVENTS, -1);
+
+        instr_poll(stderr);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Error: epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            Conn *conn = (Conn *)events[i].data.ptr;
+
+            if (conn == NULL) {
+                accept_connections(&srv, lfd);
+                continue;
+            }
+            if (!conn->closed && (events[i].events & EPOLLOUT)) {
+                conn_flush(&srv, conn);
+            }
+            if (!conn->closed && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                conn_read(&srv, conn);
+            }
+        }
+
+        if (srv.njobs > 0) {
+            run_jobs(&srv, pool);
+        }
+
+        while (srv.dead != NULL) {
+            Conn *next = srv.dead->next_dead;
+
+            free(srv.dead->out);
+            free(srv.dead);
+            srv.dead = next;
+        }
+    }
+
+    // Live connections are closed when the process exits
+    close(srv.epfd);
+    free(srv.jobs);
+
+    return OK;
+}
+
+/**
+ * @brief Entry point of the server mode
+ *
+ * main serve <socket_path> [-e ephe_path] [-c cheb_file] [-C entries] [-t table] [-j threads] [-I]
+ *
+ * With -I every stage is timed; the counters are dumped on SIGUSR1 and at exit.
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int serve_main(int argc, char **argv) {
+    int nthreads = 0;
+    WorkerConfig cfg;
+    ThreadPool *pool = NULL;
+    ChebFile *cheb = NULL;
+    EphTable *tab = NULL;
+    CalcCache *cache = NULL;
+    struct sigaction sa;
+    char serr[256];
+    int lfd, ret;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: main serve <socket_path> [-e ephe_path] [-c cheb_file] [-C entries] [-t table] "
+                        "[-j threads] [-I]\n");
+        return 1;
+    }
+
+    worker_config_init(&cfg);
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-I") == 0) {
+            instr_enable();
+        } else if (i + 1 == argc) {
+            break;
+        } else if (strcmp(argv[i], "-e") == 0) {
+            cfg.ephe_path = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0) {
+            cheb_close(cheb);
+            if ((cheb = cheb_open(argv[++i], serr)) == NULL) {
+                fprintf(stderr, "Error: %s\n", serr);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-C") == 0) {
+            long entries = atol(argv[++i]);
+
+            calc_cache_destroy(cache);
+            cache = entries < 0 ? NULL : calc_cache_create((size_t)entries, 0);
+            if (cache == NULL) {
+                fprintf(stderr, "Error: cannot create a cache of %s entries\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-t") == 0) {
+            ephtab_close(tab);
+            if ((tab = ephtab_open(argv[++i], serr)) == NULL) {
+                fprintf(stderr, "Error: %s\n", serr);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-j") == 0) {
+            nthreads = atoi(argv[++i]);
+        }
+    }
+
+    // The I/O thread computes single requests itself, so it gets the same settings as the workers
+    worker_config_apply(&cfg);
+    if (nthreads != 1) {
+        pool = pool_create(nthreads, &cfg);
+        if (pool == NULL) {
+            fprintf(stderr, "Error: cannot start worker threads\n");
+            return 1;
+        }
+    }
+
+    lfd = open_listener(argv[1]);
+    if (lfd < 0) {
+        pool_destroy(pool);
+        return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    set_cheb_cache(cheb);
+    set_ephtab(tab);
+    set_calc_cache(cache);
+    ret = serve(lfd, pool);
+    set_calc_cache(NULL);
+    set_ephtab(NULL);
+    set_cheb_cache(NULL);
+
+    close(lfd);
+    unlink(argv[1]);
+    pool_destroy(pool);
+    ephtab_close(tab);
+    cheb_close(cheb);
+    if (cache != NULL) {
+        calc_cache_print_stats(cache, stderr);
+        calc_cache_destroy(cache);
+    }
+    if (instr_enabled) {
+        instr_dump(stderr);
+    }
+    swe_close();
+
+    return ret == OK ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+
+/*
+ * Wire format of the chart server
+ *
+ * A request is either one binary ServerRequest or one JSON object on a single line, e.g.
+ *   {"jd": 2451545.0, "lat": 45.46, "lon": 9.19, "iflags": 258, "hsys": "P"}
+ * and gets an answer in the same encoding. Binary messages use the native byte order of the server. Answers come
+ * back in request order; a connection must stay open until it has read all of them.
+ */
+
+#define SERVER_REQ_MAGIC 0xC5
+#define SERVER_RESP_MAGIC 0xC6
+
+// Binary chart request, 32 bytes
+typedef struct {
+    uint8_t magic;    // SERVER_REQ_MAGIC; a JSON request starts with '{' instead
+    uint8_t hsys;     // house system letter, 0 for no houses
+    uint16_t reserved;
+    int32_t iflags;   // flags for the Swiss Ephemeris
+    double tjd_ut;    // Julian Day in Universal Time
+    double geolat;    // observer latitude, used for houses and topocentric positions
+    double geolon;    // observer longitude, east positive
+} ServerRequest;
+
+// Header of a binary chart answer, followed by nbodies ServerBody and SERVER_NUM_POINTS doubles
+typedef struct {
+    uint8_t magic;    // SERVER_RESP_MAGIC
+    uint8_t status;   // 0 on success, 1 if a body or the houses could not be computed
+    uint16_t nbodies;
+    int32_t reserved;
+} ServerResponseHeader;
+
+// One body of a binary chart answer, 32 bytes
+typedef struct {
+    int32_t body;     // planet ID, -1 if the calculation failed
+    uint8_t sign;
+    uint8_t house;    // 0 for the first house, 255 if unknown or not requested
+    uint8_t retrograde;
+    uint8_t reserved;
+    double lon;
+    double lat;
+    double speed;
+} ServerBody;
+
+// House cusps 1 to 12, then ascendant and midheaven; all zero when no houses were requested
+#define SERVER_NUM_POINTS 14
+
+int serve_main(int argc, char **argv);
+
+#endif
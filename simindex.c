@@ -0,0 +1,753 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "simindex.h"
+#include "batch.h"
+#include "cpu.h"
+#include "houses.h"
+#include "planet.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Chart similarity index
+ *
+ * Every chart is encoded as a feature vector: the cosine and sine of each body's longitude, and optionally of the
+ * ascendant and midheaven, quantized to int8 (127 for 1.0). The squared distance between two such vectors is a sum
+ * of 2 - 2 cos(difference) over the points, so it grows with the angular distance of every body and wraps
+ * correctly at 0/360 degrees. Vectors are padded to SIMINDEX_DIM bytes, one AVX2 register, and compared with an
+ * AVX2 kernel selected at run time (a scalar fallback gives the same integers).
+ *
+ * The records are stored sorted by bucket, Sun sign times 12 plus Moon sign. An exact search scans every record;
+ * an approximate search scans the query's bucket and its neighbours (Sun and Moon one sign either way), about a
+ * sixteenth of the index. Either scan is cut into blocks of SIMINDEX_BLOCK records that run on the pool, each
+ * worker keeping its own k best, merged at the end. The file is opened with mmap like the ephemeris table.
+ *
+ * Layout (native byte order): SimIndexHeader, then the vectors, the record numbers (int64) and the Julian Days
+ * (double) of the records, each section starting at a SIMINDEX_ALIGN boundary.
+ */
+
+#define SIMINDEX_MAGIC "CKRSIDX1"
+#define SIMINDEX_VERSION 1
+#define SIMINDEX_ALIGN 64
+
+// Distances computed per kernel call before the k best are updated
+#define SIMINDEX_BATCH 256
+
+typedef struct {
+    char magic[8];
+    int32 version;
+    int32 angles; // non-zero if the ascendant and midheaven follow the bodies
+    int64 nrecords;
+    int64 file_size;
+    int64 vectors_offset;
+    int64 records_offset;
+    int64 jd_offset;
+    int64 buckets[SIMINDEX_BUCKETS + 1]; // first record of each bucket, then nrecords
+} SimIndexHeader;
+
+struct SimIndex {
+    const unsigned char *map;
+    size_t size;
+    const SimIndexHeader *header;
+    const signed char *vectors;
+    const int64 *records;
+    const double *jd;
+};
+
+/**
+ * @brief Round a file offset up to the section alignment
+ */
+static int64 align_offset(int64 offset) { return (offset + SIMINDEX_ALIGN - 1) / SIMINDEX_ALIGN * SIMINDEX_ALIGN; }
+
+static void encode_angle(double lon, signed char *v) {
+    double r = lon * DEGTORAD;
+
+    v[0] = (signed char)lrint(127.0 * cos(r));
+    v[1] = (signed char)lrint(127.0 * sin(r));
+}
+
+/**
+ * @brief Compute the feature vector and the bucket of a chart
+ *
+ * @param tjd_ut The Julian Day (UT)
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param geo The geographic latitude and longitude, or NULL to leave the angles out
+ * @param vec The SIMINDEX_DIM bytes of the vector
+ * @param bucket The bucket
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR if a body or the houses failed; the failed points are encoded as zero
+ */
+static int chart_features(double tjd_ut, int iflags, const double *geo, signed char *vec, int *bucket, char *serr) {
+    int ret = OK;
+    int sign[2] = {0, 0};
+
+    memset(vec, 0, SIMINDEX_DIM);
+    for (int b = 0; b < SIMINDEX_BODIES; b++) {
+        double xx[6];
+
+        if (swe_calc_ut(tjd_ut, b, iflags, xx, serr) == ERR) {
+            ret = ERR;
+            continue;
+        }
+        encode_angle(xx[0], &vec[2 * b]);
+        if (b <= SE_MOON) {
+            sign[b] = get_sign_number(xx[0]);
+        }
+    }
+
+    if (geo != NULL) {
+        HouseData h;
+
+        // The ascendant and midheaven do not depend on the house system, so a polar fallback still gives them
+        if (compute_houses(tjd_ut, iflags, DEFAULT_HOUSE_SYSTEM, geo[0], geo[1], &h, serr) == ERR && h.hsys == 0) {
+            ret = ERR;
+        } else {
+            encode_angle(h.ascmc[SE_ASC], &vec[2 * SIMINDEX_BODIES]);
+            encode_angle(h.ascmc[SE_MC], &vec[2 * SIMINDEX_BODIES + 2]);
+        }
+    }
+
+    *bucket = sign[SE_SUN] * NUM_SIGNS + sign[SE_MOON];
+
+    return ret;
+}
+
+typedef struct {
+    const double *tjd_ut;
+    const double *geo;
+    const int *iflags;
+    int angles;
+    signed char *vectors;
+    int *buckets;
+    unsigned char *failed;
+} BuildCtx;
+
+static void build_task(void *ctx, size_t begin, size_t end, int worker) {
+    BuildCtx *c = (BuildCtx *)ctx;
+    char serr[256];
+
+    (void)worker;
+
+    for (size_t i = begin; i < end; i++) {
+        c->failed[i] = chart_features(c->tjd_ut[i], c->iflags[i], c->angles ? &c->geo[2 * i] : NULL,
+                                      &c->vectors[i * SIMINDEX_DIM], &c->buckets[i], serr) == ERR;
+        if (c->failed[i]) {
+            fprintf(stderr, "Error: record %zu: %s\n", i + 1, serr);
+        }
+    }
+}
+
+static int write_padding(FILE *fp, int64 from, int64 to) {
+    static const char zeros[SIMINDEX_ALIGN];
+
+    return to > from && fwrite(zeros, 1, (size_t)(to - from), fp) != (size_t)(to - from) ? ERR : OK;
+}
+
+/**
+ * @brief Build a similarity index file
+ *
+ * @param path The index file
+ * @param tjd_ut The Julian Days (UT) of the charts
+ * @param geo The latitude and longitude of every chart (2 * n values), used for the angles
+ * @param iflags The flags of every chart
+ * @param n The number of charts
+ * @param angles Non-zero to encode the ascendant and midheaven
+ * @param pool The pool to compute the charts on, or NULL for the calling thread
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR otherwise; no index is written if any chart fails
+ */
+int simindex_build(const char *path, const double *tjd_ut, const double *geo, const int *iflags, int64 n, int angles,
+                   ThreadPool *pool, char *serr) {
+    SimIndexHeader header;
+    BuildCtx ctx = {tjd_ut, geo, iflags, angles, NULL, NULL, NULL};
+    int64 *order = (int64 *)malloc((n + 1) * sizeof(int64));
+    int64 next[SIMINDEX_BUCKETS];
+    int64 nfailed = 0;
+    int ret = OK;
+    FILE *fp;
+
+    ctx.vectors = (signed char *)malloc((n + 1) * SIMINDEX_DIM);
+    ctx.buckets = (int *)malloc((n + 1) * sizeof(int));
+    ctx.failed = (unsigned char *)malloc((size_t)n + 1);
+    if (order == NULL || ctx.vectors == NULL || ctx.buckets == NULL || ctx.failed == NULL) {
+        strcpy(serr, "out of memory");
+        free(order);
+        free(ctx.vectors);
+        free(ctx.buckets);
+        free(ctx.failed);
+        return ERR;
+    }
+
+    if (pool != NULL) {
+        pool_run(pool, (size_t)n, 0, build_task, &ctx);
+    } else {
+        build_task(&ctx, 0, (size_t)n, 0);
+    }
+
+    // A chart with missing features would be matched on garbage: refuse to write the index
+    for (int64 i = 0; i < n; i++) {
+        nfailed += ctx.failed[i];
+    }
+
+    // Counting sort by bucket; records keep their input order within a bucket
+    memset(&header, 0, sizeof(header));
+    for (int64 i = 0; i < n; i++) {
+        header.buckets[ctx.buckets[i] + 1]++;
+    }
+    for (int b = 0; b < SIMINDEX_BUCKETS; b++) {
+        header.buckets[b + 1] += header.buckets[b];
+        next[b] = header.buckets[b];
+    }
+    for (int64 i = 0; i < n; i++) {
+        order[next[ctx.buckets[i]]++] = i;
+    }
+
+    memcpy(header.magic, SIMINDEX_MAGIC, sizeof(header.magic));
+    header.version = SIMINDEX_VERSION;
+    header.angles = angles;
+    header.nrecords = n;
+    header.vectors_offset = align_offset(sizeof(header));
+    header.records_offset = align_offset(header.vectors_offset + n * SIMINDEX_DIM);
+    header.jd_offset = align_offset(header.records_offset + n * (int64)sizeof(int64));
+    header.file_size = header.jd_offset + n * (int64)sizeof(double);
+
+    if (nfailed > 0) {
+        sprintf(serr, "%lld charts could not be computed", (long long)nfailed);
+        ret = ERR;
+    } else if ((fp = fopen(path, "wb")) == NULL) {
+        sprintf(serr, "cannot create %.200s", path);
+        ret = ERR;
+    } else {
+        if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+            write_padding(fp, sizeof(header), header.vectors_offset) == ERR) {
+            ret = ERR;
+        }
+        for (int64 i = 0; i < n && ret == OK; i++) {
+            if (fwrite(&ctx.vectors[order[i] * SIMINDEX_DIM], SIMINDEX_DIM, 1, fp) != 1) {
+                ret = ERR;
+            }
+        }
+        if (ret == OK && write_padding(fp, header.vectors_offset + n * SIMINDEX_DIM, header.records_offset) == ERR) {
+            ret = ERR;
+        }
+        for (int64 i = 0; i < n && ret == OK; i++) {
+            int64 record = order[i] + 1;
+
+            if (fwrite(&record, sizeof(record), 1, fp) != 1) {
+                ret = ERR;
+            }
+        }
+        if (ret == OK &&
+            write_padding(fp, header.records_offset + n * (int64)sizeof(int64), header.jd_offset) == ERR) {
+            ret = ERR;
+        }
+        for (int64 i = 0; i < n && ret == OK; i++) {
+            if (fwrite(&tjd_ut[order[i]], sizeof(double), 1, fp) != 1) {
+                ret = ERR;
+            }
+        }
+        if (fclose(fp) != 0) {
+            ret = ERR;
+        }
+        if (ret == ERR) {
+            sprintf(serr, "cannot write %.200s", path);
+        }
+    }
+
+    free(order);
+    free(ctx.vectors);
+    free(ctx.buckets);
+    free(ctx.failed);
+
+    return ret;
+}
+
+/**
+ * @brief Tell whether a section of count items of width bytes at offset lies after the header and within the file
+ */
+static int section_fits(int64 offset, int64 count, int64 width, int64 size) {
+    return offset >= (int64)sizeof(SimIndexHeader) && offset % SIMINDEX_ALIGN == 0 && offset <= size &&
+           count <= (size - offset) / width;
+}
+
+/**
+ * @brief Tell whether the buckets start at record 0, never go back and end at nrecords
+ */
+static int buckets_valid(const SimIndexHeader *h) {
+    if (h->buckets[0] != 0 || h->buckets[SIMINDEX_BUCKETS] != h->nrecords) {
+        return 0;
+    }
+    for (int b = 0; b < SIMINDEX_BUCKETS; b++) {
+        if (h->buckets[b + 1] < h->buckets[b]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Open a similarity index
+ *
+ * @param path The index file
+ * @param serr Error buffer (at least 256 bytes)
+ * @return SimIndex* The index, or NULL on error
+ */
+SimIndex *simindex_open(const char *path, char *serr) {
+    SimIndex *idx;
+    struct stat st;
+    void *map;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        sprintf(serr, "cannot open %.200s", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(SimIndexHeader)) {
+        sprintf(serr, "%.200s is not a similarity index", path);
+        close(fd);
+        return NULL;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        sprintf(serr, "cannot map %.200s", path);
+        return NULL;
+    }
+
+    idx = (SimIndex *)calloc(1, sizeof(SimIndex));
+    if (idx == NULL) {
+        munmap(map, (size_t)st.st_size);
+        strcpy(serr, "out of memory");
+        return NULL;
+    }
+    idx->map = (const unsigned char *)map;
+    idx->size = (size_t)st.st_size;
+    idx->header = (const SimIndexHeader *)map;
+
+    if (memcmp(idx->header->magic, SIMINDEX_MAGIC, sizeof(idx->header->magic)) != 0 ||
+        idx->header->version != SIMINDEX_VERSION || idx->header->file_size != (int64)st.st_size ||
+        idx->header->nrecords < 0 || !buckets_valid(idx->header) ||
+        !section_fits(idx->header->vectors_offset, idx->header->nrecords, SIMINDEX_DIM, idx->header->file_size) ||
+        !section_fits(idx->header->records_offset, idx->header->nrecords, sizeof(int64), idx->header->file_size) ||
+        !section_fits(idx->header->jd_offset, idx->header->nrecords, sizeof(double), idx->header->file_size)) {
+        sprintf(serr, "%.200s is not a valid similarity index", path);
+        simindex_close(idx);
+        return NULL;
+    }
+    idx->vectors = (const signed char *)(idx->map + idx->header->vectors_offset);
+    idx->records = (const int64 *)(idx->map + idx->header->records_offset);
+    idx->jd = (const double *)(idx->map + idx->header->jd_offset);
+
+    return idx;
+}
+
+/**
+ * @brief Close a similarity index
+ *
+ * @param idx The index, or NULL
+ */
+void simindex_close(SimIndex *idx) {
+    if (idx == NULL) {
+        return;
+    }
+    munmap((void *)idx->map, idx->size);
+    free(idx);
+}
+
+/**
+ * @brief Compute the feature vector and bucket of a query chart, encoded like the index
+ *
+ * @param idx The index
+ * @param tjd_ut The Julian Day (UT)
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param geo The geographic latitude and longitude; needed if the index encodes the angles
+ * @param vec The SIMINDEX_DIM bytes of the vector
+ * @param bucket The bucket
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int OK on success, ERR otherwise
+ */
+int simindex_features(const SimIndex *idx, double tjd_ut, int iflags, const double *geo, signed char *vec,
+                      int *bucket, char *serr) {
+    if (idx->header->angles && geo == NULL) {
+        strcpy(serr, "the index encodes the angles: the query needs a location");
+        return ERR;
+    }
+
+    return chart_features(tjd_ut, iflags, idx->header->angles ? geo : NULL, vec, bucket, serr);
+}
+
+/**
+ * @brief Scalar kernel: squared distances between the query and n vectors
+ */
+static void distances_scalar(const signed char *q, const signed char *vecs, size_t n, int32 *out) {
+    for (size_t i = 0; i < n; i++) {
+        const signed char *v = &vecs[i * SIMINDEX_DIM];
+        int32 sum = 0;
+
+        for (int d = 0; d < SIMINDEX_DIM; d++) {
+            int32 diff = (int32)q[d] - v[d];
+
+            sum += diff * diff;
+        }
+        out[i] = sum;
+    }
+}
+
+#ifdef HAVE_AVX2_KERNEL
+/**
+ * @brief AVX2 kernel, same contract and results as distances_scalar()
+ */
+__attribute__((target("avx2"))) static void distances_avx2(const signed char *q, const signed char *vecs, size_t n,
+                                                           int32 *out) {
+    const __m256i qv = _mm256_loadu_si256((const __m256i *)q);
+    const __m256i q_lo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(qv));
+    const __m256i q_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(qv, 1));
+
+    for (size_t i = 0; i < n; i++) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)&vecs[i * SIMINDEX_DIM]);
+        __m256i d_lo = _mm256_sub_epi16(q_lo, _mm256_cvtepi8_epi16(_mm256_castsi256_si128(v)));
+        __m256i d_hi = _mm256_sub_epi16(q_hi, _mm256_cvtepi8_epi16(_mm256_extracti128_si256(v, 1)));
+        __m256i s = _mm256_add_epi32(_mm256_madd_epi16(d_lo, d_lo), _mm256_madd_epi16(d_hi, d_hi));
+        __m128i h = _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+
+        h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+        h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+        out[i] = _mm_cvtsi128_si32(h);
+    }
+}
+#endif
+
+/**
+ * @brief Compute the distances with the best kernel the CPU supports
+ */
+static void distances(const signed char *q, const signed char *vecs, size_t n, int32 *out) {
+#ifdef HAVE_AVX2_KERNEL
+    if (cpu_has_avx2()) {
+        distances_avx2(q, vecs, n, out);
+        return;
+    }
+#endif
+    distances_scalar(q, vecs, n, out);
+}
+
+// Candidate of a k best list; ties on the distance go to the earlier record so that results do not depend on threads
+typedef struct {
+    int32 dist;
+    int64 index;
+} Candidate;
+
+static int worse(const Candidate *a, const Candidate *b) {
+    return a->dist != b->dist ? a->dist > b->dist : a->index > b->index;
+}
+
+/**
+ * @brief Offer a candidate to a k best list kept as a max-heap on (dist, index)
+ */
+static void heap_offer(Candidate *heap, int *n, int k, Candidate c) {
+    int i;
+
+    if (*n < k) {
+        i = (*n)++;
+        while (i > 0 && worse(&c, &heap[(i - 1) / 2])) {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = c;
+        return;
+    }
+    if (!worse(&heap[0], &c)) {
+        return;
+    }
+
+    // Replace the worst and sift down
+    i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+
+        if (child >= k) {
+            break;
+        }
+        if (child + 1 < k && worse(&heap[child + 1], &heap[child])) {
+            child++;
+        }
+        if (!worse(&heap[child], &c)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = c;
+}
+
+static int compare_candidates(const void *a, const void *b) {
+    const Candidate *ca = (const Candidate *)a, *cb = (const Candidate *)b;
+
+    return worse(ca, cb) - worse(cb, ca);
+}
+
+typedef struct {
+    int64 start;
+    int64 end;
+} ScanBlock;
+
+typedef struct {
+    const SimIndex *idx;
+    const signed char *query;
+    const ScanBlock *blocks;
+    int k;
+    Candidate *heaps; // k per worker
+    int *sizes;       // per worker
+} SearchCtx;
+
+static void search_task(void *ctx, size_t begin, size_t end, int worker) {
+    SearchCtx *s = (SearchCtx *)ctx;
+    Candidate *heap = &s->heaps[(size_t)worker * s->k];
+    int32 dist[SIMINDEX_BATCH];
+
+    for (size_t b = begin; b < end; b++) {
+        for (int64 i = s->blocks[b].start; i < s->blocks[b].end; i += SIMINDEX_BATCH) {
+            int64 n = s->blocks[b].end - i < SIMINDEX_BATCH ? s->blocks[b].end - i : SIMINDEX_BATCH;
+
+            distances(s->query, &s->idx->vectors[i * SIMINDEX_DIM], (size_t)n, dist);
+            for (int64 j = 0; j < n; j++) {
+                Candidate c = {dist[j], i + j};
+
+                heap_offer(heap, &s->sizes[worker], s->k, c);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Find the k charts of the index closest to a query vector
+ *
+ * @param idx The index
+ * @param query The SIMINDEX_DIM bytes of the query vector
+ * @param bucket The bucket of the query
+ * @param exact Non-zero to scan every record, zero to scan the query's bucket and its neighbours only
+ * @param k The number of results wanted
+ * @param pool The pool to spread the scan over, or NULL for the calling thread
+ * @param out Storage for k results, closest first
+ * @return int The number of results, or ERR if out of memory
+ */
+int simindex_search(const SimIndex *idx, const signed char *query, int bucket, int exact, int k, ThreadPool *pool,
+                    SimMatch *out) {
+    const int64 *buckets = idx->header->buckets;
+    int nworkers = pool != NULL ? pool_size(pool) : 1;
+    ScanBlock *blocks;
+    size_t nblocks = 0;
+    SearchCtx ctx;
+    int nfound = 0;
+
+    if (k <= 0) {
+        return 0;
+    }
+
+    // Every range is cut into blocks; at most 9 ranges for an approximate search
+    blocks = (ScanBlock *)malloc((idx->header->nrecords / SIMINDEX_BLOCK + 10) * sizeof(ScanBlock));
+    ctx.heaps = (Candidate *)malloc((size_t)nworkers * k * sizeof(Candidate));
+    ctx.sizes = (int *)calloc(nworkers, sizeof(int));
+    if (blocks == NULL || ctx.heaps == NULL || ctx.sizes == NULL) {
+        free(blocks);
+        free(ctx.heaps);
+        free(ctx.sizes);
+        return ERR;
+    }
+
+    for (int r = 0; r < (exact ? 1 : 9); r++) {
+        int64 start, end;
+
+        if (exact) {
+            start = 0;
+            end = idx->header->nrecords;
+        } else {
+            int sun = (bucket / NUM_SIGNS + r / 3 - 1 + NUM_SIGNS) % NUM_SIGNS;
+            int moon = (bucket % NUM_SIGNS + r % 3 - 1 + NUM_SIGNS) % NUM_SIGNS;
+
+            start = buckets[sun * NUM_SIGNS + moon];
+            end = buckets[sun * NUM_SIGNS + moon + 1];
+        }
+        for (int64 s = start; s < end; s += SIMINDEX_BLOCK) {
+            blocks[nblocks].start = s;
+            blocks[nblocks].end = end - s < SIMINDEX_BLOCK ? end : s + SIMINDEX_BLOCK;
+            nblocks++;
+        }
+    }
+
+    ctx.idx = idx;
+    ctx.query = query;
+    ctx.blocks = blocks;
+    ctx.k = k;
+    if (pool != NULL) {
+        pool_run(pool, nblocks, 1, search_task, &ctx);
+    } else {
+        search_task(&ctx, 0, nblocks, 0);
+    }
+
+    // Merge the per-worker lists into the first one
+    for (int w = 1; w < nworkers; w++) {
+        for (int i = 0; i < ctx.sizes[w]; i++) {
+            heap_offer(ctx.heaps, &ctx.sizes[0], k, ctx.heaps[(size_t)w * k + i]);
+        }
+    }
+    nfound = ctx.sizes[0];
+    qsort(ctx.heaps, nfound, sizeof(Candidate), compare_candidates);
+    for (int i = 0; i < nfound; i++) {
+        out[i].dist = ctx.heaps[i].dist;
+        out[i].record = idx->records[ctx.heaps[i].index];
+        out[i].tjd_ut = idx->jd[ctx.heaps[i].index];
+    }
+
+    free(blocks);
+    free(ctx.heaps);
+    free(ctx.sizes);
+
+    return nfound;
+}
+
+/**
+ * @brief Print the usage of the similar mode
+ */
+static void simindex_usage(void) {
+    fprintf(stderr, "Usage: main similar build <records> <index> [-a] [-f iflags] [-j threads]\n"
+                    "       main similar query <index> <record> [-k count] [-x] [-f iflags] [-j threads]\n"
+                    "  -a             also encode the ascendant and midheaven\n"
+                    "  -k count       number of results, 10 by default\n"
+                    "  -x             exact search over every chart instead of the neighbouring buckets\n");
+}
+
+/**
+ * @brief Entry point of the similar mode
+ *
+ * "build" encodes every birth record of a file (batch format) into an index file; "query" prints the charts of
+ * an index closest to one birth record, given as a single argument in the same format.
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int simindex_main(int argc, char **argv) {
+    int iflags = SEFLG_SWIEPH;
+    int nthreads = 1;
+    int angles = 0, exact = 0, k = 10;
+    ThreadPool *pool = NULL;
+    char serr[256];
+    int ret = 0;
+
+    if (argc < 4 || (strcmp(argv[1], "build") != 0 && strcmp(argv[1], "query") != 0)) {
+        simindex_usage();
+        return 1;
+    }
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "-a") == 0) {
+            angles = 1;
+        } else if (strcmp(argv[i], "-x") == 0) {
+            exact = 1;
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            k = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            iflags = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        } else {
+            simindex_usage();
+            return 1;
+        }
+    }
+    if (nthreads != 1) {
+        pool = pool_create(nthreads, NULL);
+    }
+
+    if (strcmp(argv[1], "build") == 0) {
+        BirthRecord *recs;
+        double *tjd_ut, *geo;
+        int *flags;
+        long nskipped;
+        long n = read_birth_file(argv[2], iflags, &recs, &tjd_ut, &nskipped);
+
+        if (n < 0) {
+            pool_destroy(pool);
+            return 1;
+        }
+        // Matches are reported by record number, which a skipped record would shift
+        if (nskipped > 0) {
+            fprintf(stderr, "Error: %ld malformed records, no index written\n", nskipped);
+            free(recs);
+            free(tjd_ut);
+            pool_destroy(pool);
+            return 1;
+        }
+        geo = (double *)malloc((2 * n + 1) * sizeof(double));
+        flags = (int *)malloc((n + 1) * sizeof(int));
+        if (geo == NULL || flags == NULL) {
+            fprintf(stderr, "Error: out of memory\n");
+            ret = 1;
+        } else {
+            for (long i = 0; i < n; i++) {
+                geo[2 * i] = recs[i].lat;
+                geo[2 * i + 1] = recs[i].lon;
+                flags[i] = recs[i].iflags;
+            }
+            if (simindex_build(argv[3], tjd_ut, geo, flags, n, angles, pool, serr) == ERR) {
+                fprintf(stderr, "Error: %s\n", serr);
+                ret = 1;
+            } else {
+                printf("Indexed %ld charts into %s\n", n, argv[3]);
+            }
+        }
+        free(recs);
+        free(tjd_ut);
+        free(geo);
+        free(flags);
+    } else {
+        SimIndex *idx = simindex_open(argv[2], serr);
+        SimMatch *matches = (SimMatch *)malloc((k > 0 ? k : 1) * sizeof(SimMatch));
+        signed char query[SIMINDEX_DIM];
+        BirthRecord rec;
+        double tjd_ut, geo[2];
+        int bucket, nfound;
+
+        if (matches == NULL) {
+            strcpy(serr, "out of memory");
+        }
+        if (idx == NULL || matches == NULL || parse_birth_record(argv[3], iflags, &rec, serr) == ERR ||
+            birth_record_to_jd(&rec, &tjd_ut, serr) == ERR) {
+            fprintf(stderr, "Error: %s\n", serr);
+            ret = 1;
+        } else {
+            geo[0] = rec.lat;
+            geo[1] = rec.lon;
+            if (simindex_features(idx, tjd_ut, rec.iflags, geo, query, &bucket, serr) == ERR) {
+                fprintf(stderr, "Error: %s\n", serr);
+                ret = 1;
+            } else if ((nfound = simindex_search(idx, query, bucket, exact, k, pool, matches)) == ERR) {
+                fprintf(stderr, "Error: out of memory\n");
+                ret = 1;
+            } else {
+                for (int i = 0; i < nfound; i++) {
+                    printf("%d. record %lld, Julian Day %.6f, distance %d\n", i + 1, (long long)matches[i].record,
+                           matches[i].tjd_ut, (int)matches[i].dist);
+                }
+            }
+        }
+        free(matches);
+        simindex_close(idx);
+    }
+
+    pool_destroy(pool);
+    swe_close();
+
+    return ret;
+}
@@ -0,0 +1,39 @@
+#ifndef SIMINDEX_H
+#define SIMINDEX_H
+
+#include "pool.h"
+#include "swephexp.h"
+
+// Bodies encoded per chart: SE_SUN to SE_PLUTO
+#define SIMINDEX_BODIES (SE_PLUTO + 1)
+
+// Bytes per feature vector: a cosine and a sine per body and per angle, padded to one AVX2 register
+#define SIMINDEX_DIM 32
+
+// Charts are bucketed by Sun sign and Moon sign
+#define SIMINDEX_BUCKETS 144
+
+// Records scanned per pool item
+#define SIMINDEX_BLOCK 16384
+
+typedef struct SimIndex SimIndex;
+
+// One search result; a smaller distance is a more similar chart
+typedef struct {
+    int32 dist;    // squared distance between the feature vectors
+    int64 record;  // position of the chart in the file the index was built from, from 1
+    double tjd_ut; // Julian Day (UT) of the chart
+} SimMatch;
+
+int simindex_build(const char *path, const double *tjd_ut, const double *geo, const int *iflags, int64 n, int angles,
+                   ThreadPool *pool, char *serr);
+SimIndex *simindex_open(const char *path, char *serr);
+void simindex_close(SimIndex *idx);
+int simindex_features(const SimIndex *idx, double tjd_ut, int iflags, const double *geo, signed char *vec,
+                      int *bucket, char *serr);
+int simindex_search(const SimIndex *idx, const signed char *query, int bucket, int exact, int k, ThreadPool *pool,
+                    SimMatch *out);
+
+int simindex_main(int argc, char **argv);
+
+#endif
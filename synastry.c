@@ -0,0 +1,465 @@
+#include "synastry.h"
+#include "batch.h"
+#include "cpu.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Synastry engine
+ *
+ * One chart is compared with every chart of a ChartSet. For each body i of the chart and body j of the set, one
+ * kernel call runs over the contiguous longitudes of body j in all candidates: it folds the separation to
+ * [0, 180], keeps the closest aspect within its orb and adds that aspect's score to the candidate. The kernel has
+ * an AVX2 version, selected at run time, and a scalar fallback with identical results; failed bodies are NAN and
+ * fail every comparison, so there are no branches. The candidates are split into chunks of SYNASTRY_CHUNK that
+ * run on the pool, and every chunk makes all its body pairs while its longitudes are in cache.
+ */
+
+// Harmonious aspects score positive and hard ones negative, per default_aspects
+const double default_synastry_weights[] = {1.0, 0.25, 0.75, -0.75, 1.0, -0.25, -0.5};
+
+// The aspect set in the form the kernels use
+typedef struct {
+    int naspects;
+    double angle[SYNASTRY_MAX_ASPECTS];
+    double orb[SYNASTRY_MAX_ASPECTS];
+    double inv_orb[SYNASTRY_MAX_ASPECTS];
+    double weight[SYNASTRY_MAX_ASPECTS];
+} AspectTable;
+
+/**
+ * @brief Allocate a chart set
+ *
+ * @param set The chart set
+ * @param nbodies The bodies per chart (planet IDs 0 to nbodies - 1), at most SYNASTRY_MAX_BODIES
+ * @param cap The largest number of charts
+ * @return int OK on success, ERR on invalid arguments or out of memory
+ */
+int chart_set_init(ChartSet *set, int nbodies, size_t cap) {
+    memset(set, 0, sizeof(*set));
+    if (nbodies <= 0 || nbodies > SYNASTRY_MAX_BODIES) {
+        return ERR;
+    }
+
+    set->nbodies = nbodies;
+    set->cap = cap;
+    set->lon = (double *)malloc((size_t)nbodies * (cap > 0 ? cap : 1) * sizeof(double));
+
+    return set->lon != NULL ? OK : ERR;
+}
+
+/**
+ * @brief Release a chart set
+ *
+ * @param set The chart set
+ */
+void chart_set_free(ChartSet *set) {
+    free(set->lon);
+    memset(set, 0, sizeof(*set));
+}
+
+/**
+ * @brief Store a chart at a given index, e.g. from a worker thread; the caller sets ncharts
+ *
+ * @param set The chart set
+ * @param c The index, below the capacity
+ * @param chart The planet data, indexed by planet ID
+ */
+void chart_set_store(ChartSet *set, size_t c, const PlanetData *chart) {
+    for (int b = 0; b < set->nbodies; b++) {
+        set->lon[b * set->cap + c] = chart[b].body >= 0 ? chart[b].pos : NAN;
+    }
+}
+
+/**
+ * @brief Append a chart
+ *
+ * @param set The chart set
+ * @param chart The planet data, indexed by planet ID
+ * @return int OK on success, ERR if the set is full
+ */
+int chart_set_add(ChartSet *set, const PlanetData *chart) {
+    if (set->ncharts == set->cap) {
+        return ERR;
+    }
+    chart_set_store(set, set->ncharts++, chart);
+
+    return OK;
+}
+
+/**
+ * @brief Allocate a cross-aspect matrix
+ *
+ * @param m The matrix
+ * @param nbodies1 The bodies of the single chart
+ * @param nbodies2 The bodies per chart of the set
+ * @param ncharts The number of charts of the set
+ * @return int OK on success, ERR if out of memory
+ */
+int synastry_init(SynastryMatrix *m, int nbodies1, int nbodies2, size_t ncharts) {
+    size_t n = (size_t)nbodies1 * nbodies2 * ncharts + 1;
+
+    m->nbodies1 = nbodies1;
+    m->nbodies2 = nbodies2;
+    m->ncharts = ncharts;
+    m->aspect = (signed char *)malloc(n);
+    m->orb = (float *)malloc(n * sizeof(float));
+    m->score = (double *)malloc((ncharts + 1) * sizeof(double));
+    if (m->aspect == NULL || m->orb == NULL || m->score == NULL) {
+        synastry_free(m);
+        return ERR;
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Release a cross-aspect matrix
+ *
+ * @param m The matrix
+ */
+void synastry_free(SynastryMatrix *m) {
+    free(m->aspect);
+    free(m->orb);
+    free(m->score);
+    memset(m, 0, sizeof(*m));
+}
+
+/**
+ * @brief Scalar kernel: closest aspect of one longitude to n candidate longitudes
+ *
+ * @param a The longitude of the single chart's body
+ * @param lon The longitudes of one body in n candidates
+ * @param n The number of candidates
+ * @param t The aspect set
+ * @param aspect The aspect index per candidate, -1 for none
+ * @param orb The orb per candidate
+ * @param score The scores the aspects are added to
+ */
+static void cross_scalar(double a, const double *lon, size_t n, const AspectTable *t, signed char *aspect,
+                         float *orb, double *score) {
+    for (size_t c = 0; c < n; c++) {
+        double d = lon[c] - a;
+        double sep, best = DBL_MAX, best_delta = 0.0, best_w = 0.0;
+        int best_k = -1;
+
+        d -= 360.0 * floor(d / 360.0 + 0.5);
+        sep = fabs(d);
+        for (int k = 0; k < t->naspects; k++) {
+            double delta = sep - t->angle[k];
+            double ad = fabs(delta);
+
+            if (ad <= t->orb[k] && ad < best) {
+                best = ad;
+                best_k = k;
+                best_delta = delta;
+                best_w = t->weight[k] * (1.0 - ad * t->inv_orb[k]);
+            }
+        }
+        aspect[c] = (signed char)best_k;
+        orb[c] = (float)best_delta;
+        score[c] += best_w;
+    }
+}
+
+#ifdef HAVE_AVX2_KERNEL
+/**
+ * @brief AVX2 kernel, same contract and results as cross_scalar()
+ */
+__attribute__((target("avx2"))) static void cross_avx2(double a, const double *lon, size_t n, const AspectTable *t,
+                                                       signed char *aspect, float *orb, double *score) {
+    const __m256d av = _mm256_set1_pd(a);
+    const __m256d full = _mm256_set1_pd(360.0);
+    const __m256d inv_full = _mm256_set1_pd(1.0 / 360.0);
+    const __m256d sign_mask = _mm256_set1_pd(-0.0);
+    const __m256d one = _mm256_set1_pd(1.0);
+    size_t c = 0;
+
+    for (; c + 4 <= n; c += 4) {
+        __m256d d = _mm256_sub_pd(_mm256_loadu_pd(&lon[c]), av);
+        __m256d turns = _mm256_round_pd(_mm256_mul_pd(d, inv_full), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256d sep, best = _mm256_set1_pd(DBL_MAX), best_k = _mm256_set1_pd(-1.0);
+        __m256d best_delta = _mm256_setzero_pd(), best_w = _mm256_setzero_pd();
+        int k32[4];
+
+        d = _mm256_sub_pd(d, _mm256_mul_pd(turns, full));
+        sep = _mm256_andnot_pd(sign_mask, d);
+        for (int k = 0; k < t->naspects; k++) {
+            __m256d delta = _mm256_sub_pd(sep, _mm256_set1_pd(t->angle[k]));
+            __m256d ad = _mm256_andnot_pd(sign_mask, delta);
+            __m256d hit = _mm256_and_pd(_mm256_cmp_pd(ad, _mm256_set1_pd(t->orb[k]), _CMP_LE_OQ),
+                                        _mm256_cmp_pd(ad, best, _CMP_LT_OQ));
+            __m256d w = _mm256_mul_pd(_mm256_set1_pd(t->weight[k]),
+                                      _mm256_sub_pd(one, _mm256_mul_pd(ad, _mm256_set1_pd(t->inv_orb[k]))));
+
+            best = _mm256_blendv_pd(best, ad, hit);
+            best_k = _mm256_blendv_pd(best_k, _mm256_set1_pd((double)k), hit);
+            best_delta = _mm256_blendv_pd(best_delta, delta, hit);
+            best_w = _mm256_blendv_pd(best_w, w, hit);
+        }
+
+        _mm_storeu_si128((__m128i *)k32, _mm256_cvtpd_epi32(best_k));
+        for (int i = 0; i < 4; i++) {
+            aspect[c + i] = (signed char)k32[i];
+        }
+        _mm_storeu_ps(&orb[c], _mm256_cvtpd_ps(best_delta));
+        _mm256_storeu_pd(&score[c], _mm256_add_pd(_mm256_loadu_pd(&score[c]), best_w));
+    }
+
+    cross_scalar(a, &lon[c], n - c, t, &aspect[c], &orb[c], &score[c]);
+}
+#endif
+
+/**
+ * @brief Run the best kernel the CPU supports
+ */
+static void cross(double a, const double *lon, size_t n, const AspectTable *t, signed char *aspect, float *orb,
+                  double *score) {
+#ifdef HAVE_AVX2_KERNEL
+    if (cpu_has_avx2()) {
+        cross_avx2(a, lon, n, t, aspect, orb, score);
+        return;
+    }
+#endif
+    cross_scalar(a, lon, n, t, aspect, orb, score);
+}
+
+typedef struct {
+    const double *lon1; // longitudes of the single chart
+    const ChartSet *set;
+    const AspectTable *table;
+    SynastryMatrix *m;
+} SynastryCtx;
+
+static void synastry_task(void *ctx, size_t begin, size_t end, int worker) {
+    SynastryCtx *s = (SynastryCtx *)ctx;
+    SynastryMatrix *m = s->m;
+
+    (void)worker;
+
+    memset(&m->score[begin], 0, (end - begin) * sizeof(double));
+    for (int i = 0; i < m->nbodies1; i++) {
+        for (int j = 0; j < m->nbodies2; j++) {
+            size_t row = ((size_t)i * m->nbodies2 + j) * m->ncharts;
+
+            cross(s->lon1[i], &s->set->lon[j * s->set->cap + begin], end - begin, s->table, &m->aspect[row + begin],
+                  &m->orb[row + begin], &m->score[begin]);
+        }
+    }
+}
+
+/**
+ * @brief Compute the cross-aspect matrix and the scores of one chart against every chart of a set
+ *
+ * @param chart The planet data of the single chart, indexed by planet ID
+ * @param nbodies The bodies of the single chart, at most SYNASTRY_MAX_BODIES
+ * @param set The candidate charts
+ * @param aspects The aspect set
+ * @param weights The score weight of each aspect
+ * @param naspects The number of aspects, at most SYNASTRY_MAX_ASPECTS
+ * @param pool The pool to spread the chunks of candidates over, or NULL for the calling thread
+ * @param m The matrix, allocated with synastry_init(m, nbodies, set->nbodies, set->ncharts)
+ * @return int OK on success, ERR on invalid arguments
+ */
+int synastry_compute(const PlanetData *chart, int nbodies, const ChartSet *set, const AspectDef *aspects,
+                     const double *weights, int naspects, ThreadPool *pool, SynastryMatrix *m) {
+    double lon1[SYNASTRY_MAX_BODIES];
+    AspectTable table;
+    SynastryCtx ctx = {lon1, set, &table, m};
+
+    if (nbodies > SYNASTRY_MAX_BODIES || naspects > SYNASTRY_MAX_ASPECTS || m->nbodies1 != nbodies ||
+        m->nbodies2 != set->nbodies || m->ncharts != set->ncharts) {
+        return ERR;
+    }
+
+    for (int i = 0; i < nbodies; i++) {
+        lon1[i] = chart[i].body >= 0 ? chart[i].pos : NAN;
+    }
+    table.naspects = naspects;
+    for (int k = 0; k < naspects; k++) {
+        table.angle[k] = aspects[k].angle;
+        table.orb[k] = aspects[k].orb;
+        table.inv_orb[k] = 1.0 / aspects[k].orb;
+        table.weight[k] = weights[k];
+    }
+
+    if (pool != NULL) {
+        pool_run(pool, set->ncharts, SYNASTRY_CHUNK, synastry_task, &ctx);
+    } else {
+        for (size_t c = 0; c < set->ncharts; c += SYNASTRY_CHUNK) {
+            synastry_task(&ctx, c, c + SYNASTRY_CHUNK < set->ncharts ? c + SYNASTRY_CHUNK : set->ncharts, 0);
+        }
+    }
+
+    return OK;
+}
+
+typedef struct {
+    const BirthRecord *recs;
+    const double *tjd_ut;
+    ChartSet *set;
+} CandidateCtx;
+
+static void candidate_task(void *ctx, size_t begin, size_t end, int worker) {
+    CandidateCtx *c = (CandidateCtx *)ctx;
+    PlanetData chart[SYNASTRY_MAX_BODIES];
+
+    (void)worker;
+
+    for (size_t i = begin; i < end; i++) {
+        for (int b = 0; b < c->set->nbodies; b++) {
+            get_planet_data_into(b, c->tjd_ut[i], c->recs[i].iflags, &chart[b]);
+        }
+        chart_set_store(c->set, i, chart);
+    }
+}
+
+static const double *sort_scores;
+
+static int compare_scores(const void *a, const void *b) {
+    double x = sort_scores[*(const size_t *)a], y = sort_scores[*(const size_t *)b];
+
+    if (x != y) {
+        return x > y ? -1 : 1;
+    }
+
+    return *(const size_t *)a < *(const size_t *)b ? -1 : 1;
+}
+
+/**
+ * @brief Entry point of the synastry mode
+ *
+ * main synastry <jd_ut> <file> [-f iflags] [-j threads] [-k top]
+ *
+ * Compares the chart of jd_ut (Sun to Pluto) with the chart of every birth record of the file (batch format, "-"
+ * for stdin) and prints the top candidates by score, best first, with their cross aspects.
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int synastry_main(int argc, char **argv) {
+    const int nbodies = SE_PLUTO + 1;
+    int iflags = SEFLG_SWIEPH;
+    int nthreads = 1;
+    long top = 10;
+    PlanetData chart[SYNASTRY_MAX_BODIES];
+    BirthRecord *recs = NULL;
+    double *tjd_ut = NULL;
+    size_t *order = NULL;
+    long n, nskipped = 0, nfailed = 0;
+    ThreadPool *pool = NULL;
+    ChartSet set;
+    SynastryMatrix m;
+    CandidateCtx cctx;
+    double tjd;
+    int ret = 0;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: main synastry <jd_ut> <file> [-f iflags] [-j threads] [-k top]\n");
+        return 1;
+    }
+    tjd = atof(argv[1]);
+    for (int i = 3; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-f") == 0) {
+            iflags = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            nthreads = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-k") == 0) {
+            top = atol(argv[i + 1]);
+        }
+    }
+
+    memset(&set, 0, sizeof(set));
+    memset(&m, 0, sizeof(m));
+    n = read_birth_file(argv[2], iflags, &recs, &tjd_ut, &nskipped);
+    if (n < 0 || chart_set_init(&set, nbodies, (size_t)n) == ERR ||
+        synastry_init(&m, nbodies, nbodies, (size_t)n) == ERR) {
+        fprintf(stderr, "Error: cannot read the candidates\n");
+        ret = 1;
+        goto done;
+    }
+    order = (size_t *)malloc((n + 1) * sizeof(size_t));
+    if (order == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        ret = 1;
+        goto done;
+    }
+    if (nthreads != 1) {
+        pool = pool_create(nthreads, NULL);
+    }
+
+    for (int b = 0; b < nbodies; b++) {
+        if (get_planet_data_into(b, tjd, iflags, &chart[b]) == ERR) {
+            ret = 1;
+        }
+    }
+
+    // Candidate charts are computed straight into the set
+    cctx.recs = recs;
+    cctx.tjd_ut = tjd_ut;
+    cctx.set = &set;
+    if (pool != NULL) {
+        pool_run(pool, (size_t)n, 0, candidate_task, &cctx);
+    } else {
+        candidate_task(&cctx, 0, (size_t)n, 0);
+    }
+    set.ncharts = (size_t)n;
+
+    // A failed body is stored as NAN and takes no part in the aspects
+    for (long c = 0; c < n; c++) {
+        for (int b = 0; b < nbodies; b++) {
+            if (isnan(set.lon[b * set.cap + c])) {
+                nfailed++;
+                break;
+            }
+        }
+    }
+
+    synastry_compute(chart, nbodies, &set, default_aspects, default_synastry_weights, num_default_aspects, pool, &m);
+    pool_destroy(pool);
+
+    for (long c = 0; c < n; c++) {
+        order[c] = (size_t)c;
+    }
+    sort_scores = m.score;
+    qsort(order, (size_t)n, sizeof(size_t), compare_scores);
+
+    printf("Synastry of Julian Day %.6f against %ld charts\n", tjd, n);
+    for (long r = 0; r < n && r < top; r++) {
+        size_t c = order[r];
+
+        printf("\n%ld. Chart %zu (Julian Day %.6f): score %.4f\n", r + 1, c + 1, tjd_ut[c], m.score[c]);
+        for (int i = 0; i < nbodies; i++) {
+            for (int j = 0; j < nbodies; j++) {
+                size_t e = ((size_t)i * nbodies + j) * m.ncharts + c;
+                char name1[AS_MAXCH], name2[AS_MAXCH];
+
+                if (m.aspect[e] < 0) {
+                    continue;
+                }
+                swe_get_planet_name(i, name1);
+                swe_get_planet_name(j, name2);
+                printf("  %-10s %-12s %-10s %+6.2f\n", name1, default_aspects[m.aspect[e]].name, name2, m.orb[e]);
+            }
+        }
+    }
+
+    if (nskipped > 0 || nfailed > 0) {
+        fprintf(stderr, "Error: %ld records skipped, %ld charts with failed bodies\n", nskipped, nfailed);
+        ret = 1;
+    }
+
+done:
+    synastry_free(&m);
+    chart_set_free(&set);
+    free(order);
+    free(recs);
+    free(tjd_ut);
+    swe_close();
+
+    return ret;
+}
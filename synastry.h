@@ -0,0 +1,49 @@
+#ifndef SYNASTRY_H
+#define SYNASTRY_H
+
+#include "aspects.h"
+#include "pool.h"
+#include <stddef.h>
+
+// Largest number of bodies per chart and of aspects in a synastry
+#define SYNASTRY_MAX_BODIES 16
+#define SYNASTRY_MAX_ASPECTS 16
+
+// Candidates processed per pool item
+#define SYNASTRY_CHUNK 1024
+
+// Longitudes of many charts, body-major: lon[b * cap + c] is body b of chart c, so that each body of all charts is
+// one contiguous array. A body whose calculation failed holds NAN and never forms an aspect.
+typedef struct {
+    int nbodies;
+    size_t ncharts;
+    size_t cap;
+    double *lon;
+} ChartSet;
+
+// Cross-aspect matrix of one chart against a chart set, pair-major so that each body pair is contiguous across
+// candidates: for chart body i, candidate body j and candidate c, entry ((i * nbodies2 + j) * ncharts + c)
+typedef struct {
+    int nbodies1;
+    int nbodies2;
+    size_t ncharts;
+    signed char *aspect; // index in the aspect set of the closest aspect, -1 for none
+    float *orb;          // separation minus the exact angle, degrees
+    double *score;       // per candidate: sum of weight * (1 - |orb| / allowed orb) over the aspects found
+} SynastryMatrix;
+
+extern const double default_synastry_weights[];
+
+int chart_set_init(ChartSet *set, int nbodies, size_t cap);
+void chart_set_free(ChartSet *set);
+void chart_set_store(ChartSet *set, size_t c, const PlanetData *chart);
+int chart_set_add(ChartSet *set, const PlanetData *chart);
+
+int synastry_init(SynastryMatrix *m, int nbodies1, int nbodies2, size_t ncharts);
+void synastry_free(SynastryMatrix *m);
+int synastry_compute(const PlanetData *chart, int nbodies, const ChartSet *set, const AspectDef *aspects,
+                     const double *weights, int naspects, ThreadPool *pool, SynastryMatrix *m);
+
+int synastry_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,309 @@
+#include "transits.h"
+#include "houses.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Transit-to-natal aspect search
+ *
+ * An exact aspect of angle a to a natal longitude L is a crossing of L + a or L - a by the transiting body, so
+ * every natal point and aspect becomes one or two target longitudes and the whole search is one find_crossings()
+ * scan per transiting body: the scan brackets every crossing with speed-bounded steps, handles the three passes of
+ * a retrograde loop, and refines each crossing on swe_calc_ut. The range is searched in windows of TRANSIT_WINDOW
+ * days; within a window the bodies are scanned in parallel on the pool, and the window's transits are merged,
+ * sorted and reported before the next window starts, so results stream out in time order with bounded memory.
+ */
+
+// Natal point and aspect behind one target longitude
+typedef struct {
+    int natal;
+    int aspect;
+} TargetRef;
+
+typedef struct {
+    const int *bodies;
+    int iflags;
+    double jd_start;
+    double jd_end;
+    const double *targets;
+    int ntargets;
+    CrossingList *lists;
+    int *status;
+} TransitCtx;
+
+/**
+ * @brief Compute the natal points of a chart: the given bodies, then the ascendant and midheaven if geo is set
+ *
+ * @param tjd_ut The Julian Day (UT) of the natal chart
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param bodies The natal planet IDs
+ * @param nbodies The number of natal planet IDs, at most NUM_CHART_BODIES
+ * @param geo The geographic latitude and longitude of the birth place, or NULL for no angles
+ * @param points Storage for TRANSIT_MAX_NATAL points
+ * @param serr Error buffer (at least 256 bytes)
+ * @return int The number of natal points, or ERR if a body or the houses failed
+ */
+int natal_points(double tjd_ut, int iflags, const int *bodies, int nbodies, const double *geo, NatalPoint *points,
+                 char *serr) {
+    int n = 0;
+
+    for (int i = 0; i < nbodies && i < NUM_CHART_BODIES; i++) {
+        double xx[6];
+
+        if (swe_calc_ut(tjd_ut, bodies[i], iflags, xx, serr) == ERR) {
+            return ERR;
+        }
+        swe_get_planet_name(bodies[i], points[n].name);
+        points[n++].lon = xx[0];
+    }
+
+    if (geo != NULL) {
+        HouseData h;
+
+        if (compute_houses(tjd_ut, iflags, DEFAULT_HOUSE_SYSTEM, geo[0], geo[1], &h, serr) == ERR) {
+            return ERR;
+        }
+        strcpy(points[n].name, "Asc");
+        points[n++].lon = h.ascmc[SE_ASC];
+        strcpy(points[n].name, "MC");
+        points[n++].lon = h.ascmc[SE_MC];
+    }
+
+    return n;
+}
+
+static void transit_task(void *ctx, size_t begin, size_t end, int worker) {
+    TransitCtx *c = (TransitCtx *)ctx;
+    char serr[256];
+
+    (void)worker;
+
+    for (size_t b = begin; b < end; b++) {
+        c->lists[b].n = 0;
+        c->status[b] = find_crossings(c->bodies[b], c->iflags, c->jd_start, c->jd_end, c->targets, c->ntargets,
+                                      &c->lists[b], serr);
+        if (c->status[b] == ERR) {
+            fprintf(stderr, "Error: body %d: %s\n", c->bodies[b], serr);
+        }
+    }
+}
+
+/**
+ * @brief Find every exact aspect of the transiting bodies to the natal points over a range
+ *
+ * @param bodies The transiting planet IDs
+ * @param nbodies The number of transiting planet IDs
+ * @param iflags The flags for the Swiss Ephemeris
+ * @param jd_start The start of the range (UT)
+ * @param jd_end The end of the range (UT)
+ * @param natal The natal points
+ * @param nnatal The number of natal points
+ * @param aspects The aspect set; the orbs are not used
+ * @param naspects The number of aspects
+ * @param pool The pool to spread the transiting bodies over, or NULL for the calling thread
+ * @param cb Called for every transit, in time order
+ * @param cb_ctx Passed to cb
+ * @return int OK on success, ERR if any body failed or out of memory
+ */
+int find_transits(const int *bodies, int nbodies, int iflags, double jd_start, double jd_end, const NatalPoint *natal,
+                  int nnatal, const AspectDef *aspects, int naspects, ThreadPool *pool, TransitCallback cb,
+                  void *cb_ctx) {
+    // One spare entry keeps the allocations non-empty without natal points
+    double *targets = (double *)malloc((2 * nnatal * naspects + 1) * sizeof(double));
+    TargetRef *refs = (TargetRef *)malloc((2 * nnatal * naspects + 1) * sizeof(TargetRef));
+    int ntargets = 0;
+    int *passes = NULL;
+    double *last_jd = NULL;
+    CrossingList all;
+    TransitCtx ctx;
+    int ret = OK;
+
+    memset(&ctx, 0, sizeof(ctx));
+    crossing_list_init(&all);
+    if (targets == NULL || refs == NULL) {
+        free(targets);
+        free(refs);
+        return ERR;
+    }
+
+    // Conjunctions and oppositions have one target longitude, the other aspects one on each side
+    for (int p = 0; p < nnatal; p++) {
+        for (int a = 0; a < naspects; a++) {
+            for (int side = 1; side >= -1; side -= 2) {
+                if (side < 0 && (aspects[a].angle == 0.0 || aspects[a].angle == 180.0)) {
+                    break;
+                }
+                targets[ntargets] = swe_degnorm(natal[p].lon + side * aspects[a].angle);
+                refs[ntargets].natal = p;
+                refs[ntargets].aspect = a;
+                ntargets++;
+            }
+        }
+    }
+
+    ctx.bodies = bodies;
+    ctx.iflags = iflags;
+    ctx.targets = targets;
+    ctx.ntargets = ntargets;
+    ctx.lists = (CrossingList *)calloc(nbodies, sizeof(CrossingList));
+    ctx.status = (int *)calloc(nbodies, sizeof(int));
+    passes = (int *)calloc((size_t)nbodies * ntargets + 1, sizeof(int));
+    last_jd = (double *)calloc((size_t)nbodies * ntargets + 1, sizeof(double));
+    if (ctx.lists == NULL || ctx.status == NULL || passes == NULL || last_jd == NULL) {
+        ret = ERR;
+    }
+
+    for (double w = jd_start; w < jd_end && ret == OK; w += TRANSIT_WINDOW) {
+        ctx.jd_start = w;
+        ctx.jd_end = fmin(w + TRANSIT_WINDOW, jd_end);
+        if (pool != NULL) {
+            pool_run(pool, (size_t)nbodies, 1, transit_task, &ctx);
+        } else {
+            transit_task(&ctx, 0, (size_t)nbodies, 0);
+        }
+
+        // The merged crossings carry the index into bodies[], which keys the pass counters of any body ID
+        all.n = 0;
+        for (int b = 0; b < nbodies; b++) {
+            if (ctx.status[b] == ERR) {
+                ret = ERR;
+            }
+            for (size_t i = 0; i < ctx.lists[b].n; i++) {
+                Crossing c = ctx.lists[b].items[i];
+
+                c.body = b;
+                if (crossing_list_push(&all, &c) == ERR) {
+                    ret = ERR;
+                }
+            }
+        }
+        crossing_list_sort(&all);
+
+        for (size_t i = 0; i < all.n; i++) {
+            const Crossing *c = &all.items[i];
+            size_t k = (size_t)c->body * ntargets + c->target;
+            Transit t;
+
+            // Coming back to a longitude after leaving a loop takes a full circle, at least 360 / vmax days, while
+            // the passes of one loop are much closer together: a longer gap starts a new series of passes
+            if (passes[k] > 0 && c->jd - last_jd[k] > 360.0 / body_max_speed(bodies[c->body], iflags)) {
+                passes[k] = 0;
+            }
+            last_jd[k] = c->jd;
+
+            t.jd = c->jd;
+            t.body = bodies[c->body];
+            t.natal = refs[c->target].natal;
+            t.aspect = refs[c->target].aspect;
+            t.lon = c->lon;
+            t.direction = c->direction;
+            t.pass = ++passes[k];
+            cb(&t, cb_ctx);
+        }
+    }
+
+    for (int b = 0; ctx.lists != NULL && b < nbodies; b++) {
+        crossing_list_free(&ctx.lists[b]);
+    }
+    crossing_list_free(&all);
+    free(ctx.lists);
+    free(ctx.status);
+    free(passes);
+    free(last_jd);
+    free(targets);
+    free(refs);
+
+    return ret;
+}
+
+typedef struct {
+    const NatalPoint *natal;
+    const AspectDef *aspects;
+} PrintCtx;
+
+static void print_transit(const Transit *t, void *ctx) {
+    const PrintCtx *p = (const PrintCtx *)ctx;
+    char name[AS_MAXCH];
+
+    swe_get_planet_name(t->body, name);
+    print_jd(t->jd);
+    printf(" %-12s %-12s %-12s %12.7f pass %d%s\n", name, p->aspects[t->aspect].name, p->natal[t->natal].name,
+           t->lon, t->pass, t->direction < 0 ? " R" : "");
+}
+
+/**
+ * @brief Entry point of the transits mode
+ *
+ * main transits <natal_jd> <jd_start> <jd_end> [-b bodies] [-n natal_bodies] [-g lat,lon] [-f iflags] [-j threads]
+ *
+ * Prints one line per exact aspect, in time order: time, transiting body, aspect, natal point, longitude, the
+ * pass number and R for a transit in retrograde motion. With -g the natal ascendant and midheaven are included.
+ *
+ * @param argc The argument count, starting at the mode name
+ * @param argv The arguments, starting at the mode name
+ * @return int The process exit status
+ */
+int transits_main(int argc, char **argv) {
+    int bodies[SE_NPLANETS];
+    int nbodies = SE_PLUTO + 1;
+    int natal_bodies[NUM_CHART_BODIES];
+    int nnatal_bodies = SE_PLUTO + 1;
+    int iflags = SEFLG_SWIEPH;
+    int nthreads = 1;
+    double geo[2];
+    int has_geo = 0;
+    NatalPoint natal[TRANSIT_MAX_NATAL];
+    int nnatal;
+    ThreadPool *pool = NULL;
+    PrintCtx pctx;
+    char serr[256];
+    int ret;
+
+    if (argc < 4) {
+        fprintf(stderr, "Usage: main transits <natal_jd> <jd_start> <jd_end> [-b bodies] [-n natal_bodies] "
+                        "[-g lat,lon] [-f iflags] [-j threads]\n");
+        return 1;
+    }
+
+    for (int i = 0; i < nbodies; i++) {
+        bodies[i] = i;
+        natal_bodies[i] = i;
+    }
+    for (int i = 4; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-b") == 0) {
+            nbodies = parse_body_list(argv[i + 1], bodies, SE_NPLANETS);
+        } else if (strcmp(argv[i], "-n") == 0) {
+            nnatal_bodies = parse_body_list(argv[i + 1], natal_bodies, NUM_CHART_BODIES);
+        } else if (strcmp(argv[i], "-g") == 0) {
+            has_geo = sscanf(argv[i + 1], "%lf,%lf", &geo[0], &geo[1]) == 2;
+        } else if (strcmp(argv[i], "-f") == 0) {
+            iflags = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            nthreads = atoi(argv[i + 1]);
+        }
+    }
+    if (nbodies <= 0 || nnatal_bodies < 0) {
+        fprintf(stderr, "Error: invalid body list\n");
+        return 1;
+    }
+
+    nnatal = natal_points(atof(argv[1]), iflags, natal_bodies, nnatal_bodies, has_geo ? geo : NULL, natal, serr);
+    if (nnatal == ERR) {
+        fprintf(stderr, "Error: %s\n", serr);
+        return 1;
+    }
+    if (nthreads != 1) {
+        pool = pool_create(nthreads, NULL);
+    }
+
+    pctx.natal = natal;
+    pctx.aspects = default_aspects;
+    ret = find_transits(bodies, nbodies, iflags, atof(argv[2]), atof(argv[3]), natal, nnatal, default_aspects,
+                        num_default_aspects, pool, print_transit, &pctx);
+    pool_destroy(pool);
+    swe_close();
+
+    return ret == OK ? 0 : 1;
+}
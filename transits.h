@@ -0,0 +1,41 @@
+#ifndef TRANSITS_H
+#define TRANSITS_H
+
+#include "aspects.h"
+#include "events.h"
+#include "pool.h"
+
+// Days searched per round; the transits of a round are reported, in time order, before the next round starts
+#define TRANSIT_WINDOW 366.0
+
+// Largest number of natal points: the chart bodies and the two angles
+#define TRANSIT_MAX_NATAL (NUM_CHART_BODIES + 2)
+
+// A natal longitude that transits aspect
+typedef struct {
+    char name[AS_MAXCH];
+    double lon;
+} NatalPoint;
+
+// One exact aspect of a transiting body to a natal point
+typedef struct {
+    double jd;     // Julian Day (UT) of the exact aspect
+    int body;      // transiting planet ID
+    int natal;     // index of the natal point
+    int aspect;    // index in the aspect set
+    double lon;    // longitude of the transiting body
+    int direction; // +1 in direct motion, -1 in retrograde motion
+    int pass;      // 1 for a direct pass or the first exact aspect of a retrograde loop, 2 and 3 for the loop's others
+} Transit;
+
+// Receives the transits in time order
+typedef void (*TransitCallback)(const Transit *t, void *ctx);
+
+int natal_points(double tjd_ut, int iflags, const int *bodies, int nbodies, const double *geo, NatalPoint *points,
+                 char *serr);
+int find_transits(const int *bodies, int nbodies, int iflags, double jd_start, double jd_end, const NatalPoint *natal,
+                  int nnatal, const AspectDef *aspects, int naspects, ThreadPool *pool, TransitCallback cb,
+                  void *cb_ctx);
+int transits_main(int argc, char **argv);
+
+#endif